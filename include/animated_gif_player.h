@@ -1,9 +1,45 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
 
 void animatedGifSetup();
 void animatedGifLoop();
 size_t animatedGifFileCount();
+// First playlist entry on the card, from the playlist table (loaded on the
+// first call); nullptr when there is none or the table is unavailable.
+const char *animatedGifFirstPlayableFile();
 bool animatedGifOpenAtIndex(size_t index);
+// True when the playlist table shows entry `index` is not on the card; such
+// entries keep their number but are never opened.
+bool animatedGifIsMissing(size_t index);
 bool animatedGifIsReady();
+// Stops the player's work on the other cores before another program takes
+// the panel: frames decoded ahead are dropped (the next open resumes from
+// where the decoder got to) and a prepare job is waited for.
+void animatedGifSuspend();
+// Frees the program snapshots once a program other than a GIF has the
+// panel; switching back to a GIF then starts from a cleared panel.
+void animatedGifReleaseSnapshots();
+// Something else drew on the panel while a GIF was showing; the next frames
+// redraw what they cover instead of sending only what changed.
+void animatedGifInvalidatePanel();
+// Puts the panel as program `index` was last left back on screen, so a switch
+// shows it at once while the decoder opens; the next
+// animatedGifOpenAtIndex(index) carries on from it. False when there is no
+// snapshot (the caller clears the panel as before).
+bool animatedGifShowSnapshot(size_t index);
+// Prints each file's playback telemetry since boot or the last reset over
+// serial (ANIMATED_GIF_TELEMETRY); `reset` starts it over.
+void animatedGifDumpTelemetry(bool reset);
+
+// Opens `index` and decodes its first frame off the render thread (on the
+// other core where available); the next animatedGifLoop() presents it.
+// animatedGifPrepareReady() reports when that work for `index` is done.
+void animatedGifPrepareAsync(size_t index);
+bool animatedGifPrepareReady(size_t index);
+
+// Locks playback to a clock shared with other controllers: `timebaseMs` is
+// the sender's clock when the packet arrived at local `localMs` (millis()).
+// The frame shown then follows that clock over the GIF's frame times.
+void animatedGifSyncTimebase(uint32_t timebaseMs, uint32_t localMs);
@@ -6,6 +6,10 @@
 #define ENABLE_HYPNO_SPIRAL
 #define ENABLE_ANIMATED_GIF
 #define ENABLE_EYE_PROGRAM // Include the eye animation in the program loop.
+// #define ENABLE_MJPEG_PLAYER // Motion-JPEG clips from SD (needs ENABLE_ANIMATED_GIF and clips
+                               // made with tools/gif_to_mjpeg.cpp on the card).
+// #define ENABLE_RDA_PLAYER   // Round delta animations from SD (needs ENABLE_ANIMATED_GIF and clips
+                               // made with tools/gif_to_rda.cpp on the card).
 
 // OTA updates (ESP32) -------------------------------------------------
 // Uses ArduinoOTA (WiFi). Fill in SSID/PASS to enable.
@@ -139,6 +143,13 @@
 #define DISPLAY_BACKLIGHT  -1
 #define BACKLIGHT_MAX    255
 
+// Keep pixel buffers in the panel's own byte order (RGB565, high byte first)
+// so they go to the bus as they are instead of being swapped per pixel by
+// Arduino_GFX. Colour constants stay in host order; see panel_pixels.h.
+#ifndef PANEL_NATIVE_PIXELS
+#define PANEL_NATIVE_PIXELS 1
+#endif
+
 #if defined(ENABLE_HYPNO_SPIRAL)
 
 // Spiral hypnosis configuration --------------------------------------
@@ -155,6 +166,15 @@
 #define HYPNO_RADIUS_EXPONENT   0.85f  // radial easing (<1 tightens the centre)
 #define HYPNO_STRIPE_DUTY       0.58f  // bright stripe proportion (0-1 range)
 #define HYPNO_PHASE_INCREMENT   6512    // rotation speed per frame (larger = faster)
+// Rows rendered into internal RAM and sent to the panel at a time.
+#define HYPNO_BAND_LINES        16
+// Frame rate and frame time are printed every N milliseconds (0 = off).
+#define HYPNO_STATS_INTERVAL_MS 5000
+// Keep the spiral's phase map in this file on the SD card (needs the GIF
+// player's card) and load it instead of building it, while the parameters
+// above match. Building takes a few milliseconds, which a slow card may not
+// beat.
+// #define HYPNO_MAP_CACHE "/hypno.map"
 
 #endif
 
@@ -182,6 +202,73 @@
 #define BOOT_SD_TEST_BUFFER_BYTES 4096
 #endif
 
+// Sector-aligned read-ahead window (PSRAM) in front of the GIF file reads.
+#ifndef ANIMATED_GIF_READ_CACHE_BYTES
+#define ANIMATED_GIF_READ_CACHE_BYTES (32UL * 1024UL)
+#endif
+// Core of the task that reads the next window of the file into a second
+// buffer while the decoder works through the current one; -1 reads
+// synchronously with a single window.
+#ifndef ANIMATED_GIF_IO_CORE
+#define ANIMATED_GIF_IO_CORE 0
+#endif
+#ifndef ANIMATED_GIF_IO_STACK
+#define ANIMATED_GIF_IO_STACK 4096
+#endif
+// Lets the decoder copy LZW sub-blocks straight out of the read-ahead window
+// (and out of preloaded files) instead of through two read calls each. Off
+// until it shows a gain on the board: tools/gif_bench.cpp has it 2.4% slower
+// than plain reads on the host.
+#ifndef ANIMATED_GIF_MAP_READS
+#define ANIMATED_GIF_MAP_READS 0
+#endif
+// GIFs whose clusters are contiguous on a FAT16/FAT32 card are read as raw
+// sectors (FatFs physical drive ANIMATED_GIF_SD_DRIVE, the one SD.begin()
+// registered) instead of through File; 0 always reads through File.
+#ifndef ANIMATED_GIF_SD_DIRECT
+#define ANIMATED_GIF_SD_DIRECT 1
+#endif
+#ifndef ANIMATED_GIF_SD_DRIVE
+#define ANIMATED_GIF_SD_DRIVE 0
+#endif
+
+// GIFs up to ANIMATED_GIF_PRELOAD_MAX_BYTES are read into PSRAM with one
+// sequential read and played from memory. Up to ANIMATED_GIF_PRELOAD_SLOTS
+// files (ANIMATED_GIF_PRELOAD_BUDGET_BYTES in total) stay resident across
+// program switches, least recently used first out. Set the max to 0 to
+// always stream from SD.
+#ifndef ANIMATED_GIF_PRELOAD_MAX_BYTES
+#define ANIMATED_GIF_PRELOAD_MAX_BYTES (256UL * 1024UL)
+#endif
+#ifndef ANIMATED_GIF_PRELOAD_BUDGET_BYTES
+#define ANIMATED_GIF_PRELOAD_BUDGET_BYTES (256UL * 1024UL)
+#endif
+#ifndef ANIMATED_GIF_PRELOAD_SLOTS
+#define ANIMATED_GIF_PRELOAD_SLOTS 4
+#endif
+
+// Open decoders (state, file handle and 8-bit canvas in PSRAM) kept per file
+// so switching back to a recent program resumes where it left off.
+#ifndef ANIMATED_GIF_DECODER_POOL_SIZE
+#define ANIMATED_GIF_DECODER_POOL_SIZE 3
+#endif
+
+// Core the program-switch prepare task runs on (the render loop runs on core
+// 1); -1 opens and decodes the first frame synchronously instead.
+#ifndef ANIMATED_GIF_PREPARE_CORE
+#define ANIMATED_GIF_PREPARE_CORE 0
+#endif
+#ifndef ANIMATED_GIF_PREPARE_STACK
+#define ANIMATED_GIF_PREPARE_STACK 8192
+#endif
+// Frames the prepare task decodes ahead of display while a GIF streams from
+// SD (2-4; about 145 KB of PSRAM each). The render loop shows them on
+// schedule, so a slow card read drains the ring instead of delaying a frame.
+// 0 decodes in the render loop.
+#ifndef ANIMATED_GIF_DECODE_AHEAD_FRAMES
+#define ANIMATED_GIF_DECODE_AHEAD_FRAMES 2
+#endif
+
 // GIF files to cycle through on the SD card (root directory by default).
 #ifndef ANIMATED_GIF_FILES
 #define ANIMATED_GIF_FILES                                                                                      \
@@ -192,6 +279,13 @@
   }
 #endif
 
+// Size, canvas, frame count and duration of every playlist entry, kept on the
+// card and rebuilt when the GIFs in the root directory change. Entries that
+// are not on the card are skipped without opening them.
+#ifndef ANIMATED_GIF_PLAYLIST_INDEX
+#define ANIMATED_GIF_PLAYLIST_INDEX "/playlist.idx"
+#endif
+
 // Switch to the next program every N milliseconds.
 #ifndef ANIMATED_GIF_SWITCH_INTERVAL_MS
 #define ANIMATED_GIF_SWITCH_INTERVAL_MS 10000
@@ -226,6 +320,97 @@
 #define ANIMATED_GIF_MAX_DELAY 33
 #endif
 
+// Turbo decode: keep the LZW turbo buffer and the 8-bit canvas in PSRAM and let
+// the decoder hand over fully composited RGB565 lines (GIF_DRAW_COOKED). The
+// player falls back to the RAW per-line path when the buffers cannot be
+// allocated. Set to 0 to always use the RAW path.
+#ifndef ANIMATED_GIF_TURBO
+#define ANIMATED_GIF_TURBO 1
+#endif
+// Panel rows gathered in internal RAM before each cooked blit.
+#ifndef ANIMATED_GIF_BAND_LINES
+#define ANIMATED_GIF_BAND_LINES 24
+#endif
+// Blits are compared with a PSRAM copy of the panel and only changed spans
+// are sent. Spans fewer than ANIMATED_GIF_DIFF_MERGE_GAP pixels apart go out
+// as one (each span costs an address window); a row that changed over
+// ANIMATED_GIF_DIFF_FULL_ROW_PERCENT of its width goes out whole. Set
+// ANIMATED_GIF_PANEL_DIFF to 0 to send every blit as is.
+#ifndef ANIMATED_GIF_PANEL_DIFF
+#define ANIMATED_GIF_PANEL_DIFF 1
+#endif
+#ifndef ANIMATED_GIF_DIFF_MERGE_GAP
+#define ANIMATED_GIF_DIFF_MERGE_GAP 16
+#endif
+#ifndef ANIMATED_GIF_DIFF_FULL_ROW_PERCENT
+#define ANIMATED_GIF_DIFF_FULL_ROW_PERCENT 75
+#endif
+// Copies of the panel as each GIF program was last left (about 113 KB of
+// PSRAM each, least recently used first out), taken from the panel copy
+// above. Switching back shows the copy with one blit while the decoder
+// opens. They are freed when a program other than a GIF takes the panel.
+// 0 clears the panel instead.
+#ifndef ANIMATED_GIF_SNAPSHOT_SLOTS
+#define ANIMATED_GIF_SNAPSHOT_SLOTS 2
+#endif
+// Average decode time per frame is printed every N milliseconds (0 = off).
+#ifndef ANIMATED_GIF_STATS_INTERVAL_MS
+#define ANIMATED_GIF_STATS_INTERVAL_MS 5000
+#endif
+// Per-file telemetry of SD playback (decode, read and blit time, achieved
+// against requested frame delays, late and dropped frames), printed when 't'
+// arrives over serial; 'T' prints it and starts over (0 = off). Costs a few
+// micros() reads per panel write.
+#ifndef ANIMATED_GIF_TELEMETRY
+#define ANIMATED_GIF_TELEMETRY 1
+#endif
+// A frame shown more than this after its delay ran out counts as late.
+#ifndef ANIMATED_GIF_LATE_MARGIN_MS
+#define ANIMATED_GIF_LATE_MARGIN_MS 5
+#endif
+
+// Looping GIFs whose composited frames fit this PSRAM budget are recorded
+// during the first pass (8-bit + palette when <= 256 colours, else RGB565)
+// and replayed from memory on later loops without decoding. Eligibility is
+// frame count x canvas size; set to 0 to disable. Needs turbo decoding.
+#ifndef ANIMATED_GIF_FRAME_CACHE_BYTES
+#define ANIMATED_GIF_FRAME_CACHE_BYTES (256UL * 1024UL)
+#endif
+#if defined(ANIMATED_GIF_USE_SD) && ANIMATED_GIF_FRAME_CACHE_BYTES > 0 && ANIMATED_GIF_TURBO
+#define ANIMATED_GIF_FRAME_CACHE
+#endif
+
+// PSRAM the GIF player may hold at once with the sizes above (panel copy,
+// staging frame, decoder pool, read cache, decode-ahead ring, snapshots,
+// preloads and frame cache). The build fails when they add up to more, and
+// setup reports it when less PSRAM is free. The default leaves 256 KB
+// of the Feather ESP32 V2's 2 MB for frame indexes, the playlist and the
+// other programs.
+#ifndef ANIMATED_GIF_PSRAM_BUDGET_BYTES
+#define ANIMATED_GIF_PSRAM_BUDGET_BYTES (1792UL * 1024UL)
+#endif
+
+// Frame index per GIF (offsets, delays, disposal methods, keyframes), stored
+// next to the file as "<name>.idx" on first open. Lets the player seek to a
+// keyframe instead of decoding from the start. Set to 0 to disable.
+#ifndef ANIMATED_GIF_FRAME_INDEX
+#define ANIMATED_GIF_FRAME_INDEX 1
+#endif
+// Frames found to repeat the frame before (same image data, rectangle and
+// graphic control; hashed as they are first decoded) are marked in the index
+// and not decoded or sent on later loops; the frame on the panel is held for
+// their delays too. Needs the frame index; 0 decodes them.
+#ifndef ANIMATED_GIF_SKIP_DUPLICATES
+#define ANIMATED_GIF_SKIP_DUPLICATES 1
+#endif
+// Once a BLE sync packet has supplied a timebase, the frame shown follows
+// that shared clock. Frames it has passed are skipped where that is exact
+// (frame cache, keyframe seek) and otherwise decoded back to back, at most
+// this many per loop.
+#ifndef ANIMATED_GIF_SYNC_MAX_CATCHUP
+#define ANIMATED_GIF_SYNC_MAX_CATCHUP 4
+#endif
+
 #if !defined(ANIMATED_GIF_USE_SD)
   #include ANIMATED_GIF_HEADER
 
@@ -245,6 +430,59 @@
 
 #endif
 
+#if defined(ENABLE_MJPEG_PLAYER)
+#if !defined(ENABLE_ANIMATED_GIF) || !defined(ANIMATED_GIF_USE_SD) || !defined(ENABLE_EYE_PROGRAM)
+#undef ENABLE_MJPEG_PLAYER
+#endif
+#endif
+#if defined(ENABLE_RDA_PLAYER)
+#if !defined(ENABLE_ANIMATED_GIF) || !defined(ANIMATED_GIF_USE_SD) || !defined(ENABLE_EYE_PROGRAM)
+#undef ENABLE_RDA_PLAYER
+#endif
+#endif
+
+#if defined(ENABLE_MJPEG_PLAYER)
+
+// Motion-JPEG clips (baseline JPEG frames back to back) on the SD card,
+// played as programs after the GIFs. tools/gif_to_mjpeg.cpp makes them,
+// with a "<name>.idx" frame table next to each; a clip without one is
+// scanned on first open and gets MJPEG_DEFAULT_DELAY per frame. Clips must
+// not be larger than the panel and are centred on it.
+#ifndef MJPEG_FILES
+#define MJPEG_FILES                                \
+  {                                                \
+    "/fish.mjpeg", "/hearth.mjpeg", "/beer.mjpeg" \
+  }
+#endif
+#ifndef MJPEG_DEFAULT_DELAY
+#define MJPEG_DEFAULT_DELAY 33
+#endif
+
+#endif
+
+#if defined(ENABLE_RDA_PLAYER)
+
+// Round delta animations (.rda, include/rda_decoder.h) on the SD card,
+// played as programs after the MJPEG clips. tools/gif_to_rda.cpp makes them
+// from GIFs: raw RGB565 rows that changed, so frames are large (tens of KB)
+// but cost only copies to show. Clips must not be larger than the panel.
+#ifndef RDA_FILES
+#define RDA_FILES                              \
+  {                                            \
+    "/fish.rda", "/drop1.rda", "/optical1.rda" \
+  }
+#endif
+#ifndef RDA_DEFAULT_DELAY
+#define RDA_DEFAULT_DELAY 33
+#endif
+// Whole changed rows gathered per panel write (DISPLAY_WIDTH pixels each,
+// internal RAM).
+#ifndef RDA_BAND_LINES
+#define RDA_BAND_LINES 16
+#endif
+
+#endif
+
 #if defined(ENABLE_EYE_PROGRAM) || (!defined(ENABLE_ANIMATED_GIF) && !defined(ENABLE_HYPNO_SPIRAL))
 
 // GRAPHICS SETTINGS (appearance of eye) -----------------------------------
@@ -10,6 +10,7 @@
 #include <Arduino_GFX_Library.h>
 
 #include "eye_assets.h"
+#include "panel_pixels.h"
 
 #ifndef USBSerial
 #define USBSerial Serial
@@ -72,6 +73,7 @@ uint16_t newIris = 0;
 static bool irisValueNeedsReset = true;
 
 #if defined(ENABLE_EYELIDS) && defined(ENABLE_EYELID_SHADING)
+// Shadow-to-highlight ramp, in panel byte order.
 static uint16_t eyelidShadeLut[256];
 static bool eyelidShadeLutReady = false;
 
@@ -96,7 +98,7 @@ static void initEyelidShadeLut()
     const int16_t r = static_cast<int16_t>(r0 + ((r1 - r0) * static_cast<int16_t>(i)) / 255);
     const int16_t g = static_cast<int16_t>(g0 + ((g1 - g0) * static_cast<int16_t>(i)) / 255);
     const int16_t b = static_cast<int16_t>(b0 + ((b1 - b0) * static_cast<int16_t>(i)) / 255);
-    eyelidShadeLut[i] = static_cast<uint16_t>(((r & 0x1F) << 11) | ((g & 0x3F) << 5) | (b & 0x1F));
+    eyelidShadeLut[i] = panelPixel(static_cast<uint16_t>(((r & 0x1F) << 11) | ((g & 0x3F) << 5) | (b & 0x1F)));
   }
 
   eyelidShadeLutReady = true;
@@ -247,6 +249,14 @@ void drawEye( // Renders one eye.  Inputs must be pre-clipped & valid.
   uint32_t d;
 
   uint32_t pixelIndex = 0;
+  // Asset textures are host-order RGB565, and stay so on purpose: the tables
+  // in data/ come from tools/image_to_c, which is only checked in as a
+  // binary. Each texel is swapped by panelPixel() as it is sampled, in the
+  // pass that fills the frame buffer anyway, so the buffer holds panelPixel()
+  // values and is sent without another pass.
+#if defined(ENABLE_EYELIDS) && defined(ENABLE_EYELASHES)
+  constexpr uint16_t lashColor = panelPixel(EYELASH_COLOR);
+#endif
 
   scleraXsave = scleraX; // Save initial X value to reset on each line
   irisY       = scleraY - (scleraHeight - irisHeight) / 2;
@@ -282,15 +292,15 @@ void drawEye( // Renders one eye.  Inputs must be pre-clipped & valid.
   #endif
       } else if ((irisY < 0) || (irisY >= irisHeight) ||
                  (irisX < 0) || (irisX >= irisWidth)) { // In sclera
-        p = pgm_read_word(scleraPixels + scleraY * scleraWidth + scleraX);
+        p = panelPixel(pgm_read_word(scleraPixels + scleraY * scleraWidth + scleraX));
       } else {                                          // Maybe iris...
         p = pgm_read_word(polarMap + irisY * irisWidth + irisX);                        // Polar angle/dist
         d = (iScale * (p & 0x7F)) / 128;                // Distance (Y)
         if (d < irisMapHeight) {                      // Within iris area
           a = (irisMapWidth * (p >> 7)) / 512;        // Angle (X)
-          p = pgm_read_word(irisPixels + d * irisMapWidth + a);                           // Pixel = iris
+          p = panelPixel(pgm_read_word(irisPixels + d * irisMapWidth + a));               // Pixel = iris
         } else {                                        // Not in iris
-          p = pgm_read_word(scleraPixels + scleraY * scleraWidth + scleraX);               // Pixel = sclera
+          p = panelPixel(pgm_read_word(scleraPixels + scleraY * scleraWidth + scleraX));   // Pixel = sclera
         }
       }
 #if defined(ENABLE_EYELIDS) && defined(ENABLE_EYELASHES)
@@ -312,7 +322,7 @@ void drawEye( // Renders one eye.  Inputs must be pre-clipped & valid.
           {
             if (dist <= EYELASH_BASE_THICKNESS || hash < EYELASH_DENSITY)
             {
-              p = EYELASH_COLOR;
+              p = lashColor;
             }
           }
         }
@@ -335,7 +345,7 @@ void drawEye( // Renders one eye.  Inputs must be pre-clipped & valid.
           {
             if (dist <= EYELASH_LOWER_BASE_THICKNESS || hash < EYELASH_LOWER_DENSITY)
             {
-              p = EYELASH_COLOR;
+              p = lashColor;
             }
           }
         }
@@ -354,7 +364,7 @@ void drawEye( // Renders one eye.  Inputs must be pre-clipped & valid.
 #if defined(EYE_SCALE_TO_DISPLAY) && (NUM_EYES == 1)
   if (screenWidth == DISPLAY_WIDTH && screenHeight == DISPLAY_HEIGHT)
   {
-    gfx->draw16bitRGBBitmap(0, 0, eyeFrameBuffer, screenWidth, screenHeight);
+    drawPanelPixels(gfx, 0, 0, eyeFrameBuffer, screenWidth, screenHeight);
     return;
   }
 
@@ -389,11 +399,11 @@ void drawEye( // Renders one eye.  Inputs must be pre-clipped & valid.
         scaledChunk[dstRow + x] = eyeFrameBuffer[srcRow + xMap[x]];
       }
     }
-    gfx->draw16bitRGBBitmap(0, y0, scaledChunk, DISPLAY_WIDTH, lines);
+    drawPanelPixels(gfx, 0, y0, scaledChunk, DISPLAY_WIDTH, lines);
     yield();
   }
 #else
-  gfx->draw16bitRGBBitmap(eye[e].xposition, eye[e].yposition, eyeFrameBuffer, screenWidth, screenHeight);
+  drawPanelPixels(gfx, eye[e].xposition, eye[e].yposition, eyeFrameBuffer, screenWidth, screenHeight);
 #endif
 }
 
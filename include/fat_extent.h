@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Where a file sits on a FAT16/FAT32 volume, read straight from the volume's
+// sectors. A file whose clusters form one run can then be read with
+// multi-sector reads at `firstSector + offset / 512` without going through
+// the FAT layer's cluster walk and sector buffer.
+struct FatExtent
+{
+  uint32_t firstSector;
+  uint32_t sectorCount;
+  uint32_t fileSize;
+};
+
+enum class FatFileLayout : uint8_t
+{
+  Missing,
+  Fragmented,
+  Contiguous,
+};
+
+class FatVolume
+{
+public:
+  static constexpr uint32_t SECTOR_SIZE = 512;
+
+  // Reads `count` sectors from `sector` (counted from the start of the
+  // card or image) into `dest`.
+  using SectorReader = bool (*)(void *context, uint32_t sector, uint8_t *dest, uint32_t count);
+
+  // Finds the FAT volume at sector 0 or in the first MBR partition. False
+  // for anything but FAT16/FAT32 with 512-byte sectors (exFAT included).
+  bool mount(SectorReader reader, void *context);
+  bool mounted() const { return reader_ != nullptr; }
+  // Looks up an absolute path ("/dir/name.gif", case-insensitive, long names
+  // included) and, when its clusters are one run, fills `extent`.
+  FatFileLayout locate(const char *path, FatExtent *extent);
+
+private:
+  struct DirEntry
+  {
+    uint32_t firstCluster;
+    uint32_t size;
+    bool directory;
+  };
+
+  bool readSector(uint32_t sector);
+  uint32_t clusterSector(uint32_t cluster) const { return dataStart_ + (cluster - 2) * sectorsPerCluster_; }
+  bool nextCluster(uint32_t cluster, uint32_t *next);
+  bool endOfChain(uint32_t cluster) const { return cluster >= (fat32_ ? 0x0FFFFFF8UL : 0xFFF8UL); }
+  // Searches directory `cluster` (0: the FAT16 root) for `name`.
+  bool findEntry(uint32_t cluster, const char *name, size_t nameLength, DirEntry *entry);
+
+  SectorReader reader_ = nullptr;
+  void *context_ = nullptr;
+  bool fat32_ = false;
+  uint32_t sectorsPerCluster_ = 0;
+  uint32_t fatStart_ = 0;
+  uint32_t rootStart_ = 0;
+  uint32_t rootSectors_ = 0;
+  uint32_t rootCluster_ = 0;
+  uint32_t dataStart_ = 0;
+  uint32_t clusterCount_ = 0;
+  uint32_t bufferedSector_ = UINT32_MAX;
+  uint8_t sector_[SECTOR_SIZE];
+};
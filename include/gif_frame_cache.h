@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Composited frames of looping GIFs, recorded in canvas coordinates during the
+// first pass and replayed on later loops without decoding. Frames are stored
+// as 8-bit indices plus one palette while the composite uses at most 256
+// colours, and as RGB565 otherwise.
+struct GifCachedFrame
+{
+  uint8_t *pixels;
+  uint16_t delayMs;
+  uint32_t decodeMicros;
+};
+
+struct GifFrameCacheEntry
+{
+  size_t fileIndex;
+  uint16_t width;
+  uint16_t height;
+  bool indexed;
+  bool complete;
+  uint16_t frameCount;
+  uint16_t frameCapacity;
+  GifCachedFrame *frames;
+  uint16_t paletteSize;
+  uint16_t palette[256];
+  size_t bytes;
+  uint32_t lastUsed;
+};
+
+class GifFrameCache
+{
+public:
+  static constexpr size_t kMaxEntries = 4;
+
+  void begin(size_t budgetBytes);
+
+  // Complete recording for `fileIndex`, or nullptr.
+  const GifFrameCacheEntry *find(size_t fileIndex);
+
+  // Starts a new recording; the composite canvas is filled with `background`.
+  bool startRecording(size_t fileIndex, uint16_t width, uint16_t height, uint16_t background);
+  bool isRecording() const { return recording_ != nullptr; }
+  size_t recordingFileIndex() const { return recording_ ? recording_->fileIndex : SIZE_MAX; }
+  // RGB565 composite the player keeps up to date while recording.
+  uint16_t *canvas() { return canvas_; }
+  // Snapshots the canvas as the next frame. Returns false (and drops the
+  // recording) when the file no longer fits the budget.
+  bool commitFrame(uint16_t delayMs, uint32_t decodeMicros);
+  const GifFrameCacheEntry *finishRecording();
+  void abortRecording();
+
+  size_t residentBytes() const { return bytes_; }
+
+private:
+  bool reserve(size_t bytes);
+  bool evictLeastRecentlyUsed();
+  void release(GifFrameCacheEntry &entry);
+  bool indexCanvas(uint8_t *dest);
+  bool convertToRgb565();
+  void freeRecordingBuffers();
+
+  GifFrameCacheEntry entries_[kMaxEntries] = {};
+  GifFrameCacheEntry *recording_ = nullptr;
+  uint16_t *canvas_ = nullptr;
+  uint8_t *colorIndex_ = nullptr;
+  uint8_t *colorSeen_ = nullptr;
+  size_t budget_ = 0;
+  size_t bytes_ = 0;
+  uint32_t clock_ = 0;
+};
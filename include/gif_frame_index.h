@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <AnimatedGIF.h>
+
+// Frame table of one GIF: file offset, delay, disposal method, keyframe and
+// duplicate flags per frame, from AnimatedGIF::getFrameIndex(). It is stored
+// on the card next to the GIF as "<name>.idx" so later opens read a few
+// hundred bytes instead of scanning the whole file.
+class GifFrameIndex
+{
+public:
+  // Loads the sidecar of `gifPath` if it matches the file, otherwise scans
+  // `gif` (which must be open on that file) and writes a new sidecar. False
+  // when neither worked; the file then plays without seeking.
+  bool loadOrBuild(AnimatedGIF &gif, const char *gifPath, uint32_t fileSize);
+  // Takes a copy of `frameCount` records as the table, without a file (host
+  // checks feed it simulated frames).
+  bool assign(const GIFFRAMEINFO *frames, uint16_t frameCount);
+  void clear();
+  // Times frames the way the player paces them: a missing delay becomes
+  // `defaultMs` and longer ones are cut to `maxMs` (0 = no limit).
+  void setPlaybackDelays(uint16_t defaultMs, uint16_t maxMs);
+
+  bool valid() const { return frames_ != nullptr; }
+  uint16_t frameCount() const { return frameCount_; }
+  uint32_t durationMs() const { return durationMs_; }
+  const GIFFRAMEINFO &frame(size_t index) const { return frames_[index]; }
+
+  // Nearest frame at or before `index` that decodes without the ones before
+  // it (0 when there is none; frame 0 is reached with a rewind).
+  size_t keyframeAtOrBefore(size_t index) const;
+  // Frame on screen `elapsedMs` into a loop, with the playback delays.
+  size_t frameAtTime(uint32_t elapsedMs) const;
+
+  // True when frame `index` draws the same canvas as the frame before it;
+  // the player can skip it and hold that frame for both delays.
+  bool duplicate(size_t index) const { return (frames_[index].ucFlags & GIF_FRAME_DUPLICATE) != 0; }
+  // Records that frame `index` decoded from the same bytes as the frame
+  // before (AnimatedGIF::getFrameHash()). Ignored unless both frames have the
+  // same graphic control, since the decoder applies a frame's own disposal
+  // and transparency.
+  void markDuplicate(size_t index);
+  // Frame whose image is on screen while `index` is: the first of a run of
+  // duplicates.
+  size_t shownFrame(size_t index) const;
+  // How long frame `index` is shown, with the playback delays.
+  uint32_t playbackDelayMs(size_t index) const;
+
+private:
+  bool allocate(uint16_t frameCount);
+  bool load(const char *path, uint32_t fileSize, uint16_t canvasWidth, uint16_t canvasHeight);
+  bool save(const char *path, uint32_t fileSize, uint16_t canvasWidth, uint16_t canvasHeight) const;
+  void computeStartTimes();
+
+  GIFFRAMEINFO *frames_ = nullptr;
+  // Start of each frame within a loop, for frameAtTime().
+  uint32_t *startMs_ = nullptr;
+  uint16_t frameCount_ = 0;
+  uint32_t durationMs_ = 0;
+  uint16_t defaultDelayMs_ = 0;
+  uint16_t maxDelayMs_ = 0;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Arduino_GFX;
+
+// Pixels handed to blit() (clipped to the panel) against pixels and address
+// windows actually sent.
+struct GifPanelDiffStats
+{
+  uint32_t pixelsIn;
+  uint32_t pixelsSent;
+  uint32_t writes;
+};
+
+// Copy of what the panel shows (panelPixel() values, PSRAM) in front of the
+// player's blits. Each row of a write is compared with it and only the changed
+// spans are sent: spans fewer than `mergeGap` pixels apart go out as one, a row
+// that changed over `fullRowPercent` of its width goes out whole, and
+// consecutive whole rows of a write go out as one rectangle. Only pixels the player has
+// drawn since invalidate() are trusted, so anything else drawn on the panel is
+// overwritten rather than skipped.
+class GifPanelDiff
+{
+public:
+  // Allocates the copy; without it blit() sends every write unchanged.
+  bool begin(uint16_t width, uint16_t height, uint16_t mergeGap, uint8_t fullRowPercent);
+  bool active() const { return shadow_ != nullptr; }
+  // The panel was drawn on outside blit().
+  void invalidate();
+  // Copies what the player has drawn into `dest` (width x height) with
+  // `fill` wherever the copy is not trusted. False when nothing is trusted.
+  bool copyTo(uint16_t *dest, uint16_t fill) const;
+
+  void blit(Arduino_GFX *gfx, int16_t x, int16_t y, uint16_t *pixels, int16_t width, int16_t height);
+
+  const GifPanelDiffStats &stats() const { return stats_; }
+  void resetStats();
+
+private:
+  static constexpr size_t MAX_ROW_SPANS = 16;
+
+  // Finds the changed spans of one clipped row into spans_ and returns how
+  // many pixels they cover.
+  int16_t diffRow(int16_t row, int16_t left, int16_t right, const uint16_t *src);
+  void updateRow(int16_t row, int16_t left, int16_t right, const uint16_t *src);
+  void send(Arduino_GFX *gfx, int16_t x, int16_t y, uint16_t *pixels, int16_t width, int16_t height);
+
+  uint16_t *shadow_ = nullptr;
+  // Part of each row the copy is known to match, [left, right).
+  int16_t *knownLeft_ = nullptr;
+  int16_t *knownRight_ = nullptr;
+  uint16_t width_ = 0;
+  uint16_t height_ = 0;
+  uint16_t mergeGap_ = 0;
+  uint8_t fullRowPercent_ = 100;
+  int16_t spans_[MAX_ROW_SPANS * 2] = {};
+  size_t spanCount_ = 0;
+  GifPanelDiffStats stats_ = {};
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// What the card holds for each entry of the compile-time playlist
+// (ANIMATED_GIF_FILES). Entries keep their playlist position, which is the
+// GIF program number, so a file missing from the card stays in the list but
+// is never opened. The table is stored on the card (ANIMATED_GIF_PLAYLIST_INDEX)
+// and reused while the GIFs in the root directory keep their names, sizes and
+// write times; otherwise only the files whose size or checksum changed are
+// parsed again.
+struct GifPlaylistEntry
+{
+  uint32_t pathHash;
+  uint32_t fileSize; // 0: not on the card
+  // FNV-1a over the first and last sector and the size; catches a file
+  // replaced by one of the same size without reading all of it.
+  uint32_t checksum;
+  uint32_t durationMs;
+  uint16_t canvasWidth;
+  uint16_t canvasHeight;
+  uint16_t frameCount;
+  uint16_t reserved;
+};
+
+class GifPlaylist
+{
+public:
+  // Lists the root directory, then loads the index or rebuilds it. Runs once;
+  // later calls return straight away.
+  void load(const char *const *paths, size_t count);
+  bool loaded() const { return entries_ != nullptr; }
+  // True only for entries known to be absent (or unreadable); before a
+  // successful load() every entry may be there.
+  bool missing(size_t index) const { return entries_ && index < count_ && entries_[index].fileSize == 0; }
+  const GifPlaylistEntry &entry(size_t index) const { return entries_[index]; }
+  size_t presentCount() const;
+
+private:
+  uint32_t listDirectory(const char *const *paths);
+  bool readIndex(GifPlaylistEntry *stored, uint32_t *signature, uint32_t *scanMs) const;
+  bool writeIndex(uint32_t signature, uint32_t scanMs) const;
+
+  GifPlaylistEntry *entries_ = nullptr;
+  size_t count_ = 0;
+};
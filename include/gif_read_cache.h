@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <FS.h>
+
+#include "fat_extent.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#endif
+
+// Read-ahead window in front of an SD `File`. The GIF decoder asks for data in
+// tiny pieces (a 1-byte sub-block length, then up to 255 bytes); these are
+// served from one large sector-aligned buffer so the FAT/SD stack only sees
+// big sequential reads. With the I/O task running there are two windows: while
+// the decoder consumes one, the task reads the part of the file after it into
+// the other in one burst, so streaming rarely waits for the card. Windows of a
+// file stored in one run of clusters are read as raw sectors, past the FAT
+// layer.
+struct GifReadCacheStats
+{
+  uint32_t readCalls;
+  uint32_t bytesServed;
+  uint32_t mapCalls;
+  uint32_t refills;
+  uint32_t bytesFromCard;
+  // Part of bytesFromCard read as raw sectors.
+  uint32_t bytesDirect;
+  uint32_t ioMicros;
+  // Windows the I/O task read ahead, and how many of them the decoder used.
+  uint32_t prefetches;
+  uint32_t prefetchHits;
+  // Times the decoder had to wait for a read ahead still in flight.
+  uint32_t stalls;
+  uint32_t stallMicros;
+};
+
+class GifReadCache
+{
+public:
+  // Allocates the window (PSRAM on ESP32). Without it reads go straight to
+  // the file.
+  bool begin(size_t capacity);
+  // Allocates the second window and starts the I/O task on `core`.
+  bool startIoTask(int core, uint32_t stackBytes);
+  // Reads raw card sectors for files attached with an extent.
+  void setSectorReader(FatVolume::SectorReader reader, void *context);
+  // `extent` (may be nullptr) is where the file lies on the card when its
+  // clusters are contiguous.
+  void attach(File *file, int32_t fileSize, const FatExtent *extent = nullptr);
+  void detach();
+  bool attachedTo(const File *file) const { return file_ == file; }
+
+  // Copies up to `length` bytes at `position`; returns the number copied.
+  int32_t read(int32_t position, uint8_t *dest, int32_t length);
+  // Returns the buffered bytes from `position` on, refilling the window if
+  // needed, with how many follow in `available`. nullptr without a window.
+  uint8_t *map(int32_t position, int32_t *available);
+
+  const GifReadCacheStats &stats() const { return stats_; }
+  void resetStats();
+
+private:
+  struct Window
+  {
+    uint8_t *data;
+    int32_t start;
+    int32_t length;
+  };
+
+  static bool contains(const Window &window, int32_t position)
+  {
+    return position >= window.start && position < window.start + window.length;
+  }
+
+  // Returns the window holding `position`: the current one, the one read
+  // ahead, or the current one refilled from the card. nullptr past the end.
+  Window *windowFor(int32_t position);
+  bool fill(Window &window, int32_t position);
+  // Reads the window's part of the file from window.start.
+  void readWindow(Window &window);
+  int32_t readFromFile(int32_t position, uint8_t *dest, int32_t length);
+  // Whole sectors from the extent; `dest` must have room for them.
+  int32_t readFromSectors(int32_t position, uint8_t *dest, int32_t length);
+  void requestPrefetch();
+  void waitForPrefetch();
+#if defined(ARDUINO_ARCH_ESP32)
+  static void ioTaskMain(void *cache);
+#endif
+
+  File *file_ = nullptr;
+  int32_t fileSize_ = 0;
+  int32_t filePosition_ = -1;
+  FatExtent extent_ = {};
+  FatVolume::SectorReader sectorReader_ = nullptr;
+  void *sectorContext_ = nullptr;
+  size_t capacity_ = 0;
+  Window windows_[2] = {};
+  size_t current_ = 0;
+  // Set by the decoder when it hands the other window to the I/O task and
+  // cleared by the task once the read is done.
+  volatile bool prefetchBusy_ = false;
+#if defined(ARDUINO_ARCH_ESP32)
+  TaskHandle_t ioTask_ = nullptr;
+  SemaphoreHandle_t prefetchDone_ = nullptr;
+#endif
+  GifReadCacheStats stats_ = {};
+};
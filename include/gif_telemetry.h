@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdint.h>
+
+// Where the playback time of one playlist file goes, since the last reset().
+// The player keeps one per file in a fixed table, so nothing is allocated
+// while it plays. Decoding, reads and blits are counted on the thread doing
+// them and frame timing on the render thread; no two threads write the same
+// counter at once, so a dump taken meanwhile is at worst a frame out.
+// Plain C++ so a host build can feed it.
+class GifTelemetry
+{
+public:
+  // One frame through the decoder: `totalMicros` in playFrame(), of which
+  // `readMicros` went to the read callbacks and `outputMicros` to handing
+  // lines to the panel (or the ring, or the staging frame).
+  void addDecode(uint32_t totalMicros, uint32_t readMicros, uint32_t outputMicros)
+  {
+    const uint32_t other = readMicros + outputMicros;
+    const uint32_t lzw = totalMicros > other ? totalMicros - other : 0;
+    decodeMicros_ += lzw;
+    if (lzw > decodeMaxMicros_)
+    {
+      decodeMaxMicros_ = lzw;
+    }
+    ++decodes_;
+  }
+
+  // A read callback that returned `bytes`, or a map (bytes 0) that handed
+  // the decoder the read-ahead window in place.
+  void addRead(uint32_t micros, uint32_t bytes)
+  {
+    readMicros_ += micros;
+    readBytes_ += bytes;
+    ++readCalls_;
+  }
+
+  // One blit on the panel bus and the address windows it sent.
+  void addBlit(uint32_t micros, uint32_t writes)
+  {
+    blitMicros_ += micros;
+    blitWrites_ += writes;
+  }
+
+  // A frame reached the panel `achievedMs` after the one before, which asked
+  // for `requestedMs` (0 after an open or a loop wrap: not timed). It is late
+  // when it came over `lateMarginMs` after that.
+  void frameShown(uint32_t requestedMs, uint32_t achievedMs, uint32_t lateMarginMs)
+  {
+    ++frames_;
+    if (requestedMs == 0)
+    {
+      return;
+    }
+    requestedMs_ += requestedMs;
+    achievedMs_ += achievedMs;
+    ++timedFrames_;
+    if (achievedMs > requestedMs + lateMarginMs)
+    {
+      addLate(achievedMs - requestedMs);
+    }
+  }
+
+  // A frame shown `lateMs` behind its time without a delay to compare it
+  // with (the clock's catch-up frames).
+  void addLate(uint32_t lateMs)
+  {
+    ++lateFrames_;
+    if (lateMs > maxLateMs_)
+    {
+      maxLateMs_ = lateMs;
+    }
+  }
+  // Frames passed over without being shown.
+  void addDropped(uint32_t frames) { droppedFrames_ += frames; }
+
+  void reset() { *this = GifTelemetry(); }
+
+  uint32_t decodes() const { return decodes_; }
+  uint32_t decodeMicros() const { return decodeMicros_; }
+  uint32_t decodeMaxMicros() const { return decodeMaxMicros_; }
+  uint32_t readMicros() const { return readMicros_; }
+  uint32_t readBytes() const { return readBytes_; }
+  uint32_t readCalls() const { return readCalls_; }
+  uint32_t blitMicros() const { return blitMicros_; }
+  uint32_t blitWrites() const { return blitWrites_; }
+  uint32_t frames() const { return frames_; }
+  uint32_t timedFrames() const { return timedFrames_; }
+  uint32_t requestedMs() const { return requestedMs_; }
+  uint32_t achievedMs() const { return achievedMs_; }
+  uint32_t lateFrames() const { return lateFrames_; }
+  uint32_t maxLateMs() const { return maxLateMs_; }
+  uint32_t droppedFrames() const { return droppedFrames_; }
+
+private:
+  uint32_t decodes_ = 0;
+  uint32_t decodeMicros_ = 0;
+  uint32_t decodeMaxMicros_ = 0;
+  uint32_t readMicros_ = 0;
+  uint32_t readBytes_ = 0;
+  uint32_t readCalls_ = 0;
+  uint32_t blitMicros_ = 0;
+  uint32_t blitWrites_ = 0;
+  uint32_t frames_ = 0;
+  uint32_t timedFrames_ = 0;
+  uint32_t requestedMs_ = 0;
+  uint32_t achievedMs_ = 0;
+  uint32_t lateFrames_ = 0;
+  uint32_t maxLateMs_ = 0;
+  uint32_t droppedFrames_ = 0;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+// Playback clock shared by every controller showing the same preset: the
+// timebase of the last sync packet, advanced by local time since it arrived.
+// Each packet after the first is compared with what the clock predicted for
+// it (the drift) before the clock jumps to it. Plain C++ so a host build can
+// feed it simulated packets (tools/gif_clock_check.cpp); it does no locking
+// of its own.
+class GifTimebase
+{
+public:
+  void sync(uint32_t timebaseMs, uint32_t localMs)
+  {
+    if (synced_)
+    {
+      lastDriftMs_ = static_cast<int32_t>(timebaseMs - now(localMs));
+      const uint32_t drift = static_cast<uint32_t>(lastDriftMs_ < 0 ? -lastDriftMs_ : lastDriftMs_);
+      if (drift > maxDriftMs_)
+      {
+        maxDriftMs_ = drift;
+      }
+      ++resyncs_;
+    }
+    baseMs_ = timebaseMs;
+    localMs_ = localMs;
+    synced_ = true;
+  }
+
+  bool synced() const { return synced_; }
+  // A `localMs` taken before the latest packet arrived reads as that packet's
+  // timebase rather than wrapping round.
+  uint32_t now(uint32_t localMs) const
+  {
+    const int32_t elapsed = static_cast<int32_t>(localMs - localMs_);
+    return baseMs_ + static_cast<uint32_t>(elapsed > 0 ? elapsed : 0);
+  }
+
+  // Drift of the latest packet (positive: the clock was behind the sender).
+  int32_t lastDriftMs() const { return lastDriftMs_; }
+  // Largest drift and packet count since resetStats().
+  uint32_t maxDriftMs() const { return maxDriftMs_; }
+  uint32_t resyncs() const { return resyncs_; }
+  void resetStats()
+  {
+    maxDriftMs_ = 0;
+    resyncs_ = 0;
+  }
+
+private:
+  bool synced_ = false;
+  uint32_t baseMs_ = 0;
+  uint32_t localMs_ = 0;
+  int32_t lastDriftMs_ = 0;
+  uint32_t maxDriftMs_ = 0;
+  uint32_t resyncs_ = 0;
+};
@@ -2,5 +2,12 @@
 
 #include <Arduino.h>
 
+// Builds the phase map (PSRAM) the first time after boot or a teardown.
 void hypnoSetup();
+// Renders a frame in bands and streams them to the panel.
 void hypnoStep();
+// Frees the phase map; the next hypnoSetup() builds it again.
+void hypnoTeardown();
+// Something else drew on the panel: the next frame redraws the corners
+// outside the circle too.
+void hypnoInvalidatePanel();
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Baseline JPEG decoder for Motion-JPEG frames, in integer arithmetic only.
+// A frame is decoded one MCU row (8 or 16 lines) at a time into the caller's
+// band buffer as RGB565 and each band is handed to a BandWriter, so there is
+// no frame buffer. Handles greyscale and YCbCr with 4:4:4, 4:2:2 or 4:2:0
+// sampling in one interleaved scan, with restart markers; progressive and
+// arithmetic-coded files are rejected. No Arduino dependencies, so the host
+// tools build it too.
+class JpegDecoder
+{
+public:
+  static constexpr int16_t MAX_BAND_LINES = 16;
+  static constexpr uint16_t MAX_FRAME_WIDTH = 1024;
+
+  // Receives `lines` rows of `width` pixels for frame rows `y` onward.
+  using BandWriter = void (*)(void *context, int16_t y, uint16_t *pixels, int16_t width, int16_t lines);
+
+  JpegDecoder() = default;
+  ~JpegDecoder();
+  JpegDecoder(const JpegDecoder &) = delete;
+  JpegDecoder &operator=(const JpegDecoder &) = delete;
+
+  // Store pixels high byte first (the panel's order, see panel_pixels.h).
+  void setSwapBytes(bool swap) { swapBytes_ = swap; }
+
+  // Decodes one frame. `band` holds at least width() * MAX_BAND_LINES
+  // pixels. False on a malformed or unsupported frame; bands already
+  // written stay written.
+  bool decode(const uint8_t *data, size_t length, uint16_t *band, size_t bandPixels, BandWriter writer,
+              void *context);
+
+  // Size of the last frame whose header was read.
+  uint16_t width() const { return width_; }
+  uint16_t height() const { return height_; }
+
+private:
+  struct HuffmanTable
+  {
+    bool defined;
+    // (length << 8) | value for codes up to FAST_BITS long; 0 when longer.
+    uint16_t fast[1 << 9];
+    int32_t maxCode[18];
+    int32_t valueOffset[17];
+    uint8_t values[256];
+  };
+
+  struct Component
+  {
+    uint8_t id;
+    uint8_t h;
+    uint8_t v;
+    uint8_t quantTable;
+    uint8_t dcTable;
+    uint8_t acTable;
+    int32_t dcPredictor;
+  };
+
+  bool readFrameHeader(const uint8_t *p, size_t length);
+  bool readQuantTables(const uint8_t *p, size_t length);
+  bool readHuffmanTables(const uint8_t *p, size_t length);
+  bool readScanHeader(const uint8_t *p, size_t length);
+  bool allocatePlanes();
+  void freePlanes();
+
+  void fillBits();
+  uint32_t getBits(int count);
+  int decodeHuffman(const HuffmanTable &table);
+  int32_t receiveExtend(int size);
+  bool restart();
+  bool decodeBlock(Component &component, uint8_t *out, int stride);
+  bool decodeScan(uint16_t *band, BandWriter writer, void *context);
+  void convertRows(uint16_t *band, int lines) const;
+
+  HuffmanTable dcTables_[2] = {};
+  HuffmanTable acTables_[2] = {};
+  uint16_t quant_[4][64] = {};
+  Component components_[3] = {};
+  uint8_t componentCount_ = 0;
+  uint8_t maxH_ = 1;
+  uint8_t maxV_ = 1;
+  uint16_t width_ = 0;
+  uint16_t height_ = 0;
+  uint16_t restartInterval_ = 0;
+  bool swapBytes_ = false;
+
+  // One MCU row of samples per component (luma at full resolution).
+  uint8_t *planes_[3] = {};
+  size_t planeBytes_ = 0;
+  uint16_t planeStride_[3] = {};
+
+  const uint8_t *pos_ = nullptr;
+  const uint8_t *end_ = nullptr;
+  uint32_t bitBuffer_ = 0;
+  int bitCount_ = 0;
+  bool markerHit_ = false;
+};
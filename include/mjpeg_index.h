@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Frame table of one Motion-JPEG clip (JPEG frames back to back in one file):
+// offset, length and delay of every frame. tools/gif_to_mjpeg.cpp writes it
+// next to the clip as "<name>.idx" with the source GIF's delays. A clip
+// without one, or whose size no longer matches it, is scanned for its frames
+// on first open; those frames get the default delay and the table is written
+// back.
+struct MjpegIndexHeader
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t frameCount;
+  uint32_t fileSize;
+  uint16_t width;
+  uint16_t height;
+};
+
+struct MjpegFrameInfo
+{
+  uint32_t offset;
+  uint32_t length;
+  uint16_t delayMs;
+  uint16_t reserved;
+};
+
+class MjpegIndex
+{
+public:
+  static constexpr uint32_t MAGIC = 0x58494A4D; // "MJIX"
+  static constexpr uint16_t VERSION = 1;
+
+  bool loadOrBuild(const char *clipPath, uint32_t fileSize, uint16_t defaultDelayMs);
+  void clear();
+
+  bool valid() const { return frames_ != nullptr; }
+  uint16_t frameCount() const { return frameCount_; }
+  uint16_t width() const { return width_; }
+  uint16_t height() const { return height_; }
+  const MjpegFrameInfo &frame(size_t index) const { return frames_[index]; }
+  // Largest frame, for sizing the read buffer.
+  uint32_t maxFrameLength() const { return maxFrameLength_; }
+
+private:
+  bool allocate(uint16_t frameCount);
+  bool load(const char *path, uint32_t fileSize);
+  bool save(const char *path, uint32_t fileSize) const;
+  bool scan(const char *clipPath, uint16_t defaultDelayMs);
+  void finish();
+
+  MjpegFrameInfo *frames_ = nullptr;
+  uint16_t frameCount_ = 0;
+  uint16_t width_ = 0;
+  uint16_t height_ = 0;
+  uint32_t maxFrameLength_ = 0;
+};
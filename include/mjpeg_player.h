@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Motion-JPEG clips (MJPEG_FILES) streamed from SD, one frame read per
+// display frame and decoded in 16-line bands straight to the panel. Meant for
+// photographic material that dithers badly as a GIF.
+size_t mjpegClipCount();
+// Position of `path` in MJPEG_FILES, or SIZE_MAX when it is not listed.
+size_t mjpegClipIndex(const char *path);
+// True when clip `index` of MJPEG_FILES is not on the card (checked once).
+bool mjpegClipMissing(size_t index);
+bool mjpegOpenAtIndex(size_t index);
+void mjpegLoop();
+bool mjpegIsReady();
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <Arduino_GFX_Library.h>
+#include <stdint.h>
+
+#include "config.h"
+
+// RGB565 value as it is stored in a buffer handed to drawPanelPixels().
+constexpr uint16_t panelPixel(uint16_t rgb565)
+{
+#if PANEL_NATIVE_PIXELS
+  return static_cast<uint16_t>((rgb565 >> 8) | (rgb565 << 8));
+#else
+  return rgb565;
+#endif
+}
+
+// Sends a buffer of panelPixel() values. In native mode the bytes are written
+// as they are; otherwise Arduino_GFX swaps each pixel on the way out.
+inline void drawPanelPixels(Arduino_GFX *gfx, int16_t x, int16_t y, uint16_t *pixels, int16_t width,
+                            int16_t height)
+{
+#if PANEL_NATIVE_PIXELS
+  gfx->draw16bitBeRGBBitmap(x, y, pixels, width, height);
+#else
+  gfx->draw16bitRGBBitmap(x, y, pixels, width, height);
+#endif
+}
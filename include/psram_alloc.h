@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#if defined(ESP32)
+#include <esp_heap_caps.h>
+#endif
+
+// Large buffers (canvases, caches, preloaded files) live in PSRAM on ESP32.
+// Release them with free().
+inline void *psramAlloc(size_t size)
+{
+#if defined(ESP32)
+  return heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#else
+  return malloc(size);
+#endif
+}
+
+// Grows `buffer` to at least `size` bytes; the old contents are not kept.
+// `capacity` is the buffer's size and is 0 while it is unallocated.
+template <typename T, typename Capacity>
+bool psramReserve(T *&buffer, Capacity &capacity, size_t size)
+{
+  if (size <= capacity)
+  {
+    return true;
+  }
+  free(buffer);
+  buffer = static_cast<T *>(psramAlloc(size));
+  capacity = buffer ? static_cast<Capacity>(size) : 0;
+  return buffer != nullptr;
+}
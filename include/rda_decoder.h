@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Round delta animation (.rda): frames for the round panel stored as the
+// rows that changed since the frame before, so playback is copies and fills
+// with no decompression. Only pixels inside the panel's circle are stored
+// (RdaDecoder::rowSpan()). tools/gif_to_rda.cpp writes it.
+//
+// File: RdaHeader, then frameCount + 1 RdaFrameInfo (the extra one leads
+// from the last frame back to the first, for looping), then the frames.
+// Frame 0 redraws every row. A frame is 16-bit little-endian words:
+//   rowCount, then per row: y (| ROW_HAS_SKIPS), opCount, ops.
+// An op is (type << 14) | count followed by `count` pixels (COPY), one
+// pixel (FILL) or nothing (SKIP: keep what the panel shows). Ops start at
+// the row's first pixel inside the circle; a row without skips covers the
+// whole span. Pixels are RGB565 high byte first, as the panel takes them.
+struct RdaHeader
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t frameCount;
+  uint16_t width;
+  uint16_t height;
+  uint32_t reserved;
+};
+
+struct RdaFrameInfo
+{
+  uint32_t offset;
+  uint32_t length;
+  uint16_t delayMs;
+  uint16_t reserved;
+};
+
+class RdaDecoder
+{
+public:
+  static constexpr uint32_t MAGIC = 0x31414452; // "RDA1"
+  static constexpr uint16_t VERSION = 1;
+  static constexpr uint16_t OP_SKIP = 0;
+  static constexpr uint16_t OP_COPY = 1;
+  static constexpr uint16_t OP_FILL = 2;
+  static constexpr int OP_SHIFT = 14;
+  static constexpr uint16_t OP_COUNT_MASK = (1u << OP_SHIFT) - 1;
+  static constexpr uint16_t ROW_HAS_SKIPS = 0x8000;
+
+  // Receives `lines` rows of `width` pixels for the frame area at (x, y).
+  using Writer = void (*)(void *context, int16_t x, int16_t y, uint16_t *pixels, int16_t width, int16_t lines);
+
+  // Pixels [x0, x1) of row `y` whose centres lie within half a pixel of the
+  // circle inscribed in a width x height frame.
+  static void rowSpan(uint16_t width, uint16_t height, uint16_t y, uint16_t &x0, uint16_t &x1);
+
+  // Keep pixels high byte first as stored (the panel's order, see
+  // panel_pixels.h); false converts them to host order.
+  void setSwapBytes(bool swap) { swapBytes_ = swap; }
+  void setSize(uint16_t width, uint16_t height)
+  {
+    width_ = width;
+    height_ = height;
+  }
+
+  // Applies one frame. Rows without skips are gathered into `band` (at
+  // least one row of width() pixels; outside the circle they get
+  // `background`) and written as whole-width bands; rows with skips go out
+  // a span at a time. False on a malformed frame; writes already made stay.
+  bool decode(const uint8_t *data, size_t length, uint16_t *band, size_t bandPixels, uint16_t background,
+              Writer writer, void *context) const;
+
+  uint16_t width() const { return width_; }
+  uint16_t height() const { return height_; }
+
+private:
+  bool expand(const uint16_t *&p, const uint16_t *end, uint16_t type, uint16_t count, uint16_t *out) const;
+
+  uint16_t width_ = 0;
+  uint16_t height_ = 0;
+  bool swapBytes_ = false;
+};
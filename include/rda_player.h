@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Round delta animations (RDA_FILES, see rda_decoder.h) streamed from SD:
+// each frame is read in one piece and copied to the panel without any
+// decompression. Every open starts from the first frame, which redraws the
+// whole circle.
+size_t rdaClipCount();
+// Position of `path` in RDA_FILES, or SIZE_MAX when it is not listed.
+size_t rdaClipIndex(const char *path);
+// True when clip `index` of RDA_FILES is not on the card (checked once).
+bool rdaClipMissing(size_t index);
+bool rdaOpenAtIndex(size_t index);
+void rdaLoop();
+bool rdaIsReady();
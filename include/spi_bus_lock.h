@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The SD card and the panel share one SPI bus. Code that can touch the bus
+// while another task does (the GIF prepare worker reading SD while the swirl
+// draws) holds a SpiBusGuard for the duration of each transfer. The lock is
+// recursive and does nothing until spiBusLockBegin() has run.
+void spiBusLockBegin();
+
+// Who holds the bus, for the utilisation figures. Nested guards count towards
+// the outermost one.
+enum class SpiBusUser : uint8_t
+{
+  Other,
+  Sd,
+  Panel,
+  Count,
+};
+
+struct SpiBusStats
+{
+  uint32_t heldMicros[static_cast<size_t>(SpiBusUser::Count)];
+  uint32_t waitMicros[static_cast<size_t>(SpiBusUser::Count)];
+  uint32_t holds[static_cast<size_t>(SpiBusUser::Count)];
+};
+
+const SpiBusStats &spiBusStats();
+void spiBusResetStats();
+
+class SpiBusGuard
+{
+public:
+  explicit SpiBusGuard(SpiBusUser user = SpiBusUser::Other);
+  ~SpiBusGuard();
+  SpiBusGuard(const SpiBusGuard &) = delete;
+  SpiBusGuard &operator=(const SpiBusGuard &) = delete;
+};
@@ -31,6 +31,7 @@ int AnimatedGIF::open(uint8_t *pData, int iDataSize, GIF_DRAW_CALLBACK *pfnDraw)
     _gif.iError = GIF_SUCCESS;
     _gif.pfnRead = readMem;
     _gif.pfnSeek = seekMem;
+    _gif.pfnMap = mapMem;
     _gif.pfnDraw = pfnDraw;
     _gif.pfnOpen = NULL;
     _gif.pfnClose = NULL;
@@ -45,6 +46,7 @@ int AnimatedGIF::openFLASH(uint8_t *pData, int iDataSize, GIF_DRAW_CALLBACK *pfn
     _gif.iError = GIF_SUCCESS;
     _gif.pfnRead = readFLASH;
     _gif.pfnSeek = seekMem;
+    _gif.pfnMap = NULL;
     _gif.pfnDraw = pfnDraw;
     _gif.pfnOpen = NULL;
     _gif.pfnClose = NULL;
@@ -118,6 +120,14 @@ void AnimatedGIF::setTurboBuf(void *pBuf)
     _gif.pTurboBuffer = (uint8_t *)pBuf;
 } /* setTurboBuf() */
 //
+// Set the callback that exposes buffered file data in place
+// (call after open(); memory images get one automatically)
+//
+void AnimatedGIF::setMapCallback(GIF_MAP_CALLBACK *pfnMap)
+{
+    _gif.pfnMap = pfnMap;
+} /* setMapCallback() */
+//
 // Set the DRAW callback behavior to RAW (default)
 // or COOKED (requires allocating a frame buffer)
 //
@@ -209,6 +219,34 @@ int AnimatedGIF::getInfo(GIFINFO *pInfo)
    return GIF_getInfo(&_gif, pInfo);
 } /* getInfo() */
 
+int AnimatedGIF::getFrameIndex(GIFFRAMEINFO *pFrames, int iMaxFrames)
+{
+   return GIF_getFrameIndex(&_gif, pFrames, iMaxFrames);
+} /* getFrameIndex() */
+
+int AnimatedGIF::seekFrame(const GIFFRAMEINFO *pFrame)
+{
+   return GIF_seekFrame(&_gif, pFrame);
+} /* seekFrame() */
+
+//
+// Fill in what seekFrame() needs to come back to the frame playFrame() decodes
+// next: its file offset (0 at the start of the file) and the graphic control
+// in effect
+//
+void AnimatedGIF::getFramePosition(GIFFRAMEINFO *pFrame)
+{
+    memset(pFrame, 0, sizeof(GIFFRAMEINFO));
+    pFrame->iOffset = _gif.GIFFile.iPos;
+    pFrame->ucGIFBits = _gif.ucGIFBits;
+    pFrame->ucTransparent = _gif.ucTransparent;
+} /* getFramePosition() */
+
+uint32_t AnimatedGIF::getFrameHash()
+{
+    return _gif.u32FrameHash;
+} /* getFrameHash() */
+
 int AnimatedGIF::getLastError()
 {
     return _gif.iError;
@@ -222,6 +260,7 @@ int AnimatedGIF::open(const char *szFilename, GIF_OPEN_CALLBACK *pfnOpen, GIF_CL
     _gif.iError = GIF_SUCCESS;
     _gif.pfnRead = pfnRead;
     _gif.pfnSeek = pfnSeek;
+    _gif.pfnMap = NULL;
     _gif.pfnDraw = pfnDraw;
     _gif.pfnOpen = pfnOpen;
     _gif.pfnClose = pfnClose;
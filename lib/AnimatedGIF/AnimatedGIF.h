@@ -51,7 +51,9 @@
 // a 128x32 display will not need a max code size of 12 nor a palette
 // with 256 entries
 //
-#define TURBO_BUFFER_SIZE 0x6100
+// Gap between the decoded pixels and the root symbols (>= sizeof(BIGUINT))
+#define TURBO_ROOT_GAP 8
+#define TURBO_BUFFER_SIZE (0x6100 + TURBO_ROOT_GAP)
 
 // If you intend to decode generic GIFs, you want this value to be 12. If you are using GIFs solely for animations in
 // your own project, and you control the GIFs you intend to play, then you can save additional RAM here: 
@@ -145,6 +147,27 @@ typedef struct gif_info_tag
   int32_t iMinDelay; // minimum frame delay
 } GIFINFO;
 
+//
+// Frame index flags
+//
+enum {
+   GIF_FRAME_KEY = 1,           // covers the whole canvas with no transparency; decodes without earlier frames
+   GIF_FRAME_LOCAL_PALETTE = 2, // frame has its own color table
+   GIF_FRAME_INTERLACED = 4,
+   GIF_FRAME_DUPLICATE = 8      // same image data, rectangle and graphic control as the frame before (from getFrameHash()); redraws the same canvas
+};
+
+typedef struct gif_frame_info_tag
+{
+  int32_t iOffset; // file offset of the frame's first block (its extensions)
+  uint16_t iX, iY, iWidth, iHeight; // frame rectangle on the canvas
+  uint16_t iDelay; // frame delay in milliseconds, as playFrame() reports it
+  uint8_t ucGIFBits; // graphic control flags in effect (disposal method in bits 2-4)
+  uint8_t ucTransparent; // transparent color index in effect
+  uint8_t ucFlags; // GIF_FRAME_* flags
+  uint8_t ucReserved;
+} GIFFRAMEINFO;
+
 typedef struct gif_draw_tag
 {
     int iX, iY; // Corner offset of this frame on the canvas
@@ -166,6 +189,9 @@ typedef struct gif_draw_tag
 // Callback function prototypes
 typedef int32_t (GIF_READ_CALLBACK)(GIFFILE *pFile, uint8_t *pBuf, int32_t iLen);
 typedef int32_t (GIF_SEEK_CALLBACK)(GIFFILE *pFile, int32_t iPosition);
+// Optional: returns the bytes at pFile->iPos in place and sets *piAvailable to
+// how many follow contiguously, or returns NULL to fall back on pfnRead
+typedef uint8_t * (GIF_MAP_CALLBACK)(GIFFILE *pFile, int32_t *piAvailable);
 typedef void (GIF_DRAW_CALLBACK)(GIFDRAW *pDraw);
 typedef void * (GIF_OPEN_CALLBACK)(const char *szFilename, int32_t *pFileSize);
 typedef void (GIF_CLOSE_CALLBACK)(void *pHandle);
@@ -188,11 +214,13 @@ typedef struct gif_image_tag
     int iCommentPos; // file offset of start of comment data
     short sCommentLen; // length of comment
     unsigned char bEndOfFrame;
+    uint32_t u32FrameHash; // FNV-1a of the last frame's descriptor, local palette and LZW data
     unsigned char ucGIFBits, ucBackground, ucTransparent, ucCodeStart, ucMap, bUseLocalPalette;
     unsigned char ucPaletteType; // RGB565 or RGB888
     unsigned char ucDrawType; // RAW or COOKED
     GIF_READ_CALLBACK *pfnRead;
     GIF_SEEK_CALLBACK *pfnSeek;
+    GIF_MAP_CALLBACK *pfnMap; // lets GIFGetMoreData() de-chunk LZW data in place
     GIF_DRAW_CALLBACK *pfnDraw;
     GIF_OPEN_CALLBACK *pfnOpen;
     GIF_CLOSE_CALLBACK *pfnClose;
@@ -235,6 +263,7 @@ class AnimatedGIF
     int allocFrameBuf(GIF_ALLOC_CALLBACK *pfnAlloc);
     void setTurboBuf(void *pTurboBuffer);
     void setFrameBuf(void *pFrameBuffer);
+    void setMapCallback(GIF_MAP_CALLBACK *pfnMap);
     int setDrawType(int iType);
     int freeFrameBuf(GIF_FREE_CALLBACK *pfnFree);
     int freeTurboBuf(GIF_FREE_CALLBACK *pfnFree);
@@ -243,6 +272,10 @@ class AnimatedGIF
     int getCanvasHeight();
     int getLoopCount();
     int getInfo(GIFINFO *pInfo);
+    int getFrameIndex(GIFFRAMEINFO *pFrames, int iMaxFrames);
+    int seekFrame(const GIFFRAMEINFO *pFrame);
+    void getFramePosition(GIFFRAMEINFO *pFrame);
+    uint32_t getFrameHash();
     int getLastError();
     int getComment(char *destBuffer);
 
@@ -261,6 +294,9 @@ class AnimatedGIF
     int GIF_getCanvasHeight(GIFIMAGE *pGIF);
     int GIF_getComment(GIFIMAGE *pGIF, char *destBuffer);
     int GIF_getInfo(GIFIMAGE *pGIF, GIFINFO *pInfo);
+    int GIF_getFrameIndex(GIFIMAGE *pGIF, GIFFRAMEINFO *pFrames, int iMaxFrames);
+    int GIF_seekFrame(GIFIMAGE *pGIF, const GIFFRAMEINFO *pFrame);
+    uint32_t GIF_getFrameHash(GIFIMAGE *pGIF);
     int GIF_getLastError(GIFIMAGE *pGIF);
     int GIF_getLoopCount(GIFIMAGE *pGIF);
 #endif // __cplusplus
@@ -31,12 +31,16 @@ static const unsigned char cGIFBits[9] = {1,4,4,4,8,8,8,8,8}; // convert odd bpp
 static int GIFInit(GIFIMAGE *pGIF);
 static int GIFParseInfo(GIFIMAGE *pPage, int bInfoOnly);
 static int GIFGetMoreData(GIFIMAGE *pPage);
+static uint32_t GIFHashBytes(uint32_t u32Hash, const uint8_t *pData, int iLen);
 static void GIFMakePels(GIFIMAGE *pPage, unsigned int code);
 static int DecodeLZW(GIFIMAGE *pImage, int iOptions);
 static int DecodeLZWTurbo(GIFIMAGE *pImage, int iOptions);
 static int32_t readMem(GIFFILE *pFile, uint8_t *pBuf, int32_t iLen);
 static int32_t seekMem(GIFFILE *pFile, int32_t iPosition);
+static uint8_t *mapMem(GIFFILE *pFile, int32_t *piAvailable);
 int GIF_getInfo(GIFIMAGE *pPage, GIFINFO *pInfo);
+int GIF_getFrameIndex(GIFIMAGE *pPage, GIFFRAMEINFO *pFrames, int iMaxFrames);
+int GIF_seekFrame(GIFIMAGE *pPage, const GIFFRAMEINFO *pFrame);
 #if defined( PICO_BUILD ) || defined( __LINUX__ ) || defined( __MCUXPRESSO )
 static int32_t readFile(GIFFILE *pFile, uint8_t *pBuf, int32_t iLen);
 static int32_t seekFile(GIFFILE *pFile, int32_t iPosition);
@@ -48,6 +52,7 @@ int GIF_openRAM(GIFIMAGE *pGIF, uint8_t *pData, int iDataSize, GIF_DRAW_CALLBACK
     pGIF->iError = GIF_SUCCESS;
     pGIF->pfnRead = readMem;
     pGIF->pfnSeek = seekMem;
+    pGIF->pfnMap = mapMem;
     pGIF->pfnDraw = pfnDraw;
     pGIF->pfnOpen = NULL;
     pGIF->pfnClose = NULL;
@@ -62,6 +67,7 @@ int GIF_openFile(GIFIMAGE *pGIF, const char *szFilename, GIF_DRAW_CALLBACK *pfnD
     pGIF->iError = GIF_SUCCESS;
     pGIF->pfnRead = readFile;
     pGIF->pfnSeek = seekFile;
+    pGIF->pfnMap = NULL;
     pGIF->pfnDraw = pfnDraw;
     pGIF->pfnOpen = NULL;
     pGIF->pfnClose = closeFile;
@@ -159,6 +165,11 @@ int32_t iOldPos;
 
 } /* GIF_getComment() */
 
+uint32_t GIF_getFrameHash(GIFIMAGE *pGIF)
+{
+    return pGIF->u32FrameHash;
+} /* GIF_getFrameHash() */
+
 int GIF_getLastError(GIFIMAGE *pGIF)
 {
     return pGIF->iError;
@@ -182,6 +193,14 @@ static int32_t readMem(GIFFILE *pFile, uint8_t *pBuf, int32_t iLen)
     return iBytesRead;
 } /* readMem() */
 
+static uint8_t *mapMem(GIFFILE *pFile, int32_t *piAvailable)
+{
+    *piAvailable = pFile->iSize - pFile->iPos;
+    if (*piAvailable <= 0)
+       return NULL;
+    return &pFile->pData[pFile->iPos];
+} /* mapMem() */
+
 #ifndef __LINUX__
 static int32_t readFLASH(GIFFILE *pFile, uint8_t *pBuf, int32_t iLen)
 {
@@ -269,7 +288,7 @@ static int GIFParseInfo(GIFIMAGE *pPage, int bInfoOnly)
     int i, j, iColorTableBits;
     int iBytesRead;
     unsigned char c, *p;
-    int32_t iOffset = 0;
+    int32_t iOffset = 0, iDescStart;
     int32_t iStartPos = pPage->GIFFile.iPos; // starting file position
     int iReadSize;
     
@@ -443,6 +462,7 @@ static int GIFParseInfo(GIFIMAGE *pPage, int bInfoOnly)
 
     if (p[iOffset] == ',')
         iOffset++;
+    iDescStart = iOffset;
     // This particular frame's size and position on the main frame (if animated)
     pPage->iX = INTELSHORT(&p[iOffset]);
     pPage->iY = INTELSHORT(&p[iOffset+2]);
@@ -499,6 +519,8 @@ static int GIFParseInfo(GIFIMAGE *pPage, int bInfoOnly)
         pPage->bUseLocalPalette = 1;
     }
     pPage->ucCodeStart = p[iOffset++]; /* initial code size */
+    // frame hash: rectangle, flags, local palette and code size, then the LZW data as it is read
+    pPage->u32FrameHash = GIFHashBytes(2166136261u, &p[iDescStart], iOffset - iDescStart);
     /* Since GIF can be 1-8 bpp, we only allow 1,4,8 */
     pPage->iBpp = cGIFBits[pPage->ucCodeStart];
     // we are re-using the same buffer turning GIF file data
@@ -528,6 +550,7 @@ static int GIFParseInfo(GIFIMAGE *pPage, int bInfoOnly)
      if (c == 0)
         pPage->bEndOfFrame = 1; // signal not to read beyond the end of the frame
    }
+   pPage->u32FrameHash = GIFHashBytes(pPage->u32FrameHash, pPage->ucLZW, pPage->iLZWSize);
 // seeking on an SD card is VERY VERY SLOW, so use the data we've already read by de-chunking it
 // in this case, there's too much data, so we have to seek backwards a bit
    if (iOffset < iBytesRead)
@@ -728,6 +751,165 @@ gifpagesz:
     return 1;
 } /* GIF_getInfo() */
 
+//
+// Keep at least iNeed bytes of the file buffer available at *piOff for
+// GIF_getFrameIndex(); *piBase is the file offset of ucFileBuf[0].
+// An offset that was skipped past the buffered data is reached with a seek.
+// Returns 0 if the file ends first
+//
+static int GIFIndexFill(GIFIMAGE *pPage, int *piOff, int *piAvail, int32_t *piBase, int iNeed)
+{
+    uint8_t *cBuf = pPage->ucFileBuf;
+    int iReadAmount;
+
+    if (*piAvail - *piOff >= iNeed)
+        return 1;
+    if (*piOff > *piAvail) { // skipped beyond the buffered data
+        *piBase += *piOff;
+        *piAvail = 0;
+        (*pPage->pfnSeek)(&pPage->GIFFile, *piBase);
+    } else {
+        memmove(cBuf, &cBuf[*piOff], *piAvail - *piOff); // move existing data down
+        *piBase += *piOff;
+        *piAvail -= *piOff;
+    }
+    *piOff = 0;
+    iReadAmount = FILE_BUF_SIZE - *piAvail;
+    if (*piBase + *piAvail + iReadAmount > pPage->GIFFile.iSize)
+        iReadAmount = pPage->GIFFile.iSize - *piBase - *piAvail;
+    if (iReadAmount > 0) {
+        iReadAmount = (*pPage->pfnRead)(&pPage->GIFFile, &cBuf[*piAvail], iReadAmount);
+        if (iReadAmount > 0)
+            *piAvail += iReadAmount;
+    }
+    return (*piAvail - *piOff >= iNeed);
+} /* GIFIndexFill() */
+//
+// FNV-1a over a run of bytes, continuing from u32Hash
+//
+static uint32_t GIFHashBytes(uint32_t u32Hash, const uint8_t *pData, int iLen)
+{
+    while (iLen-- > 0) {
+        u32Hash ^= *pData++;
+        u32Hash *= 16777619u;
+    }
+    return u32Hash;
+} /* GIFHashBytes() */
+//
+// Build a table of frame offsets, delays, disposal methods and keyframes so
+// a player can seek with GIF_seekFrame() instead of decoding from the start.
+// Fills up to iMaxFrames entries (pFrames may be NULL to just count) and
+// returns the number of frames in the file. The file position is restored.
+// Image data is seeked past, not read; repeats of the frame before are found
+// with GIF_getFrameHash() as the frames are decoded.
+//
+int GIF_getFrameIndex(GIFIMAGE *pPage, GIFFRAMEINFO *pFrames, int iMaxFrames)
+{
+    uint8_t *cBuf = pPage->ucFileBuf;
+    int32_t iOldPos = pPage->GIFFile.iPos;
+    int32_t iBase = 0, iFrameStart;
+    int iOff, iAvail = 0, iNumFrames = 0;
+    int iDelay;
+    uint8_t c, ucGIFBits = 0, ucTransparent = 0;
+
+    (*pPage->pfnSeek)(&pPage->GIFFile, 0);
+    iOff = 0;
+    if (!GIFIndexFill(pPage, &iOff, &iAvail, &iBase, 13))
+        goto gifindexdone;
+    c = cBuf[10]; // get info bits
+    iOff = 13; // skip header, flags, background color & aspect ratio
+    if (c & 0x80) // skip the global color table
+        iOff += (2 << (c & 7)) * 3;
+    for (;;)
+    {
+        iFrameStart = iBase + iOff;
+        iDelay = 0; // may not have a gfx extension block
+        for (;;) // extension blocks up to the image descriptor
+        {
+            if (!GIFIndexFill(pPage, &iOff, &iAvail, &iBase, 3) || cBuf[iOff] == 0x3b)
+                goto gifindexdone;
+            if (cBuf[iOff] == 0x2c)
+                break;
+            if (cBuf[iOff] != 0x21) // corrupt data, stop here
+                goto gifindexdone;
+            if (cBuf[iOff+1] == 0xf9 && cBuf[iOff+2] == 4) // Graphic Control Extension
+            {
+                if (!GIFIndexFill(pPage, &iOff, &iAvail, &iBase, 8))
+                    goto gifindexdone;
+                ucGIFBits = cBuf[iOff+3];
+                iDelay = INTELSHORT(&cBuf[iOff+4]) * 10; // same rule as GIFParseInfo()
+                if (iDelay <= 1)
+                    iDelay = 100;
+                if (ucGIFBits & 1)
+                    ucTransparent = cBuf[iOff+6];
+            }
+            iOff += 2; // skip to the first sub-block length
+            do { // skip all data sub-blocks
+                if (!GIFIndexFill(pPage, &iOff, &iAvail, &iBase, 1))
+                    goto gifindexdone;
+                c = cBuf[iOff++];
+                iOff += c;
+            } while (c);
+        }
+        if (!GIFIndexFill(pPage, &iOff, &iAvail, &iBase, 11))
+            goto gifindexdone;
+        if (pFrames && iNumFrames < iMaxFrames)
+        {
+            GIFFRAMEINFO *pFrame = &pFrames[iNumFrames];
+            pFrame->iOffset = iFrameStart;
+            pFrame->iX = INTELSHORT(&cBuf[iOff+1]);
+            pFrame->iY = INTELSHORT(&cBuf[iOff+3]);
+            pFrame->iWidth = INTELSHORT(&cBuf[iOff+5]);
+            pFrame->iHeight = INTELSHORT(&cBuf[iOff+7]);
+            pFrame->iDelay = (uint16_t)iDelay;
+            pFrame->ucGIFBits = ucGIFBits;
+            pFrame->ucTransparent = ucTransparent;
+            pFrame->ucReserved = 0;
+            pFrame->ucFlags = 0;
+            if (cBuf[iOff+9] & 0x80)
+                pFrame->ucFlags |= GIF_FRAME_LOCAL_PALETTE;
+            if (cBuf[iOff+9] & 0x40)
+                pFrame->ucFlags |= GIF_FRAME_INTERLACED;
+            if (pFrame->iX == 0 && pFrame->iY == 0 && pFrame->iWidth == pPage->iCanvasWidth &&
+                pFrame->iHeight == pPage->iCanvasHeight && !(ucGIFBits & 1))
+                pFrame->ucFlags |= GIF_FRAME_KEY;
+        }
+        c = cBuf[iOff+9];
+        iOff += 10; // skip image position, size and flags
+        if (c & 0x80) // skip the local color table
+            iOff += (2 << (c & 7)) * 3;
+        iOff++; // skip LZW code size byte
+        do { // skip the image data sub-blocks
+            if (!GIFIndexFill(pPage, &iOff, &iAvail, &iBase, 1))
+                goto gifindexdone; // truncated frame, don't count it
+            c = cBuf[iOff++];
+            iOff += c;
+        } while (c);
+        iNumFrames++;
+    }
+gifindexdone:
+    (*pPage->pfnSeek)(&pPage->GIFFile, iOldPos);
+    return iNumFrames;
+} /* GIF_getFrameIndex() */
+//
+// Position the decoder on a frame found by GIF_getFrameIndex(). The next
+// GIF_playFrame() decodes that frame onto the current canvas, so seek to a
+// GIF_FRAME_KEY frame unless the canvas already holds the frame before it.
+//
+int GIF_seekFrame(GIFIMAGE *pPage, const GIFFRAMEINFO *pFrame)
+{
+    if (pFrame->iOffset <= 0 || pFrame->iOffset >= pPage->GIFFile.iSize)
+    {
+        pPage->iError = GIF_INVALID_PARAMETER;
+        return 0;
+    }
+    pPage->iError = GIF_SUCCESS;
+    pPage->ucGIFBits = pFrame->ucGIFBits; // a frame without a graphic control block inherits these
+    pPage->ucTransparent = pFrame->ucTransparent;
+    (*pPage->pfnSeek)(&pPage->GIFFile, pFrame->iOffset);
+    return 1;
+} /* GIF_seekFrame() */
+
 //
 // Unpack more chunk data for decoding
 // returns 1 to signify more data available for this image
@@ -736,7 +918,7 @@ gifpagesz:
 static int GIFGetMoreData(GIFIMAGE *pPage)
 {
     int iDelta = (pPage->iLZWSize - pPage->iLZWOff);
-    int iLZWBufSize;
+    int iLZWBufSize, iNewStart;
     unsigned char c = 1;
     
     // Turbo mode uses combined buffers to read more compressed data
@@ -746,20 +928,42 @@ static int GIFGetMoreData(GIFIMAGE *pPage)
         return 1; // frame is finished or buffer is already full; no need to read more data
     if (pPage->iLZWOff != 0)
     {
-// NB: memcpy() fails on some systems because the src and dest ptrs overlap
-// so copy the bytes in a simple loop to avoid problems
-      for (int i=0; i<pPage->iLZWSize - pPage->iLZWOff; i++) {
-         pPage->ucLZW[i] = pPage->ucLZW[i + pPage->iLZWOff];
-      }
-      pPage->iLZWSize -= pPage->iLZWOff;
+      memmove(pPage->ucLZW, &pPage->ucLZW[pPage->iLZWOff], iDelta); // src and dest overlap
+      pPage->iLZWSize = iDelta;
       pPage->iLZWOff = 0;
     }
+    iNewStart = pPage->iLZWSize;
     while (c && pPage->GIFFile.iPos < pPage->GIFFile.iSize && pPage->iLZWSize < (iLZWBufSize-MAX_CHUNK_SIZE))
     {
+        if (pPage->pfnMap)
+        {
+            // Walk the sub-block length bytes directly in the source data and
+            // copy every sub-block that lies wholly inside it
+            int32_t iAvail, iUsed = 0;
+            uint8_t *s = (*pPage->pfnMap)(&pPage->GIFFile, &iAvail);
+            if (s)
+            {
+                while (iUsed < iAvail && pPage->iLZWSize < (iLZWBufSize-MAX_CHUNK_SIZE))
+                {
+                    c = s[iUsed];
+                    if (iUsed + 1 + c > iAvail)
+                        break; // straddles the end of the mapped data; read it below
+                    memcpy(&pPage->ucLZW[pPage->iLZWSize], &s[iUsed+1], c);
+                    pPage->iLZWSize += c;
+                    iUsed += 1 + c;
+                    if (c == 0)
+                        break; // block terminator
+                }
+                pPage->GIFFile.iPos += iUsed;
+                if (iUsed != 0)
+                    continue;
+            }
+        }
         (*pPage->pfnRead)(&pPage->GIFFile, &c, 1); // current length
         (*pPage->pfnRead)(&pPage->GIFFile, &pPage->ucLZW[pPage->iLZWSize], c);
         pPage->iLZWSize += c;
     }
+    pPage->u32FrameHash = GIFHashBytes(pPage->u32FrameHash, &pPage->ucLZW[iNewStart], pPage->iLZWSize - iNewStart);
     if (c == 0) // end of frame
         pPage->bEndOfFrame = 1;
     return (c != 0 && pPage->GIFFile.iPos < pPage->GIFFile.iSize); // more data available?
@@ -922,6 +1126,8 @@ static void DrawCooked(GIFIMAGE *pPage, GIFDRAW *pDraw, void *pDest)
                     if (c != ucTransparent) {
                         *d = pPal[c];
                         *d8 = c;
+                    } else {
+                        *d = pPal[*d8]; // the cooked line is scratch space; show the pixel kept in the canvas
                     }
                     d++;
                     d8++;
@@ -931,7 +1137,7 @@ static void DrawCooked(GIFIMAGE *pPage, GIFDRAW *pDraw, void *pDest)
 #if REGISTER_WIDTH == 64
             // parallelize the writes
             // optimizing for the write buffer helps; reading 4 bytes at a time vs 1 doesn't on M1
-            while (s < pEnd + 4) { // group 4 pixels
+            while (s + 4 <= pEnd) { // group 4 pixels (the tail loop below finishes the line)
                 BIGUINT bu;
                 uint8_t s0, s1, s2, s3;
                 uint16_t d1, d2, d3;
@@ -1163,16 +1369,19 @@ uint16_t *pLengths;
     eoi = cc + 1;
     iUncompressedLen = (pImage->iWidth * pImage->iHeight);
     buf = (uint8_t *)pImage->pTurboBuffer;
-    pSymbols = (uint32_t *)&buf[iUncompressedLen+256]; // we need 32-bits (really 23) for the offsets
+    // The root symbol bytes sit TURBO_ROOT_GAP bytes past the image so the
+    // wide copies in LZWCopyBytes() can overshoot the last pixel without
+    // clobbering them while the final codes are still being expanded
+    pSymbols = (uint32_t *)&buf[iUncompressedLen+TURBO_ROOT_GAP+256]; // we need 32-bits (really 23) for the offsets
     pLengths = (uint16_t *)&pSymbols[4096]; // but only 16-bits for the length of any single string
     iOffset = 0; // output data offset
     p = pImage->ucLZW; // un-chunked LZW data
     ulBits = INTELLONG(p); // start by reading some LZW data
     // set up the default symbols (0..iColors-1)
    for (i = 0; i<iColors; i++) {
-       pSymbols[i] = iUncompressedLen + i; // root symbols
+       pSymbols[i] = iUncompressedLen + TURBO_ROOT_GAP + i; // root symbols
        pLengths[i] = 1;
-       buf[iUncompressedLen + i] = (unsigned char) i;
+       buf[iUncompressedLen + TURBO_ROOT_GAP + i] = (unsigned char) i;
    }
 init_codetable:
    codesize = codestart + 1;
@@ -3,11 +3,49 @@
 #include <Arduino.h>
 #include <Arduino_GFX_Library.h>
 #include <AnimatedGIF.h>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
 
 #include "config.h"
+#include "gif_panel_diff.h"
+#include "panel_pixels.h"
+#include "psram_alloc.h"
 
 #if defined(ANIMATED_GIF_USE_SD)
 #include <SD.h>
+
+#include "gif_frame_cache.h"
+#include "gif_frame_index.h"
+#include "gif_playlist.h"
+#include "gif_read_cache.h"
+#include "gif_telemetry.h"
+#include "gif_timebase.h"
+#include "spi_bus_lock.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#if ANIMATED_GIF_SD_DIRECT
+#include <diskio.h>
+
+#include "fat_extent.h"
+#define ANIMATED_GIF_SD_DIRECT_READS
+#endif
+
+#if ANIMATED_GIF_PREPARE_CORE >= 0 && ANIMATED_GIF_DECODE_AHEAD_FRAMES > 0
+#define ANIMATED_GIF_DECODE_AHEAD
+#endif
+#endif
+#endif
+
+#if defined(ANIMATED_GIF_USE_SD) && ANIMATED_GIF_SNAPSHOT_SLOTS > 0
+#define ANIMATED_GIF_SNAPSHOTS
+#endif
+
+#if defined(ANIMATED_GIF_USE_SD) && ANIMATED_GIF_TELEMETRY
+#define ANIMATED_GIF_TELEMETRY_TABLE
 #endif
 
 #if defined(ENABLE_ANIMATED_GIF)
@@ -16,7 +54,9 @@ extern Arduino_GFX *gfx;
 
 namespace
 {
-AnimatedGIF gif;
+// Decoder that is currently playing. With SD playback it belongs to a slot of
+// the decoder pool; the decoders themselves live in PSRAM.
+AnimatedGIF *gif = nullptr;
 bool gifReady = false;
 int16_t offsetX = 0;
 int16_t offsetY = 0;
@@ -24,12 +64,61 @@ uint16_t gifSourceWidth = 0;
 uint16_t gifSourceHeight = 0;
 bool gifScaleEnabled = false;
 uint8_t gifScale = 1;
-uint16_t lineBuffer[DISPLAY_WIDTH];
+// Aligned for the paired 32-bit stores of replicatePixels().
+alignas(4) uint16_t lineBuffer[DISPLAY_WIDTH];
 uint32_t lastFrameMillis = 0;
 uint16_t lastFrameDelay = ANIMATED_GIF_DEFAULT_DELAY;
 
 constexpr uint16_t CANVAS_WIDTH = DISPLAY_WIDTH;
 constexpr uint16_t CANVAS_HEIGHT = DISPLAY_HEIGHT;
+constexpr int16_t BAND_LINES = ANIMATED_GIF_BAND_LINES;
+static_assert(BAND_LINES > 0, "ANIMATED_GIF_BAND_LINES must be positive");
+
+// Copy of the panel in front of every blit, so only changed spans are sent.
+GifPanelDiff panelDiff;
+uint32_t lastDiffStatsMillis = 0;
+
+// Turbo/cooked decode state. The buffers belong to the player so they survive
+// gif->close()/open() and are only regrown when a larger canvas shows up. The
+// turbo buffer only holds per-frame scratch and is shared by every decoder;
+// the frame buffer holds a decoder's 8-bit canvas.
+uint8_t *turboBuffer = nullptr;
+size_t turboBufferSize = 0;
+#if !defined(ANIMATED_GIF_USE_SD)
+uint8_t *frameBuffer = nullptr;
+size_t frameBufferSize = 0;
+#endif
+bool gifCooked = false;
+// The cooked colour of a transparent pixel comes from the 8-bit canvas, which
+// is only trustworthy once a full opaque frame has been drawn with the palette
+// that is still active. Until then transparent pixels are skipped, like the
+// RAW path does, so the panel keeps what it already shows.
+bool cookedCanvasTrusted = false;
+bool cookedSkipTransparent = false;
+bool cookedFrameRefreshesCanvas = false;
+int16_t cookedLineIndex = 0;
+
+// RAW lines are drawn by a kernel picked once per frame for its transparency
+// and the canvas scale. Disposal-2 frames are drawn opaque through
+// `rawPalette`, a copy of the frame's palette whose transparent entry holds
+// the background colour.
+using RawLineKernel = void (*)(const uint8_t *src, int16_t x, int16_t y, int16_t width);
+RawLineKernel rawLineKernel = nullptr;
+const uint16_t *rawLinePalette = nullptr;
+uint8_t rawTransparent = 0;
+uint16_t rawPalette[256];
+
+// Cooked lines are collected here and pushed to the panel as one window.
+alignas(4) uint16_t bandBuffer[DISPLAY_WIDTH * BAND_LINES];
+int16_t bandX = 0;
+int16_t bandY = 0;
+int16_t bandWidth = 0;
+int16_t bandRows = 0;
+
+uint32_t decodeMicrosTotal = 0;
+uint32_t decodeMicrosMax = 0;
+uint32_t decodeFrames = 0;
+uint32_t lastStatsMillis = 0;
 
 #if !defined(ANIMATED_GIF_USE_SD)
 static_assert(kAnimatedGifResource.size > 0, "Animated GIF resource must not be empty");
@@ -42,407 +131,2566 @@ constexpr size_t kGifFileCount = sizeof(kGifFiles) / sizeof(kGifFiles[0]);
 size_t currentGifIndex = 0;
 size_t loadedGifIndex = SIZE_MAX;
 uint32_t lastSwitchMillis = 0;
-File gifFile;
+GifReadCache gifReadCache;
+GifPlaylist gifPlaylist;
+bool gifPreloaded = false;
+#if defined(ANIMATED_GIF_SD_DIRECT_READS)
+// Mounted on the first open, once SD.begin() has run.
+FatVolume sdVolume;
+bool sdVolumeMountTried = false;
+#endif
+
+static_assert(ANIMATED_GIF_DECODER_POOL_SIZE > 0, "ANIMATED_GIF_DECODER_POOL_SIZE must be positive");
+
+// An open decoder parked with its file handle, 8-bit canvas and playback
+// position, so switching back to the file resumes instead of reopening it.
+struct GifDecoderSlot
+{
+  AnimatedGIF *decoder;
+  bool open;
+  size_t index;
+  File file;
+  // Where the file lies on the card when its clusters are contiguous.
+  FatExtent extent;
+  uint8_t *frameBuffer;
+  size_t frameBufferSize;
+  bool preloaded;
+  bool cooked;
+  bool canvasTrusted;
+  bool playingFromCache;
+  uint16_t cachedFrameIndex;
+  uint16_t nextFrame;
+  uint32_t lastUsed;
+};
+
+GifDecoderSlot decoderPool[ANIMATED_GIF_DECODER_POOL_SIZE];
+GifDecoderSlot *activeSlot = nullptr;
+// Slot whose file GIFOpenFile() is opening.
+GifDecoderSlot *openingSlot = nullptr;
+uint32_t decoderClock = 0;
+// Frame the active decoder plays next.
+uint16_t nextFrame = 0;
+
+#if ANIMATED_GIF_FRAME_INDEX
+// Frame tables of every file opened since boot, and the frame each file was
+// showing when its decoder left the pool; reopening seeks back there.
+GifFrameIndex frameIndexes[kGifFileCount];
+uint16_t resumeFrames[kGifFileCount] = {};
+
+// Once a sync packet has set the shared clock, the frame on screen is a
+// function of that clock over the file's frame times instead of each frame
+// waiting out its own delay.
+GifTimebase gifTimebase;
+#if defined(ARDUINO_ARCH_ESP32)
+// Packets sync the clock from the main loop (bleSyncLoop()), but frames
+// decoded ahead or for a prepare job run on the prepare task on core 0, and
+// their decode stats read the clock and reset its counters. Every access goes
+// through this lock; readers work from a copy.
+portMUX_TYPE timebaseLock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+struct TimebaseLock
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  TimebaseLock() { portENTER_CRITICAL(&timebaseLock); }
+  ~TimebaseLock() { portEXIT_CRITICAL(&timebaseLock); }
+#else
+  TimebaseLock() {}
+#endif
+  TimebaseLock(const TimebaseLock &) = delete;
+  TimebaseLock &operator=(const TimebaseLock &) = delete;
+};
+
+GifTimebase currentTimebase()
+{
+  TimebaseLock lock;
+  return gifTimebase;
+}
+// Frame on screen in clocked playback (SIZE_MAX: none since the last open).
+size_t clockedFrame = SIZE_MAX;
+uint32_t clockDroppedFrames = 0;
+uint32_t clockLateFrames = 0;
+uint32_t clockSeeks = 0;
+// Frames skipped as repeats of the frame before, and an estimate of the
+// decode time they would have taken: each counts as the decode of the frame
+// it repeats, which is not measured for the skipped frames themselves.
+uint32_t duplicateFramesSkipped = 0;
+uint32_t duplicateEstimatedMicros = 0;
+// Hash of the last frame decoded, and which frame of which file it was
+// (SIZE_MAX: none). Each decoded frame is compared with the one before, so
+// repeats are flagged in the index during the first loop.
+uint32_t hashedFrameHash = 0;
+size_t hashedGif = SIZE_MAX;
+size_t hashedFrame = SIZE_MAX;
+#endif
+
+#if ANIMATED_GIF_PRELOAD_MAX_BYTES > 0
+static_assert(ANIMATED_GIF_PRELOAD_SLOTS > 0, "ANIMATED_GIF_PRELOAD_SLOTS must be positive");
+
+struct PreloadedGif
+{
+  size_t index;
+  uint8_t *data;
+  size_t size;
+  uint32_t lastUsed;
+};
+
+PreloadedGif preloadedGifs[ANIMATED_GIF_PRELOAD_SLOTS] = {};
+size_t preloadedBytes = 0;
+uint32_t preloadClock = 0;
+// Files already found to be above the preload threshold; skips reopening them
+// just to look at their size again.
+bool gifTooLargeToPreload[kGifFileCount] = {};
+#endif
+
+// Program switches run the open and the first decode on a worker task (the
+// other core) into `stagingFrame`, while the render thread keeps animating
+// the transition. The first loop afterwards presents it with one blit.
+constexpr size_t STAGING_PIXELS = static_cast<size_t>(DISPLAY_WIDTH) * DISPLAY_HEIGHT;
+uint16_t *stagingFrame = nullptr;
+bool stagedFrameReady = false;
+int stagedResult = 0;
+int stagedDelayMs = 0;
+volatile size_t prepareRequest = SIZE_MAX;
+volatile size_t prepareDoneIndex = SIZE_MAX;
+volatile bool prepareBusy = false;
+#if defined(ARDUINO_ARCH_ESP32)
+TaskHandle_t prepareTask = nullptr;
+portMUX_TYPE prepareLock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+#if defined(ANIMATED_GIF_SNAPSHOTS)
+// The panel as a program was last left, taken from the panel copy. Entering
+// the program again shows it with one blit while the decoder opens, and the
+// decoder carries on from the frame after it.
+struct GifSnapshot
+{
+  bool valid;
+  size_t index;
+  uint16_t *pixels;
+  uint32_t lastUsed;
+};
+
+GifSnapshot snapshots[ANIMATED_GIF_SNAPSHOT_SLOTS] = {};
+uint32_t snapshotClock = 0;
+// Program whose frame the panel copy holds (SIZE_MAX: none, or one already
+// kept as a snapshot).
+size_t panelProgram = SIZE_MAX;
+// Program whose snapshot is on the panel; opening it keeps the panel copy.
+size_t snapshotOnPanel = SIZE_MAX;
+#endif
+
+#if defined(ANIMATED_GIF_DECODE_AHEAD)
+// While a file streams from SD the prepare task also decodes up to
+// ANIMATED_GIF_DECODE_AHEAD_FRAMES frames ahead of display, and the render
+// thread shows the oldest one when it is due. A ring slot records one frame's
+// panel writes: a PanelWrite header followed by width x height pixels, per
+// write. The task owns the decoder while `decodeAheadActive` is set; only it
+// advances `decodeAheadQueued` and only the render thread `decodeAheadShown`.
+// Only the render thread draws: a frame with more writes than fit its slot is
+// decoded again there (the canvas comes out the same, since the decoder
+// applies a frame's disposal and transparency as it draws it).
+struct PanelWrite
+{
+  int16_t x;
+  int16_t y;
+  int16_t width;
+  int16_t height;
+};
+
+struct DecodedFrame
+{
+  uint8_t *data;
+  size_t used;
+  int result;
+  int delayMs;
+  // Had more writes than fit; the writes recorded are not drawn. The decoder
+  // goes back to `start` (frame `startFrame`) to decode it on display.
+  bool overflowed;
+  GIFFRAMEINFO start;
+  uint16_t startFrame;
+};
+
+constexpr size_t DECODE_AHEAD_FRAMES = ANIMATED_GIF_DECODE_AHEAD_FRAMES;
+// A frame covers each panel pixel at most once. Transparent pixels on an
+// untrusted canvas split it into runs: a few thousand per frame for files
+// with a local palette on every frame.
+constexpr size_t DECODED_FRAME_WRITES = 4096;
+constexpr size_t DECODED_FRAME_BYTES =
+    STAGING_PIXELS * sizeof(uint16_t) + DECODED_FRAME_WRITES * sizeof(PanelWrite);
+DecodedFrame decodedFrames[DECODE_AHEAD_FRAMES] = {};
+bool decodeAheadUnavailable = false;
+volatile bool decodeAheadActive = false;
+volatile bool decodeAheadStop = false;
+volatile bool decodeAheadFailed = false;
+// The last frame queued overflowed its slot; the task queues no more.
+volatile bool decodeAheadOverflowed = false;
+volatile uint32_t decodeAheadQueued = 0;
+volatile uint32_t decodeAheadShown = 0;
+// Slot the task is decoding into, or nullptr.
+DecodedFrame *recordTarget = nullptr;
+
+// Ring telemetry since the last report: an underrun is a frame that was due
+// while the ring was empty; the fill is sampled as each frame is shown.
+bool decodeAheadPrimed = false;
+bool decodeAheadStarved = false;
+uint32_t decodeAheadUnderruns = 0;
+uint32_t decodeAheadFrames = 0;
+uint32_t decodeAheadFillTotal = 0;
+uint32_t decodeAheadMinFill = 0;
+uint32_t decodeAheadRedecodes = 0;
+uint32_t lastDecodeAheadStatsMillis = 0;
+// Set when a file is opened. The ring also restarts within a file (after an
+// overflow or clocked frames), which keeps counting.
+bool decodeAheadStatsStale = true;
+#endif
+
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+GifFrameCache frameCache;
+// Entry being replayed instead of decoded, or nullptr.
+const GifFrameCacheEntry *cachedGif = nullptr;
+uint16_t cachedFrameIndex = 0;
+// Files whose composite did not fit the budget; they keep decoding.
+bool gifFrameCacheRejected[kGifFileCount] = {};
+uint32_t frameCacheHits = 0;
+uint32_t frameCacheMisses = 0;
+uint32_t frameCacheSavedMicros = 0;
+#endif
+
+#if defined(ANIMATED_GIF_USE_SD)
+// Most PSRAM the player holds at once with the configured sizes. All of it is
+// allocated on first use, so a shortfall would otherwise only show as a
+// feature quietly missing later on.
+constexpr size_t CANVAS_PIXELS = static_cast<size_t>(CANVAS_WIDTH) * CANVAS_HEIGHT;
+constexpr size_t PANEL_FRAME_BYTES = STAGING_PIXELS * sizeof(uint16_t);
+constexpr size_t PSRAM_FIXED_BYTES =
+    PANEL_FRAME_BYTES + ANIMATED_GIF_DECODER_POOL_SIZE * (sizeof(AnimatedGIF) + CANVAS_PIXELS + CANVAS_WIDTH * 3) +
+    2 * ANIMATED_GIF_READ_CACHE_BYTES;
+#if ANIMATED_GIF_PANEL_DIFF
+constexpr size_t PSRAM_PANEL_COPY_BYTES = PANEL_FRAME_BYTES;
+#else
+constexpr size_t PSRAM_PANEL_COPY_BYTES = 0;
+#endif
+#if ANIMATED_GIF_TURBO
+constexpr size_t PSRAM_TURBO_BYTES = TURBO_BUFFER_SIZE + CANVAS_PIXELS;
+#else
+constexpr size_t PSRAM_TURBO_BYTES = 0;
+#endif
+#if defined(ANIMATED_GIF_DECODE_AHEAD)
+constexpr size_t PSRAM_RING_BYTES = DECODE_AHEAD_FRAMES * DECODED_FRAME_BYTES;
+#else
+constexpr size_t PSRAM_RING_BYTES = 0;
+#endif
+#if defined(ANIMATED_GIF_SNAPSHOTS)
+constexpr size_t PSRAM_SNAPSHOT_BYTES = ANIMATED_GIF_SNAPSHOT_SLOTS * PANEL_FRAME_BYTES;
+#else
+constexpr size_t PSRAM_SNAPSHOT_BYTES = 0;
+#endif
+#if ANIMATED_GIF_PRELOAD_MAX_BYTES > 0
+constexpr size_t PSRAM_PRELOAD_BYTES = ANIMATED_GIF_PRELOAD_BUDGET_BYTES;
+#else
+constexpr size_t PSRAM_PRELOAD_BYTES = 0;
+#endif
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+// The budget plus the RGB565 canvas a recording composites into.
+constexpr size_t PSRAM_FRAME_CACHE_BYTES = ANIMATED_GIF_FRAME_CACHE_BYTES + PANEL_FRAME_BYTES;
+#else
+constexpr size_t PSRAM_FRAME_CACHE_BYTES = 0;
+#endif
+constexpr size_t PSRAM_PLAN_BYTES = PSRAM_FIXED_BYTES + PSRAM_PANEL_COPY_BYTES + PSRAM_TURBO_BYTES +
+                                    PSRAM_RING_BYTES + PSRAM_SNAPSHOT_BYTES + PSRAM_PRELOAD_BYTES +
+                                    PSRAM_FRAME_CACHE_BYTES;
+static_assert(PSRAM_PLAN_BYTES <= ANIMATED_GIF_PSRAM_BUDGET_BYTES,
+              "GIF player buffers exceed ANIMATED_GIF_PSRAM_BUDGET_BYTES; lower the snapshot, decode-ahead, "
+              "preload or frame cache sizes");
+
+// Reports at setup when less PSRAM is free than the buffers may take.
+void checkPsramPlan()
+{
+#if defined(ESP32)
+  const size_t freeBytes = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+#else
+  const size_t freeBytes = PSRAM_PLAN_BYTES;
+#endif
+  Serial.printf("Animated GIF: buffers take up to %u KB of PSRAM (ring %u, snapshots %u, preloads %u, frame "
+                "cache %u), %u KB free\n",
+                static_cast<unsigned>(PSRAM_PLAN_BYTES / 1024), static_cast<unsigned>(PSRAM_RING_BYTES / 1024),
+                static_cast<unsigned>(PSRAM_SNAPSHOT_BYTES / 1024), static_cast<unsigned>(PSRAM_PRELOAD_BYTES / 1024),
+                static_cast<unsigned>(PSRAM_FRAME_CACHE_BYTES / 1024), static_cast<unsigned>(freeBytes / 1024));
+  if (freeBytes < PSRAM_PLAN_BYTES)
+  {
+    Serial.println("Animated GIF: not enough PSRAM for all buffers; the last features to allocate will be off");
+  }
+}
+#endif
+
+#if defined(ANIMATED_GIF_TELEMETRY_TABLE)
+// One entry per playlist file since boot or the last dump that cleared it.
+GifTelemetry telemetry[kGifFileCount];
+uint32_t telemetryStartMillis = 0;
+// Time the frame being decoded has spent in writePanel().
+uint32_t frameOutputMicros = 0;
+
+// Entry of the file the decoder holds (nullptr before the first open).
+GifTelemetry *loadedTelemetry()
+{
+  return loadedGifIndex < kGifFileCount ? &telemetry[loadedGifIndex] : nullptr;
+}
+#endif
 #endif
 
 void resetGifTiming()
 {
   lastFrameMillis = millis();
   lastFrameDelay = 0;
+  panelDiff.resetStats();
+  lastDiffStatsMillis = lastFrameMillis;
 #if defined(ANIMATED_GIF_USE_SD)
   lastSwitchMillis = lastFrameMillis;
+#if ANIMATED_GIF_FRAME_INDEX
+  clockedFrame = SIZE_MAX;
+#endif
+#endif
+#if defined(ANIMATED_GIF_DECODE_AHEAD)
+  decodeAheadStatsStale = true;
 #endif
 }
 
-void blitRun(int16_t x, int16_t y, int16_t length)
+void blitToPanel(int16_t x, int16_t y, uint16_t *pixels, int16_t width, int16_t height)
 {
-  if (length <= 0)
+  // The read cache's I/O task may be reading the card on the other core.
+  SpiBusGuard bus(SpiBusUser::Panel);
+#if defined(ANIMATED_GIF_TELEMETRY_TABLE)
+  const uint32_t start = micros();
+  const uint32_t writes = panelDiff.stats().writes;
+#endif
+  panelDiff.blit(gfx, x, y, pixels, width, height);
+#if defined(ANIMATED_GIF_TELEMETRY_TABLE)
+  if (GifTelemetry *t = loadedTelemetry())
   {
-    return;
+    t->addBlit(micros() - start, panelDiff.stats().writes - writes);
   }
-  gfx->draw16bitRGBBitmap(x, y, lineBuffer, length, 1);
+#endif
+#if defined(ANIMATED_GIF_SNAPSHOTS)
+  panelProgram = loadedGifIndex;
+#endif
 }
 
-void blitScaledRun(int16_t x, int16_t y, int16_t length, uint8_t scale)
+#if defined(ANIMATED_GIF_SNAPSHOTS)
+GifSnapshot *findSnapshot(size_t index)
 {
-  if (length <= 0 || scale == 0)
+  for (GifSnapshot &snapshot : snapshots)
+  {
+    if (snapshot.valid && snapshot.index == index)
+    {
+      return &snapshot;
+    }
+  }
+  return nullptr;
+}
+
+// Keeps what the panel copy holds as the snapshot of its program, before
+// the copy is dropped or drawn over.
+void captureSnapshot()
+{
+  if (panelProgram >= kGifFileCount)
   {
     return;
   }
-  for (uint8_t row = 0; row < scale; ++row)
+  const size_t index = panelProgram;
+  panelProgram = SIZE_MAX;
+  GifSnapshot *slot = findSnapshot(index);
+  for (size_t i = 0; !slot && i < ANIMATED_GIF_SNAPSHOT_SLOTS; ++i)
+  {
+    if (!snapshots[i].valid)
+    {
+      slot = &snapshots[i];
+    }
+  }
+  if (!slot)
   {
-    gfx->draw16bitRGBBitmap(x, static_cast<int16_t>(y + row), lineBuffer, length, 1);
+    slot = &snapshots[0];
+    for (GifSnapshot &snapshot : snapshots)
+    {
+      if (snapshot.lastUsed < slot->lastUsed)
+      {
+        slot = &snapshot;
+      }
+    }
+  }
+  if (!slot->pixels)
+  {
+    slot->pixels = static_cast<uint16_t *>(psramAlloc(STAGING_PIXELS * sizeof(uint16_t)));
+    if (!slot->pixels)
+    {
+      Serial.println("Animated GIF: no PSRAM for a snapshot");
+    }
   }
+  slot->valid = slot->pixels && panelDiff.copyTo(slot->pixels, panelPixel(ANIMATED_GIF_BACKGROUND));
+  slot->index = index;
+  slot->lastUsed = ++snapshotClock;
 }
 
-void GIFDraw(GIFDRAW *pDraw)
+void releaseSnapshots()
 {
-  int16_t x = offsetX + pDraw->iX;
-  int16_t y = offsetY + pDraw->iY + pDraw->y;
-  int16_t width = static_cast<int16_t>(pDraw->iWidth);
-
-  if (x >= CANVAS_WIDTH || y >= CANVAS_HEIGHT)
+  for (GifSnapshot &snapshot : snapshots)
   {
-    return;
+    free(snapshot.pixels);
+    snapshot = {};
   }
+  panelProgram = SIZE_MAX;
+  snapshotOnPanel = SIZE_MAX;
+}
+#endif
 
-  if (x < 0)
+#if defined(ANIMATED_GIF_DECODE_AHEAD)
+void drawPanelWrites(const DecodedFrame &frame)
+{
+  // One bus hold for the whole frame, so panel writes go out as one burst
+  // between the I/O task's card reads.
+  SpiBusGuard bus(SpiBusUser::Panel);
+  size_t offset = 0;
+  while (offset < frame.used)
   {
-    const int16_t delta = static_cast<int16_t>(-x);
-    x = 0;
-    width -= delta;
-    pDraw->pPixels += delta;
+    const PanelWrite *write = reinterpret_cast<const PanelWrite *>(frame.data + offset);
+    uint16_t *pixels = reinterpret_cast<uint16_t *>(frame.data + offset + sizeof(PanelWrite));
+    blitToPanel(write->x, write->y, pixels, write->width, write->height);
+    offset += sizeof(PanelWrite) + static_cast<size_t>(write->width) * write->height * sizeof(uint16_t);
   }
+}
 
-  if (width <= 0)
+// Appends a write, clipped to the panel, to the frame being decoded ahead.
+// Once one does not fit, the frame is marked and the rest of its writes are
+// dropped; the render thread decodes it again.
+void recordPanelWrite(int16_t x, int16_t y, uint16_t *pixels, int16_t width, int16_t height)
+{
+  DecodedFrame &frame = *recordTarget;
+  if (frame.overflowed)
   {
     return;
   }
-
-  if (x + width > CANVAS_WIDTH)
+  const int16_t left = x < 0 ? 0 : x;
+  const int16_t top = y < 0 ? 0 : y;
+  const int16_t right = min(static_cast<int16_t>(x + width), static_cast<int16_t>(CANVAS_WIDTH));
+  const int16_t bottom = min(static_cast<int16_t>(y + height), static_cast<int16_t>(CANVAS_HEIGHT));
+  if (right <= left || bottom <= top)
   {
-    width = CANVAS_WIDTH - x;
+    return;
   }
-
-  if (width <= 0)
+  const int16_t clippedWidth = static_cast<int16_t>(right - left);
+  const int16_t clippedHeight = static_cast<int16_t>(bottom - top);
+  const size_t bytes =
+      sizeof(PanelWrite) + static_cast<size_t>(clippedWidth) * clippedHeight * sizeof(uint16_t);
+  if (frame.used + bytes > DECODED_FRAME_BYTES)
   {
+    frame.overflowed = true;
     return;
   }
+  PanelWrite *write = reinterpret_cast<PanelWrite *>(frame.data + frame.used);
+  write->x = left;
+  write->y = top;
+  write->width = clippedWidth;
+  write->height = clippedHeight;
+  uint16_t *dst = reinterpret_cast<uint16_t *>(frame.data + frame.used + sizeof(PanelWrite));
+  const uint16_t *src = pixels + static_cast<size_t>(top - y) * width + (left - x);
+  for (int16_t row = 0; row < clippedHeight; ++row)
+  {
+    memcpy(dst, src, static_cast<size_t>(clippedWidth) * sizeof(uint16_t));
+    dst += clippedWidth;
+    src += width;
+  }
+  frame.used += bytes;
+}
+#endif
 
-  uint8_t *src = pDraw->pPixels;
-  uint16_t *palette = pDraw->pPalette;
+// Every panel write of the player goes through writePanel(). While a prepare
+// job decodes ahead of a program switch the pixels land in `stagingFrame`
+// (panel-sized) instead of on the display; frames decoded ahead of their
+// display time are recorded into the ring.
+uint16_t *stagingTarget = nullptr;
 
-  if (pDraw->ucDisposalMethod == 2)
+void routePanelWrite(int16_t x, int16_t y, uint16_t *pixels, int16_t width, int16_t height)
+{
+#if defined(ANIMATED_GIF_DECODE_AHEAD)
+  if (recordTarget)
+  {
+    recordPanelWrite(x, y, pixels, width, height);
+    return;
+  }
+#endif
+  if (!stagingTarget)
+  {
+    blitToPanel(x, y, pixels, width, height);
+    return;
+  }
+  const int16_t skip = x < 0 ? static_cast<int16_t>(-x) : 0;
+  const int16_t outX = static_cast<int16_t>(x + skip);
+  int16_t count = static_cast<int16_t>(width - skip);
+  if (outX + count > static_cast<int16_t>(CANVAS_WIDTH))
+  {
+    count = static_cast<int16_t>(CANVAS_WIDTH - outX);
+  }
+  if (count <= 0)
+  {
+    return;
+  }
+  for (int16_t row = 0; row < height; ++row)
   {
-    for (int16_t i = 0; i < width; ++i)
+    const int16_t outY = static_cast<int16_t>(y + row);
+    if (outY < 0 || outY >= static_cast<int16_t>(CANVAS_HEIGHT))
     {
-      if (src[i] == pDraw->ucTransparent)
-      {
-        src[i] = pDraw->ucBackground;
-      }
+      continue;
     }
-    pDraw->ucHasTransparency = 0;
+    memcpy(stagingTarget + static_cast<size_t>(outY) * CANVAS_WIDTH + outX,
+           pixels + static_cast<size_t>(row) * width + skip, static_cast<size_t>(count) * sizeof(uint16_t));
   }
+}
 
-  const uint8_t scale = gifScaleEnabled ? gifScale : 1;
+// Output time is taken out of the frame's decode time in the telemetry.
+void writePanel(int16_t x, int16_t y, uint16_t *pixels, int16_t width, int16_t height)
+{
+#if defined(ANIMATED_GIF_TELEMETRY_TABLE)
+  const uint32_t start = micros();
+  routePanelWrite(x, y, pixels, width, height);
+  frameOutputMicros += micros() - start;
+#else
+  routePanelWrite(x, y, pixels, width, height);
+#endif
+}
 
-  if (gifScaleEnabled)
+void blitRun(int16_t x, int16_t y, int16_t length)
+{
+  if (length <= 0)
   {
-    const int16_t xScaled = static_cast<int16_t>(x * scale);
-    const int16_t yScaled = static_cast<int16_t>(y * scale);
-    if (xScaled >= CANVAS_WIDTH || yScaled >= CANVAS_HEIGHT)
-    {
-      return;
-    }
+    return;
+  }
+  writePanel(x, y, lineBuffer, length, 1);
+}
 
-    const int16_t scaledAvailX = static_cast<int16_t>(CANVAS_WIDTH - xScaled);
-    const int16_t maxWidth = static_cast<int16_t>((scaledAvailX + scale - 1) / scale);
-    if (width > maxWidth)
-    {
-      width = maxWidth;
-    }
-    if (width <= 0)
-    {
-      return;
-    }
+void blitScaledRun(int16_t x, int16_t y, int16_t length, uint8_t scale)
+{
+  if (length <= 0 || scale == 0)
+  {
+    return;
+  }
+  for (uint8_t row = 0; row < scale; ++row)
+  {
+    writePanel(x, static_cast<int16_t>(y + row), lineBuffer, length, 1);
+  }
+}
 
-    // Handle scaled drawing separately to avoid overrunning source buffers.
-    if (pDraw->ucHasTransparency)
-    {
-      int16_t runScaled = 0;
-      int16_t runStart = 0;
-      for (int16_t i = 0; i < width; ++i)
-      {
-        const uint8_t index = src[i];
-        if (index == pDraw->ucTransparent)
-        {
-          if (runScaled > 0)
-          {
-            blitScaledRun(static_cast<int16_t>(xScaled + runStart * scale), yScaled, runScaled, scale);
-            runScaled = 0;
-          }
-          runStart = static_cast<int16_t>(i + 1);
-        }
-        else
-        {
-          if (runScaled == 0)
-          {
-            runStart = i;
-          }
-          const uint16_t color = palette[index];
-          for (uint8_t sx = 0; sx < scale; ++sx)
-          {
-            if (runScaled < static_cast<int16_t>(sizeof(lineBuffer) / sizeof(lineBuffer[0])))
-            {
-              lineBuffer[runScaled++] = color;
-            }
-          }
-        }
-      }
-      if (runScaled > 0)
-      {
-        blitScaledRun(static_cast<int16_t>(xScaled + runStart * scale), yScaled, runScaled, scale);
-      }
-    }
-    else
-    {
-      const int16_t maxChunk = static_cast<int16_t>(sizeof(lineBuffer) / sizeof(lineBuffer[0]));
-      int16_t processed = 0;
-      while (processed < width)
-      {
-        int16_t chunk = static_cast<int16_t>(width - processed);
-        const int16_t chunkLimit = static_cast<int16_t>(maxChunk / scale);
-        if (chunk > chunkLimit)
-        {
-          chunk = chunkLimit;
-        }
-        for (int16_t i = 0; i < chunk; ++i)
-        {
-          const uint16_t color = palette[src[processed + i]];
-          for (uint8_t sx = 0; sx < scale; ++sx)
-          {
-            const int16_t idx = static_cast<int16_t>(i * scale + sx);
-            if (idx < maxChunk)
-            {
-              lineBuffer[idx] = color;
-            }
-          }
-        }
-        const int16_t scaledLen = static_cast<int16_t>(chunk * scale);
-        blitScaledRun(static_cast<int16_t>(xScaled + processed * scale), yScaled, scaledLen, scale);
-        processed += chunk;
-      }
-    }
+void flushBand()
+{
+  if (bandRows <= 0)
+  {
     return;
   }
+  writePanel(bandX, bandY, bandBuffer, bandWidth, bandRows);
+  bandRows = 0;
+}
+
+// Clips `count` source pixels starting at panel column `x` (after scaling) to
+// the panel; returns false when nothing is visible.
+bool clipCookedSpan(int16_t x, int16_t count, int16_t scale, int16_t &outX, int16_t &outWidth)
+{
+  outX = x < 0 ? 0 : x;
+  int16_t outEnd = static_cast<int16_t>(x + count * scale);
+  if (outEnd > static_cast<int16_t>(CANVAS_WIDTH))
+  {
+    outEnd = CANVAS_WIDTH;
+  }
+  outWidth = static_cast<int16_t>(outEnd - outX);
+  return outWidth > 0;
+}
+
+// Pixel sources for replicatePixels(): cooked lines are RGB565 already, RAW
+// lines are palette indices.
+struct DirectPixels
+{
+  const uint16_t *src;
+  uint16_t operator()(int16_t i) const { return src[i]; }
+};
+
+struct PalettePixels
+{
+  const uint8_t *src;
+  const uint16_t *palette;
+  uint16_t operator()(int16_t i) const { return palette[src[i]]; }
+};
 
-  if (pDraw->ucHasTransparency)
+inline void storePixelPair(uint16_t *dst, uint16_t color)
+{
+  const uint32_t pair = static_cast<uint32_t>(color) * 0x10001u;
+  memcpy(__builtin_assume_aligned(dst, 4), &pair, sizeof(pair));
+}
+
+inline void fillPixels(uint16_t *dst, int16_t count, uint16_t color)
+{
+  for (int16_t i = 0; i < count; ++i)
   {
-    int16_t runLen = 0;
-    int16_t runStart = 0;
+    dst[i] = color;
+  }
+}
 
-    for (int16_t i = 0; i < width; ++i)
+// Writes `count` source pixels to `dst`, each repeated `Scale` times (the
+// runtime `scale` when Scale is 0). Repeats go out as aligned 32-bit pairs.
+template <uint8_t Scale, typename Pixels>
+void replicatePixels(uint16_t *dst, int16_t count, int16_t scale, Pixels pixels)
+{
+  if (Scale == 1)
+  {
+    for (int16_t i = 0; i < count; ++i)
     {
-      uint8_t index = src[i];
-      if (index == pDraw->ucTransparent)
-      {
-        if (runLen > 0)
-        {
-          blitRun(x + runStart, y, runLen);
-          runLen = 0;
-        }
-        runStart = i + 1;
-      }
-      else
-      {
-        if (runLen == 0)
-        {
-          runStart = i;
-        }
-        if (runLen < static_cast<int16_t>(sizeof(lineBuffer) / sizeof(lineBuffer[0])))
-        {
-          const uint16_t color = palette[index];
-          for (uint8_t sx = 0; sx < scale; ++sx)
-          {
-            if (runLen < static_cast<int16_t>(sizeof(lineBuffer) / sizeof(lineBuffer[0])))
-            {
-              lineBuffer[runLen++] = color;
-            }
-          }
-        }
-      }
+      dst[i] = pixels(i);
     }
-
-    if (runLen > 0)
+    return;
+  }
+  if (Scale == 2 && (reinterpret_cast<uintptr_t>(dst) & 3) == 0)
+  {
+    for (int16_t i = 0; i < count; ++i)
     {
-      if (gifScaleEnabled)
-      {
-        blitScaledRun(static_cast<int16_t>(x + runStart * scale), y, runLen, scale);
-      }
-      else
-      {
-        blitRun(x + runStart, y, runLen);
-      }
+      storePixelPair(dst + i * 2, pixels(i));
     }
+    return;
   }
-  else
+  const int16_t repeat = Scale ? Scale : scale;
+  for (int16_t i = 0; i < count; ++i)
   {
-    const int16_t maxChunk = static_cast<int16_t>(sizeof(lineBuffer) / sizeof(lineBuffer[0]));
-    int16_t processed = 0;
-    while (processed < width)
+    const uint16_t color = pixels(i);
+    uint16_t *const end = dst + repeat;
+    if ((reinterpret_cast<uintptr_t>(dst) & 2) != 0)
     {
-      int16_t chunk = width - processed;
-      if (chunk > maxChunk)
-      {
-        chunk = maxChunk;
-      }
-      for (int16_t i = 0; i < chunk; ++i)
-      {
-        const uint16_t color = palette[src[processed + i]];
-        if (gifScaleEnabled)
-        {
-          for (uint8_t sx = 0; sx < scale; ++sx)
-          {
-            const int16_t idx = static_cast<int16_t>(i * scale + sx);
-            if (idx < maxChunk)
-            {
-              lineBuffer[idx] = color;
-            }
-          }
-        }
-        else
-        {
-          lineBuffer[i] = color;
-        }
-      }
-      if (gifScaleEnabled)
-      {
-        const int16_t scaledLen = static_cast<int16_t>(chunk * scale);
-        blitScaledRun(static_cast<int16_t>(x + processed * scale), y, scaledLen, scale);
-        processed += chunk;
-      }
-      else
-      {
-        blitRun(x + processed, y, chunk);
-        processed += chunk;
-      }
+      *dst++ = color;
+    }
+    for (; dst + 2 <= end; dst += 2)
+    {
+      storePixelPair(dst, color);
+    }
+    if (dst < end)
+    {
+      *dst++ = color;
     }
   }
 }
 
-#if defined(ANIMATED_GIF_USE_SD)
-void *GIFOpenFile(const char *szFilename, int32_t *pFileSize)
+template <uint8_t Scale>
+void expandSpan(uint16_t *dst, const uint16_t *src, int16_t x, int16_t outX, int16_t outWidth, int16_t scale)
 {
-  gifFile.close();
-  gifFile = SD.open(szFilename, FILE_READ);
-  if (!gifFile)
+  if (Scale == 1)
   {
-    return nullptr;
+    memcpy(dst, src + (outX - x), static_cast<size_t>(outWidth) * sizeof(uint16_t));
+    return;
+  }
+  // A span clipped on the left starts part way into its first pixel.
+  src += (outX - x) / scale;
+  int16_t written = 0;
+  const int16_t lead = static_cast<int16_t>((outX - x) % scale);
+  if (lead > 0)
+  {
+    written = min(static_cast<int16_t>(scale - lead), outWidth);
+    fillPixels(dst, written, *src++);
   }
-  *pFileSize = static_cast<int32_t>(gifFile.size());
-  return static_cast<void *>(&gifFile);
+  const int16_t whole = static_cast<int16_t>((outWidth - written) / scale);
+  replicatePixels<Scale>(dst + written, whole, scale, DirectPixels{src});
+  written = static_cast<int16_t>(written + whole * scale);
+  if (written < outWidth)
+  {
+    fillPixels(dst + written, static_cast<int16_t>(outWidth - written), src[whole]);
+  }
+}
+
+void expandCookedSpan(uint16_t *dst, const uint16_t *src, int16_t x, int16_t outX, int16_t outWidth, int16_t scale)
+{
+  switch (scale)
+  {
+  case 1:
+    expandSpan<1>(dst, src, x, outX, outWidth, scale);
+    break;
+  case 2:
+    expandSpan<2>(dst, src, x, outX, outWidth, scale);
+    break;
+  default:
+    expandSpan<0>(dst, src, x, outX, outWidth, scale);
+    break;
+  }
+}
+
+void beginCookedFrame(const GIFDRAW *pDraw)
+{
+  const bool opaque = !pDraw->ucHasTransparency || pDraw->ucDisposalMethod == 2;
+  if (!pDraw->ucIsGlobalPalette)
+  {
+    cookedCanvasTrusted = false;
+  }
+  cookedSkipTransparent = !opaque && !cookedCanvasTrusted;
+  cookedFrameRefreshesCanvas = pDraw->ucIsGlobalPalette && opaque && pDraw->iX == 0 && pDraw->iY == 0 &&
+                               pDraw->iWidth == gifSourceWidth && pDraw->iHeight == gifSourceHeight;
+}
+
+void endCookedFrame()
+{
+  if (cookedLineIndex > 0 && cookedFrameRefreshesCanvas)
+  {
+    cookedCanvasTrusted = true;
+  }
+  cookedLineIndex = 0;
+}
+
+void drawCookedRuns(GIFDRAW *pDraw, const uint16_t *src, int16_t x, int16_t y, int16_t scale)
+{
+  const uint8_t *indices = turboBuffer + static_cast<size_t>(cookedLineIndex) * pDraw->iWidth;
+  const uint8_t transparent = pDraw->ucTransparent;
+  const int16_t width = static_cast<int16_t>(pDraw->iWidth);
+  int16_t i = 0;
+  while (i < width)
+  {
+    while (i < width && indices[i] == transparent)
+    {
+      ++i;
+    }
+    const int16_t start = i;
+    while (i < width && indices[i] != transparent)
+    {
+      ++i;
+    }
+    const int16_t runX = static_cast<int16_t>(x + start * scale);
+    int16_t outX = 0;
+    int16_t outWidth = 0;
+    if (i == start || !clipCookedSpan(runX, static_cast<int16_t>(i - start), scale, outX, outWidth))
+    {
+      continue;
+    }
+    expandCookedSpan(lineBuffer, src + start, runX, outX, outWidth, scale);
+    for (int16_t row = 0; row < scale; ++row)
+    {
+      const int16_t outY = static_cast<int16_t>(y + row);
+      if (outY >= 0 && outY < static_cast<int16_t>(CANVAS_HEIGHT))
+      {
+        writePanel(outX, outY, lineBuffer, outWidth, 1);
+      }
+    }
+  }
+}
+
+// Adds one source line of `count` pixels at panel position (x, y), repeated
+// `scale` times, to the current band.
+void appendBandLine(const uint16_t *src, int16_t x, int16_t y, int16_t count, int16_t scale)
+{
+  int16_t outX = 0;
+  int16_t outWidth = 0;
+  if (!clipCookedSpan(x, count, scale, outX, outWidth))
+  {
+    return;
+  }
+
+  uint16_t *firstRow = nullptr;
+  for (int16_t row = 0; row < scale; ++row)
+  {
+    const int16_t outY = static_cast<int16_t>(y + row);
+    if (outY < 0)
+    {
+      continue;
+    }
+    if (outY >= static_cast<int16_t>(CANVAS_HEIGHT))
+    {
+      break;
+    }
+
+    if (bandRows > 0 &&
+        (bandRows == BAND_LINES || outX != bandX || outWidth != bandWidth || outY != bandY + bandRows))
+    {
+      flushBand();
+      firstRow = nullptr;
+    }
+    if (bandRows == 0)
+    {
+      bandX = outX;
+      bandY = outY;
+      bandWidth = outWidth;
+    }
+
+    uint16_t *dst = &bandBuffer[bandRows * bandWidth];
+    if (firstRow)
+    {
+      memcpy(dst, firstRow, static_cast<size_t>(outWidth) * sizeof(uint16_t));
+    }
+    else
+    {
+      expandCookedSpan(dst, src, x, outX, outWidth, scale);
+    }
+    firstRow = dst;
+    ++bandRows;
+  }
+}
+
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+// Mirrors a cooked line into the recording composite. Skipped transparent
+// pixels keep the composite's previous value, just as they keep the panel's.
+void recordCookedLine(const GIFDRAW *pDraw, const uint16_t *src)
+{
+  const int16_t y = static_cast<int16_t>(pDraw->iY + pDraw->y);
+  if (y < 0 || y >= static_cast<int16_t>(gifSourceHeight) || pDraw->iX >= gifSourceWidth)
+  {
+    return;
+  }
+  int16_t width = static_cast<int16_t>(pDraw->iWidth);
+  if (pDraw->iX + width > gifSourceWidth)
+  {
+    width = static_cast<int16_t>(gifSourceWidth - pDraw->iX);
+  }
+  uint16_t *dst = frameCache.canvas() + static_cast<size_t>(y) * gifSourceWidth + pDraw->iX;
+  if (!cookedSkipTransparent)
+  {
+    memcpy(dst, src, static_cast<size_t>(width) * sizeof(uint16_t));
+    return;
+  }
+  const uint8_t *indices = turboBuffer + static_cast<size_t>(cookedLineIndex) * pDraw->iWidth;
+  const uint8_t transparent = pDraw->ucTransparent;
+  for (int16_t i = 0; i < width; ++i)
+  {
+    if (indices[i] != transparent)
+    {
+      dst[i] = src[i];
+    }
+  }
+}
+#endif
+
+void GIFDrawCooked(GIFDRAW *pDraw)
+{
+  // pPixels holds the composited RGB565 line for the frame rectangle.
+  const uint16_t *src = reinterpret_cast<const uint16_t *>(pDraw->pPixels);
+  const int16_t scale = gifScaleEnabled ? gifScale : 1;
+  const int16_t x = static_cast<int16_t>(offsetX + pDraw->iX * scale);
+  const int16_t y = static_cast<int16_t>(offsetY + (pDraw->iY + pDraw->y) * scale);
+
+  if (cookedLineIndex == 0)
+  {
+    beginCookedFrame(pDraw);
+  }
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+  if (frameCache.isRecording())
+  {
+    recordCookedLine(pDraw, src);
+  }
+#endif
+  if (cookedSkipTransparent)
+  {
+    flushBand();
+    drawCookedRuns(pDraw, src, x, y, scale);
+    ++cookedLineIndex;
+    return;
+  }
+  ++cookedLineIndex;
+  appendBandLine(src, x, y, static_cast<int16_t>(pDraw->iWidth), scale);
+}
+
+// Draws `count` RAW pixels as one run at panel column `x`. Scaled runs are
+// cut at the panel edge and repeated over `Scale` rows.
+template <uint8_t Scale>
+void drawRawRun(const uint8_t *src, int16_t x, int16_t y, int16_t count)
+{
+  const PalettePixels pixels{src, rawLinePalette};
+  if (Scale == 1)
+  {
+    replicatePixels<1>(lineBuffer, count, 1, pixels);
+    blitRun(x, y, count);
+    return;
+  }
+  const int16_t scale = Scale ? Scale : gifScale;
+  const int16_t visible = static_cast<int16_t>(
+      min(static_cast<int32_t>(count) * scale, static_cast<int32_t>(CANVAS_WIDTH) - x));
+  const int16_t whole = static_cast<int16_t>(visible / scale);
+  replicatePixels<Scale>(lineBuffer, whole, scale, pixels);
+  const int16_t written = static_cast<int16_t>(whole * scale);
+  if (written < visible)
+  {
+    fillPixels(lineBuffer + written, static_cast<int16_t>(visible - written), pixels(whole));
+  }
+  blitScaledRun(x, y, visible, static_cast<uint8_t>(scale));
+}
+
+// One clipped RAW line of `width` palette indices at panel position (x, y).
+template <bool Transparent, uint8_t Scale>
+void drawRawLine(const uint8_t *src, int16_t x, int16_t y, int16_t width)
+{
+  if (!Transparent)
+  {
+    drawRawRun<Scale>(src, x, y, width);
+    return;
+  }
+  const int16_t scale = Scale ? Scale : gifScale;
+  const uint8_t transparent = rawTransparent;
+  int16_t i = 0;
+  while (i < width)
+  {
+    while (i < width && src[i] == transparent)
+    {
+      ++i;
+    }
+    const int16_t start = i;
+    while (i < width && src[i] != transparent)
+    {
+      ++i;
+    }
+    if (i > start)
+    {
+      drawRawRun<Scale>(src + start, static_cast<int16_t>(x + start * scale), y, static_cast<int16_t>(i - start));
+    }
+  }
+}
+
+template <bool Transparent>
+RawLineKernel rawLineKernelFor(uint8_t scale)
+{
+  switch (scale)
+  {
+  case 1:
+    return drawRawLine<Transparent, 1>;
+  case 2:
+    return drawRawLine<Transparent, 2>;
+  default:
+    return drawRawLine<Transparent, 0>;
+  }
+}
+
+void beginRawFrame(const GIFDRAW *pDraw)
+{
+  const uint8_t scale = gifScaleEnabled ? gifScale : 1;
+  rawTransparent = pDraw->ucTransparent;
+  rawLinePalette = pDraw->pPalette;
+  if (pDraw->ucDisposalMethod == 2)
+  {
+    memcpy(rawPalette, pDraw->pPalette, sizeof(rawPalette));
+    rawPalette[pDraw->ucTransparent] = pDraw->pPalette[pDraw->ucBackground];
+    rawLinePalette = rawPalette;
+    rawLineKernel = rawLineKernelFor<false>(scale);
+    return;
+  }
+  rawLineKernel = pDraw->ucHasTransparency ? rawLineKernelFor<true>(scale) : rawLineKernelFor<false>(scale);
+}
+
+void GIFDraw(GIFDRAW *pDraw)
+{
+  if (gifCooked)
+  {
+    GIFDrawCooked(pDraw);
+    return;
+  }
+  if (pDraw->y == 0 || !rawLineKernel)
+  {
+    beginRawFrame(pDraw);
+  }
+
+  int16_t x = offsetX + pDraw->iX;
+  int16_t y = offsetY + pDraw->iY + pDraw->y;
+  int16_t width = static_cast<int16_t>(pDraw->iWidth);
+  const uint8_t *src = pDraw->pPixels;
+
+  if (x >= CANVAS_WIDTH || y >= CANVAS_HEIGHT)
+  {
+    return;
+  }
+
+  if (x < 0)
+  {
+    const int16_t delta = static_cast<int16_t>(-x);
+    x = 0;
+    width -= delta;
+    src += delta;
+  }
+
+  if (width <= 0)
+  {
+    return;
+  }
+
+  if (x + width > CANVAS_WIDTH)
+  {
+    width = CANVAS_WIDTH - x;
+  }
+
+  if (width <= 0)
+  {
+    return;
+  }
+
+  if (gifScaleEnabled)
+  {
+    const uint8_t scale = gifScale;
+    const int16_t xScaled = static_cast<int16_t>(x * scale);
+    const int16_t yScaled = static_cast<int16_t>(y * scale);
+    if (xScaled >= CANVAS_WIDTH || yScaled >= CANVAS_HEIGHT)
+    {
+      return;
+    }
+
+    const int16_t scaledAvailX = static_cast<int16_t>(CANVAS_WIDTH - xScaled);
+    const int16_t maxWidth = static_cast<int16_t>((scaledAvailX + scale - 1) / scale);
+    if (width > maxWidth)
+    {
+      width = maxWidth;
+    }
+    rawLineKernel(src, xScaled, yScaled, width);
+    return;
+  }
+
+  rawLineKernel(src, x, y, width);
+}
+
+void resetDecodeStats()
+{
+  decodeMicrosTotal = 0;
+  decodeMicrosMax = 0;
+  decodeFrames = 0;
+  lastStatsMillis = millis();
+#if defined(ANIMATED_GIF_USE_SD)
+  gifReadCache.resetStats();
+  spiBusResetStats();
+#endif
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+  frameCacheHits = 0;
+  frameCacheMisses = 0;
+  frameCacheSavedMicros = 0;
+#endif
+#if defined(ANIMATED_GIF_USE_SD) && ANIMATED_GIF_FRAME_INDEX
+  clockDroppedFrames = 0;
+  clockLateFrames = 0;
+  clockSeeks = 0;
+  duplicateFramesSkipped = 0;
+  duplicateEstimatedMicros = 0;
+#endif
+}
+
+// Attach turbo + frame buffers sized for the current canvas, or drop back to
+// the RAW per-line path when they cannot be allocated. `canvasBuffer` is the
+// frame buffer owned by the decoder being configured.
+void configureDecodeMode(uint8_t *&canvasBuffer, size_t &canvasBufferSize)
+{
+  flushBand();
+  gifCooked = false;
+
+#if ANIMATED_GIF_TURBO
+  const size_t canvasPixels =
+      static_cast<size_t>(gif->getCanvasWidth()) * static_cast<size_t>(gif->getCanvasHeight());
+  // Same sizes allocTurboBuf()/allocFrameBuf() use: LZW tables + 8-bit canvas,
+  // and the canvas plus room for one cooked RGB565 line.
+  const size_t turboSize = TURBO_BUFFER_SIZE + canvasPixels;
+  const size_t frameSize = canvasPixels + static_cast<size_t>(gif->getCanvasWidth()) * 3;
+  if (psramReserve(turboBuffer, turboBufferSize, turboSize) &&
+      psramReserve(canvasBuffer, canvasBufferSize, frameSize))
+  {
+    memset(canvasBuffer, 0, frameSize);
+    gif->setTurboBuf(turboBuffer);
+    gif->setFrameBuf(canvasBuffer);
+    gif->setDrawType(GIF_DRAW_COOKED);
+    gifCooked = true;
+    cookedCanvasTrusted = false;
+  }
+  else
+  {
+    Serial.printf("Animated GIF: turbo buffers unavailable (%u bytes), using RAW decode\n",
+                  static_cast<unsigned>(turboSize + frameSize));
+  }
+#endif
+
+  if (!gifCooked)
+  {
+    gif->setTurboBuf(nullptr);
+    gif->setFrameBuf(nullptr);
+    gif->setDrawType(GIF_DRAW_RAW);
+  }
+  resetDecodeStats();
+}
+
+void reportDecodeStats(uint32_t now)
+{
+  if (ANIMATED_GIF_STATS_INTERVAL_MS == 0 || decodeFrames == 0 ||
+      (now - lastStatsMillis) < static_cast<uint32_t>(ANIMATED_GIF_STATS_INTERVAL_MS))
+  {
+    return;
+  }
+  const char *mode = gifCooked ? "turbo" : "raw";
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+  if (cachedGif)
+  {
+    mode = "cache";
+  }
+  if (frameCacheHits > 0 || frameCache.isRecording())
+  {
+    Serial.printf("Animated GIF: frame cache %lu hits/%lu decoded (%lu%%), saved %lu us/frame, %u bytes resident\n",
+                  static_cast<unsigned long>(frameCacheHits), static_cast<unsigned long>(frameCacheMisses),
+                  static_cast<unsigned long>(frameCacheHits * 100UL / decodeFrames),
+                  static_cast<unsigned long>(frameCacheHits ? frameCacheSavedMicros / frameCacheHits : 0),
+                  static_cast<unsigned>(frameCache.residentBytes()));
+  }
+#endif
+  Serial.printf("Animated GIF: %s decode avg %lu us/frame, max %lu us (%lu frames)\n",
+                mode,
+                static_cast<unsigned long>(decodeMicrosTotal / decodeFrames),
+                static_cast<unsigned long>(decodeMicrosMax),
+                static_cast<unsigned long>(decodeFrames));
+#if defined(ANIMATED_GIF_USE_SD) && ANIMATED_GIF_FRAME_INDEX
+  const GifTimebase timebase = currentTimebase();
+  if (timebase.synced())
+  {
+    Serial.printf("Animated GIF: clock drift last %ld ms, max %lu ms (%lu packets), %lu frames dropped, %lu late, "
+                  "%lu seeks\n",
+                  static_cast<long>(timebase.lastDriftMs()), static_cast<unsigned long>(timebase.maxDriftMs()),
+                  static_cast<unsigned long>(timebase.resyncs()), static_cast<unsigned long>(clockDroppedFrames),
+                  static_cast<unsigned long>(clockLateFrames), static_cast<unsigned long>(clockSeeks));
+    TimebaseLock lock;
+    gifTimebase.resetStats();
+  }
+  if (duplicateFramesSkipped > 0)
+  {
+    Serial.printf("Animated GIF: skipped %lu repeated frames, about %lu us of decoding (estimated)\n",
+                  static_cast<unsigned long>(duplicateFramesSkipped),
+                  static_cast<unsigned long>(duplicateEstimatedMicros));
+  }
+#endif
+#if defined(ANIMATED_GIF_USE_SD)
+  bool streamed = !gifPreloaded;
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+  streamed = streamed && frameCacheMisses > 0;
+#endif
+  if (!streamed)
+  {
+    resetDecodeStats();
+    return;
+  }
+  const GifReadCacheStats &io = gifReadCache.stats();
+  Serial.printf("Animated GIF: reads %lu/frame (+%lu in place), %lu bytes copied/frame, SD %lu bytes (%lu raw "
+                "sectors) in %lu refills, io %lu us/frame\n",
+                static_cast<unsigned long>(io.readCalls / decodeFrames),
+                static_cast<unsigned long>(io.mapCalls / decodeFrames),
+                static_cast<unsigned long>(io.bytesServed / decodeFrames),
+                static_cast<unsigned long>(io.bytesFromCard), static_cast<unsigned long>(io.bytesDirect),
+                static_cast<unsigned long>(io.refills),
+                static_cast<unsigned long>(io.ioMicros / decodeFrames));
+  // Held time as a share of the interval: SD bursts and panel bursts should
+  // alternate, so waits stay short while both shares are high.
+  const SpiBusStats &bus = spiBusStats();
+  const uint32_t intervalMicros = (now - lastStatsMillis) * 1000UL;
+  const size_t sd = static_cast<size_t>(SpiBusUser::Sd);
+  const size_t panel = static_cast<size_t>(SpiBusUser::Panel);
+  Serial.printf("Animated GIF: bus SD %lu%% panel %lu%%, waits SD %lu us/frame panel %lu us/frame, "
+                "read-ahead %lu/%lu used, %lu stalls (%lu us)\n",
+                static_cast<unsigned long>(bus.heldMicros[sd] / (intervalMicros / 100UL)),
+                static_cast<unsigned long>(bus.heldMicros[panel] / (intervalMicros / 100UL)),
+                static_cast<unsigned long>(bus.waitMicros[sd] / decodeFrames),
+                static_cast<unsigned long>(bus.waitMicros[panel] / decodeFrames),
+                static_cast<unsigned long>(io.prefetchHits), static_cast<unsigned long>(io.prefetches),
+                static_cast<unsigned long>(io.stalls), static_cast<unsigned long>(io.stallMicros));
+#endif
+  resetDecodeStats();
+}
+
+// Centres the canvas on the panel, scaled up by the smallest integer factor
+// that covers it.
+void applyCanvasLayout()
+{
+  const int canvasWidth = gif->getCanvasWidth();
+  const int canvasHeight = gif->getCanvasHeight();
+
+  gifSourceWidth = static_cast<uint16_t>(canvasWidth);
+  gifSourceHeight = static_cast<uint16_t>(canvasHeight);
+  const uint8_t targetScale = static_cast<uint8_t>(
+      max((CANVAS_WIDTH + canvasWidth - 1) / canvasWidth, (CANVAS_HEIGHT + canvasHeight - 1) / canvasHeight));
+  gifScale = targetScale < 1 ? 1 : targetScale;
+  gifScaleEnabled = gifScale > 1;
+  const uint16_t scaledWidth = static_cast<uint16_t>(canvasWidth * gifScale);
+  const uint16_t scaledHeight = static_cast<uint16_t>(canvasHeight * gifScale);
+  offsetX = static_cast<int16_t>((static_cast<int32_t>(CANVAS_WIDTH) - static_cast<int32_t>(scaledWidth)) / 2);
+  offsetY = static_cast<int16_t>((static_cast<int32_t>(CANVAS_HEIGHT) - static_cast<int32_t>(scaledHeight)) / 2);
+}
+
+AnimatedGIF *createDecoder()
+{
+  void *memory = psramAlloc(sizeof(AnimatedGIF));
+  if (!memory)
+  {
+    return nullptr;
+  }
+  AnimatedGIF *decoder = new (memory) AnimatedGIF();
+  decoder->begin(PANEL_NATIVE_PIXELS ? BIG_ENDIAN_PIXELS : LITTLE_ENDIAN_PIXELS);
+  return decoder;
+}
+
+#if defined(ANIMATED_GIF_USE_SD)
+#if defined(ANIMATED_GIF_SD_DIRECT_READS)
+bool readSdSectors(void *, uint32_t sector, uint8_t *dest, uint32_t count)
+{
+  // Multi-block read through the card driver under FatFs.
+  return disk_read(ANIMATED_GIF_SD_DRIVE, dest, sector, count) == RES_OK;
+}
+
+// Fills `extent` when `path` is stored in one run of clusters; otherwise it
+// stays empty and the file is read through the FAT layer.
+void locateGifOnCard(const char *path, FatExtent &extent)
+{
+  extent = {};
+  if (!sdVolumeMountTried)
+  {
+    sdVolumeMountTried = true;
+    if (sdVolume.mount(readSdSectors, nullptr))
+    {
+      gifReadCache.setSectorReader(readSdSectors, nullptr);
+    }
+    else
+    {
+      Serial.println("Animated GIF: SD card is not FAT16/FAT32, reading through the FAT layer");
+    }
+  }
+  if (sdVolume.mounted() && sdVolume.locate(path, &extent) == FatFileLayout::Fragmented)
+  {
+    Serial.printf("Animated GIF: %s is fragmented, reading through the FAT layer\n", path);
+  }
+}
+#endif
+
+void *GIFOpenFile(const char *szFilename, int32_t *pFileSize)
+{
+  SpiBusGuard bus;
+  File &file = openingSlot->file;
+  file.close();
+  file = SD.open(szFilename, FILE_READ);
+  if (!file)
+  {
+    return nullptr;
+  }
+  *pFileSize = static_cast<int32_t>(file.size());
+#if defined(ANIMATED_GIF_SD_DIRECT_READS)
+  locateGifOnCard(szFilename, openingSlot->extent);
+#else
+  openingSlot->extent = {};
+#endif
+  gifReadCache.attach(&file, *pFileSize, &openingSlot->extent);
+  return static_cast<void *>(&file);
+}
+
+void GIFCloseFile(void *pHandle)
+{
+  SpiBusGuard bus;
+  File *file = static_cast<File *>(pHandle);
+  if (gifReadCache.attachedTo(file))
+  {
+    gifReadCache.detach();
+  }
+  if (file)
+  {
+    file->close();
+  }
+}
+
+int32_t GIFReadFile(GIFFILE *pFile, uint8_t *pBuf, int32_t iLen)
+{
+  File *file = static_cast<File *>(pFile->fHandle);
+  if (!file)
+  {
+    return 0;
+  }
+
+  int32_t bytesToRead = iLen;
+  if ((pFile->iSize - pFile->iPos) < iLen)
+  {
+    bytesToRead = pFile->iSize - pFile->iPos;
+  }
+  if (bytesToRead <= 0)
+  {
+    return 0;
+  }
+
+#if defined(ANIMATED_GIF_TELEMETRY_TABLE)
+  const uint32_t start = micros();
+#endif
+  const int32_t bytesRead = gifReadCache.read(pFile->iPos, pBuf, bytesToRead);
+#if defined(ANIMATED_GIF_TELEMETRY_TABLE)
+  if (GifTelemetry *t = loadedTelemetry())
+  {
+    t->addRead(micros() - start, static_cast<uint32_t>(bytesRead));
+  }
+#endif
+  pFile->iPos += bytesRead;
+  return bytesRead;
+}
+
+#if ANIMATED_GIF_MAP_READS
+// Lets the decoder take LZW sub-blocks straight out of the read-ahead window.
+uint8_t *GIFMapFile(GIFFILE *pFile, int32_t *piAvailable)
+{
+  *piAvailable = 0;
+  if (!pFile->fHandle)
+  {
+    return nullptr;
+  }
+#if defined(ANIMATED_GIF_TELEMETRY_TABLE)
+  const uint32_t start = micros();
+  uint8_t *data = gifReadCache.map(pFile->iPos, piAvailable);
+  if (GifTelemetry *t = loadedTelemetry())
+  {
+    t->addRead(micros() - start, 0);
+  }
+  return data;
+#else
+  return gifReadCache.map(pFile->iPos, piAvailable);
+#endif
+}
+#endif
+
+int32_t GIFSeekFile(GIFFILE *pFile, int32_t iPosition)
+{
+  if (iPosition < 0)
+  {
+    iPosition = 0;
+  }
+  else if (iPosition >= pFile->iSize)
+  {
+    iPosition = pFile->iSize - 1;
+  }
+
+  File *file = static_cast<File *>(pFile->fHandle);
+  if (!file)
+  {
+    return 0;
+  }
+
+  // The read cache seeks the card lazily on its next refill.
+  pFile->iPos = iPosition;
+  return iPosition;
+}
+
+// Closes the file held by `slot`; its decoder object is kept for reuse.
+void closeDecoderSlot(GifDecoderSlot &slot)
+{
+  if (!slot.open)
+  {
+    return;
+  }
+  slot.decoder->close();
+  slot.open = false;
+#if ANIMATED_GIF_FRAME_INDEX
+  resumeFrames[slot.index] = slot.playingFromCache ? slot.cachedFrameIndex : slot.nextFrame;
+#endif
+  if (activeSlot == &slot)
+  {
+    activeSlot = nullptr;
+    gifReady = false;
+  }
+}
+
+GifDecoderSlot *findDecoderSlot(size_t index)
+{
+  for (GifDecoderSlot &slot : decoderPool)
+  {
+    if (slot.open && slot.index == index)
+    {
+      return &slot;
+    }
+  }
+  return nullptr;
+}
+
+// Returns an unused slot, closing the least recently used decoder when the
+// pool is full. nullptr when no decoder could be allocated.
+GifDecoderSlot *acquireDecoderSlot()
+{
+  GifDecoderSlot *choice = nullptr;
+  for (GifDecoderSlot &slot : decoderPool)
+  {
+    if (!slot.open)
+    {
+      choice = &slot;
+      break;
+    }
+    if (!choice || slot.lastUsed < choice->lastUsed)
+    {
+      choice = &slot;
+    }
+  }
+  closeDecoderSlot(*choice);
+  if (!choice->decoder)
+  {
+    choice->decoder = createDecoder();
+  }
+  return choice->decoder ? choice : nullptr;
+}
+
+#if ANIMATED_GIF_PRELOAD_MAX_BYTES > 0
+void evictPreloadedGif(PreloadedGif &slot)
+{
+  // A pooled decoder playing from this copy has to go with it.
+  GifDecoderSlot *decoder = findDecoderSlot(slot.index);
+  if (decoder && decoder->preloaded)
+  {
+    closeDecoderSlot(*decoder);
+  }
+  free(slot.data);
+  preloadedBytes -= slot.size;
+  slot = {};
+}
+
+// Frees the least recently used file; false when nothing is left to evict.
+bool evictLeastRecentlyUsedGif()
+{
+  PreloadedGif *oldest = nullptr;
+  for (PreloadedGif &slot : preloadedGifs)
+  {
+    if (slot.data && (!oldest || slot.lastUsed < oldest->lastUsed))
+    {
+      oldest = &slot;
+    }
+  }
+  if (!oldest)
+  {
+    return false;
+  }
+  evictPreloadedGif(*oldest);
+  return true;
+}
+
+PreloadedGif *freePreloadSlot()
+{
+  for (PreloadedGif &slot : preloadedGifs)
+  {
+    if (!slot.data)
+    {
+      return &slot;
+    }
+  }
+  return nullptr;
+}
+
+// Reads `size` bytes in read-cache sized pieces and closes the file, taking
+// the bus for one piece at a time so the panel is not locked out meanwhile.
+size_t readWholeFile(File &file, uint8_t *data, size_t size)
+{
+  constexpr size_t CHUNK_BYTES = 32 * 1024;
+  size_t bytesRead = 0;
+  while (bytesRead < size)
+  {
+    SpiBusGuard bus;
+    const size_t chunk = size - bytesRead < CHUNK_BYTES ? size - bytesRead : CHUNK_BYTES;
+    const size_t got = file.read(data + bytesRead, chunk);
+    bytesRead += got;
+    if (got != chunk)
+    {
+      break;
+    }
+  }
+  SpiBusGuard bus;
+  file.close();
+  return bytesRead;
+}
+
+// Returns the resident copy of `index`, loading it first when the file is
+// small enough. nullptr means the file has to be streamed.
+PreloadedGif *acquirePreloadedGif(size_t index, const char *filename)
+{
+  ++preloadClock;
+  for (PreloadedGif &slot : preloadedGifs)
+  {
+    if (slot.data && slot.index == index)
+    {
+      slot.lastUsed = preloadClock;
+      return &slot;
+    }
+  }
+  if (gifTooLargeToPreload[index])
+  {
+    return nullptr;
+  }
+
+  File file;
+  size_t size = 0;
+  {
+    SpiBusGuard bus;
+    file = SD.open(filename, FILE_READ);
+    if (!file)
+    {
+      return nullptr;
+    }
+    size = file.size();
+    if (size == 0 || size > ANIMATED_GIF_PRELOAD_MAX_BYTES || size > ANIMATED_GIF_PRELOAD_BUDGET_BYTES)
+    {
+      gifTooLargeToPreload[index] = true;
+      file.close();
+      return nullptr;
+    }
+  }
+
+  while (preloadedBytes + size > ANIMATED_GIF_PRELOAD_BUDGET_BYTES || !freePreloadSlot())
+  {
+    evictLeastRecentlyUsedGif();
+  }
+  uint8_t *data = static_cast<uint8_t *>(psramAlloc(size));
+  while (!data && evictLeastRecentlyUsedGif())
+  {
+    data = static_cast<uint8_t *>(psramAlloc(size));
+  }
+  if (!data)
+  {
+    SpiBusGuard bus;
+    file.close();
+    return nullptr;
+  }
+
+  const uint32_t start = millis();
+  const size_t bytesRead = readWholeFile(file, data, size);
+  if (bytesRead != size)
+  {
+    Serial.printf("Animated GIF: preload of %s failed (%u/%u bytes)\n", filename,
+                  static_cast<unsigned>(bytesRead), static_cast<unsigned>(size));
+    free(data);
+    return nullptr;
+  }
+
+  PreloadedGif *slot = freePreloadSlot();
+  slot->index = index;
+  slot->data = data;
+  slot->size = size;
+  slot->lastUsed = preloadClock;
+  preloadedBytes += size;
+  Serial.printf("Animated GIF: preloaded %s (%u bytes) in %lu ms, %u bytes resident\n", filename,
+                static_cast<unsigned>(size), static_cast<unsigned long>(millis() - start),
+                static_cast<unsigned>(preloadedBytes));
+  return slot;
+}
+#endif
+
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+// Called at the start of every loop: replays the file from the cache when it
+// has been recorded, otherwise records this pass if the file is eligible.
+void prepareFrameCache(size_t index)
+{
+  frameCache.abortRecording();
+  cachedGif = frameCache.find(index);
+  cachedFrameIndex = 0;
+  if (cachedGif || !gifCooked || gifFrameCacheRejected[index])
+  {
+    return;
+  }
+  // Replay converts rows through lineBuffer, so wider canvases are skipped.
+  if (gifSourceWidth > CANVAS_WIDTH ||
+      !frameCache.startRecording(index, gifSourceWidth, gifSourceHeight, panelPixel(ANIMATED_GIF_BACKGROUND)))
+  {
+    gifFrameCacheRejected[index] = true;
+  }
+}
+
+// Picks the frame cache state back up for a decoder resumed from the pool. A
+// recording only continues if it belongs to this file; one for another file
+// is dropped because it would see this file's lines. A replay whose entry was
+// evicted meanwhile continues by decoding from where the decoder was left (the
+// first frame, unless a frame index lets the caller seek).
+void resumeFrameCache(size_t index, bool playingFromCache, uint16_t frameIndex)
+{
+  cachedGif = nullptr;
+  cachedFrameIndex = 0;
+  if (frameCache.isRecording() && frameCache.recordingFileIndex() == index)
+  {
+    return;
+  }
+  frameCache.abortRecording();
+  if (playingFromCache)
+  {
+    cachedGif = frameCache.find(index);
+    cachedFrameIndex = cachedGif && frameIndex < cachedGif->frameCount ? frameIndex : 0;
+  }
+}
+
+// Records the composite of the frame just decoded; drops the recording and
+// stops trying for this file once it no longer fits the budget.
+void commitCachedFrame(int delayMs, uint32_t decodeMicros)
+{
+  const size_t index = frameCache.recordingFileIndex();
+  if (!frameCache.commitFrame(static_cast<uint16_t>(delayMs < 0 ? 0 : delayMs), decodeMicros))
+  {
+    gifFrameCacheRejected[index] = true;
+    Serial.printf("Animated GIF: %s exceeds the frame cache budget, decoding every loop\n", kGifFiles[index]);
+  }
+}
+
+void finishFrameCacheRecording()
+{
+  const GifFrameCacheEntry *entry = frameCache.finishRecording();
+  if (entry)
+  {
+    Serial.printf("Animated GIF: cached %u frames of %s (%s, %u bytes), %u bytes resident\n",
+                  static_cast<unsigned>(entry->frameCount), kGifFiles[entry->fileIndex],
+                  entry->indexed ? "indexed" : "rgb565", static_cast<unsigned>(entry->bytes),
+                  static_cast<unsigned>(frameCache.residentBytes()));
+  }
+}
+
+// Draws the next cached frame through the band path. Returns 0 after the last
+// frame, like playFrame().
+int playCachedFrame(int *delayMs)
+{
+  const GifCachedFrame &frame = cachedGif->frames[cachedFrameIndex];
+  const int16_t scale = gifScaleEnabled ? gifScale : 1;
+  const uint16_t width = cachedGif->width;
+  for (uint16_t row = 0; row < cachedGif->height; ++row)
+  {
+    const int16_t y = static_cast<int16_t>(offsetY + row * scale);
+    if (y + scale <= 0)
+    {
+      continue;
+    }
+    if (y >= static_cast<int16_t>(CANVAS_HEIGHT))
+    {
+      break;
+    }
+    const uint16_t *src = nullptr;
+    if (cachedGif->indexed)
+    {
+      const uint8_t *indices = frame.pixels + static_cast<size_t>(row) * width;
+      for (uint16_t i = 0; i < width; ++i)
+      {
+        lineBuffer[i] = cachedGif->palette[indices[i]];
+      }
+      src = lineBuffer;
+    }
+    else
+    {
+      src = reinterpret_cast<const uint16_t *>(frame.pixels) + static_cast<size_t>(row) * width;
+    }
+    appendBandLine(src, offsetX, y, static_cast<int16_t>(width), scale);
+  }
+  *delayMs = frame.delayMs;
+  if (++cachedFrameIndex < cachedGif->frameCount)
+  {
+    return 1;
+  }
+  cachedFrameIndex = 0;
+  return 0;
+}
+#endif
+
+#if ANIMATED_GIF_FRAME_INDEX
+// Moves playback of the loaded file to `frame`: exactly when its loop is
+// replayed from the frame cache, otherwise to the last keyframe at or before
+// it, from which the decoder rebuilds the canvas on its own.
+void seekToFrame(size_t frame)
+{
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+  if (cachedGif)
+  {
+    cachedFrameIndex = static_cast<uint16_t>(frame < cachedGif->frameCount ? frame : 0);
+    return;
+  }
+#endif
+  const GifFrameIndex &frameIndex = frameIndexes[loadedGifIndex];
+  size_t keyframe = frameIndex.keyframeAtOrBefore(frame);
+  if (keyframe == nextFrame)
+  {
+    return;
+  }
+  if (keyframe == 0 || !gif->seekFrame(&frameIndex.frame(keyframe)))
+  {
+    keyframe = 0;
+    gif->reset();
+  }
+  nextFrame = static_cast<uint16_t>(keyframe);
+  cookedCanvasTrusted = false;
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+  // Recordings have to run from the first frame to the last in order.
+  if (keyframe == 0)
+  {
+    prepareFrameCache(loadedGifIndex);
+  }
+  else
+  {
+    frameCache.abortRecording();
+  }
+#endif
+}
+#endif
+
+void parkActiveDecoder()
+{
+  if (!activeSlot)
+  {
+    return;
+  }
+  flushBand();
+  activeSlot->canvasTrusted = cookedCanvasTrusted;
+  activeSlot->nextFrame = nextFrame;
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+  activeSlot->playingFromCache = cachedGif != nullptr;
+  activeSlot->cachedFrameIndex = cachedFrameIndex;
+#endif
+}
+
+// Makes a pooled decoder current again, at the frame where it stopped. False
+// when the shared turbo buffer can no longer be sized for it.
+bool resumeDecoderSlot(GifDecoderSlot &slot)
+{
+  gif = slot.decoder;
+  if (slot.cooked)
+  {
+    const size_t canvasPixels =
+        static_cast<size_t>(gif->getCanvasWidth()) * static_cast<size_t>(gif->getCanvasHeight());
+    if (!psramReserve(turboBuffer, turboBufferSize, TURBO_BUFFER_SIZE + canvasPixels))
+    {
+      return false;
+    }
+    // The shared buffer may have been regrown for another canvas.
+    gif->setTurboBuf(turboBuffer);
+  }
+  activeSlot = &slot;
+  slot.lastUsed = ++decoderClock;
+  loadedGifIndex = slot.index;
+  currentGifIndex = slot.index;
+  gifPreloaded = slot.preloaded;
+  if (!slot.preloaded)
+  {
+    gifReadCache.attach(&slot.file, static_cast<int32_t>(slot.file.size()), &slot.extent);
+  }
+  applyCanvasLayout();
+  gifCooked = slot.cooked;
+  cookedCanvasTrusted = slot.canvasTrusted;
+  nextFrame = slot.nextFrame;
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+  resumeFrameCache(slot.index, slot.playingFromCache, slot.cachedFrameIndex);
+#if ANIMATED_GIF_FRAME_INDEX
+  if (slot.playingFromCache && !cachedGif)
+  {
+    // The replayed entry was evicted: continue decoding near that frame.
+    seekToFrame(slot.cachedFrameIndex);
+  }
+#endif
+#endif
+  resetDecodeStats();
+  return true;
+}
+
+// Makes the decoder that was current before a failed open current again, as
+// it was parked. When the open had to close it, nothing is left playing.
+bool restoreParkedDecoder(GifDecoderSlot *previous, bool wasReady)
+{
+  if (previous && previous->open && activeSlot == previous && resumeDecoderSlot(*previous))
+  {
+    gifReady = wasReady;
+  }
+  else
+  {
+    activeSlot = nullptr;
+    gifReady = false;
+  }
+  return false;
+}
+
+bool openGifAtIndex(size_t index)
+{
+  parkActiveDecoder();
+  GifDecoderSlot *const previous = activeSlot;
+  const bool wasReady = gifReady;
+  gifReady = false;
+  stagedFrameReady = false;
+
+  if (index >= kGifFileCount || gifPlaylist.missing(index))
+  {
+    return restoreParkedDecoder(previous, wasReady);
+  }
+
+  const char *filename = kGifFiles[index];
+  GifDecoderSlot *slot = findDecoderSlot(index);
+  if (slot)
+  {
+    if (resumeDecoderSlot(*slot))
+    {
+      Serial.printf("Animated GIF: resumed %s from the decoder pool\n", filename);
+      resetGifTiming();
+      gifReady = true;
+      return true;
+    }
+    closeDecoderSlot(*slot);
+  }
+
+  slot = acquireDecoderSlot();
+  if (!slot)
+  {
+    Serial.printf("Animated GIF: no decoder memory for %s\n", filename);
+    return restoreParkedDecoder(previous, wasReady);
+  }
+  // Nothing below touches the player state until the file is open, so a
+  // failure can hand the previous decoder back.
+  AnimatedGIF *decoder = slot->decoder;
+  bool preloadedOpen = false;
+  uint32_t fileSize = 0;
+#if ANIMATED_GIF_PRELOAD_MAX_BYTES > 0
+  PreloadedGif *preloaded = acquirePreloadedGif(index, filename);
+  if (preloaded)
+  {
+    fileSize = static_cast<uint32_t>(preloaded->size);
+    preloadedOpen = decoder->open(preloaded->data, static_cast<int>(preloaded->size), GIFDraw) != 0;
+    if (!preloadedOpen)
+    {
+      evictPreloadedGif(*preloaded);
+    }
+#if !ANIMATED_GIF_MAP_READS
+    // open() maps memory images on its own.
+    decoder->setMapCallback(nullptr);
+#endif
+  }
+#endif
+  if (!preloadedOpen)
+  {
+    openingSlot = slot;
+    const bool opened =
+        decoder->open(filename, GIFOpenFile, GIFCloseFile, GIFReadFile, GIFSeekFile, GIFDraw) != 0;
+    openingSlot = nullptr;
+    if (!opened)
+    {
+      decoder->close();
+      Serial.printf("Animated GIF: failed to open %s\n", filename);
+      return restoreParkedDecoder(previous, wasReady);
+    }
+#if ANIMATED_GIF_MAP_READS
+    decoder->setMapCallback(GIFMapFile);
+#endif
+    fileSize = static_cast<uint32_t>(slot->file.size());
+  }
+
+  gif = decoder;
+  loadedGifIndex = index;
+  currentGifIndex = index;
+  gifPreloaded = preloadedOpen;
+  slot->open = true;
+  slot->index = index;
+  slot->preloaded = gifPreloaded;
+  slot->lastUsed = ++decoderClock;
+  activeSlot = slot;
+  applyCanvasLayout();
+  configureDecodeMode(slot->frameBuffer, slot->frameBufferSize);
+  slot->cooked = gifCooked;
+  nextFrame = 0;
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+  prepareFrameCache(index);
+#endif
+#if ANIMATED_GIF_FRAME_INDEX
+  if (frameIndexes[index].valid() || frameIndexes[index].loadOrBuild(*gif, filename, fileSize))
+  {
+    frameIndexes[index].setPlaybackDelays(ANIMATED_GIF_DEFAULT_DELAY, ANIMATED_GIF_MAX_DELAY);
+    seekToFrame(resumeFrames[index]);
+  }
+#endif
+  resetGifTiming();
+  gifReady = true;
+  return true;
+}
+
+bool openNextGif()
+{
+  if (kGifFileCount == 0)
+  {
+    return false;
+  }
+
+  for (size_t attempt = 0; attempt < kGifFileCount; ++attempt)
+  {
+    const size_t index = (currentGifIndex + attempt) % kGifFileCount;
+    if (openGifAtIndex(index))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+#endif
+
+// A frame's delay as played: missing ones become the default and long ones
+// are cut.
+int playbackDelay(int delayMs)
+{
+  if (delayMs <= 0)
+  {
+    delayMs = ANIMATED_GIF_DEFAULT_DELAY;
+  }
+  if (delayMs > ANIMATED_GIF_MAX_DELAY)
+  {
+    delayMs = ANIMATED_GIF_MAX_DELAY;
+  }
+  return delayMs;
+}
+
+#if defined(ANIMATED_GIF_USE_SD) && ANIMATED_GIF_FRAME_INDEX && ANIMATED_GIF_SKIP_DUPLICATES
+// Compares frame `frame`, just decoded, with the frame decoded before it and
+// flags it in the index when both came from the same bytes. The hash covers
+// only what the decoder read anyway, so no extra card pass is needed.
+void recordFrameHash(size_t frame)
+{
+  GifFrameIndex &frameIndex = frameIndexes[loadedGifIndex];
+  const uint32_t hash = gif->getFrameHash();
+  if (frameIndex.valid() && hashedGif == loadedGifIndex && hashedFrame + 1 == frame && hash == hashedFrameHash)
+  {
+    frameIndex.markDuplicate(frame);
+  }
+  hashedFrameHash = hash;
+  hashedGif = loadedGifIndex;
+  hashedFrame = frame;
+}
+
+// Seeks the decoder past frames that repeat the one just decoded and adds
+// their delays to its own. The last frame is always decoded, so the loop
+// still ends through playFrame(). Returns the number of frames skipped.
+size_t skipDuplicateFrames(int *delayMs)
+{
+  const GifFrameIndex &frameIndex = frameIndexes[loadedGifIndex];
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+  // Recordings hold every frame.
+  if (frameCache.isRecording())
+  {
+    return 0;
+  }
+#endif
+  if (!frameIndex.valid())
+  {
+    return 0;
+  }
+  size_t frame = nextFrame;
+  uint32_t heldMs = 0;
+  while (frame + 1 < frameIndex.frameCount() && frameIndex.duplicate(frame))
+  {
+    heldMs += frameIndex.playbackDelayMs(frame);
+    ++frame;
+  }
+  if (frame == nextFrame || !gif->seekFrame(&frameIndex.frame(frame)))
+  {
+    return 0;
+  }
+  *delayMs += static_cast<int>(heldMs);
+  const size_t skipped = frame - nextFrame;
+  nextFrame = static_cast<uint16_t>(frame);
+  // The frames skipped repeat the one hashed last, so the next frame decoded
+  // is compared with the last of them.
+  hashedFrame = frame - 1;
+  return skipped;
+}
+#endif
+
+// Decodes the next frame (or replays it from the frame cache) onto the panel
+// target and updates the stats. Returns playFrame()'s result; the delay comes
+// back as played, with the delays of skipped repeats added.
+int decodeNextFrame(int *delayOut, uint32_t now)
+{
+  int result = 0;
+  size_t skipped = 0;
+#if defined(ANIMATED_GIF_TELEMETRY_TABLE)
+  GifTelemetry *t = loadedTelemetry();
+  const uint32_t readMicrosBefore = t ? t->readMicros() : 0;
+  frameOutputMicros = 0;
+#endif
+  const uint32_t decodeStart = micros();
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+  const bool fromCache = cachedGif != nullptr;
+  const uint32_t cachedDecodeMicros = fromCache ? cachedGif->frames[cachedFrameIndex].decodeMicros : 0;
+  if (fromCache)
+  {
+    result = playCachedFrame(delayOut);
+  }
+  else
+#endif
+  {
+    result = gif->playFrame(false, delayOut);
+    *delayOut = playbackDelay(*delayOut);
+#if defined(ANIMATED_GIF_USE_SD) && ANIMATED_GIF_FRAME_INDEX && ANIMATED_GIF_SKIP_DUPLICATES
+    if (result >= 0)
+    {
+      recordFrameHash(nextFrame);
+    }
+#endif
+    if (result > 0)
+    {
+      ++nextFrame;
+#if defined(ANIMATED_GIF_USE_SD) && ANIMATED_GIF_FRAME_INDEX && ANIMATED_GIF_SKIP_DUPLICATES
+      skipped = skipDuplicateFrames(delayOut);
+#endif
+    }
+  }
+  flushBand();
+  endCookedFrame();
+  const uint32_t decodeMicros = micros() - decodeStart;
+#if defined(ANIMATED_GIF_USE_SD) && ANIMATED_GIF_FRAME_INDEX
+  duplicateFramesSkipped += skipped;
+  duplicateEstimatedMicros += skipped * decodeMicros;
+#else
+  (void)skipped;
+#endif
+  decodeMicrosTotal += decodeMicros;
+  if (decodeMicros > decodeMicrosMax)
+  {
+    decodeMicrosMax = decodeMicros;
+  }
+  ++decodeFrames;
+#if defined(ANIMATED_GIF_TELEMETRY_TABLE)
+  bool decoded = true;
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+  decoded = !fromCache;
+#endif
+  if (t && decoded)
+  {
+    t->addDecode(decodeMicros, t->readMicros() - readMicrosBefore, frameOutputMicros);
+  }
+#endif
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+  if (fromCache)
+  {
+    ++frameCacheHits;
+    frameCacheSavedMicros += cachedDecodeMicros > decodeMicros ? cachedDecodeMicros - decodeMicros : 0;
+  }
+  else
+  {
+    ++frameCacheMisses;
+  }
+  if (frameCache.isRecording())
+  {
+    if (result > 0 || (result == 0 && gif->getLastError() == GIF_SUCCESS))
+    {
+      commitCachedFrame(*delayOut, decodeMicros);
+    }
+    if (result < 0)
+    {
+      frameCache.abortRecording();
+    }
+    else if (result == 0)
+    {
+      finishFrameCacheRecording();
+    }
+  }
+#endif
+  reportDecodeStats(now);
+  return result;
+}
+
+void reportPanelDiffStats(uint32_t now)
+{
+  const GifPanelDiffStats &stats = panelDiff.stats();
+  if (ANIMATED_GIF_STATS_INTERVAL_MS == 0 || !panelDiff.active() || stats.pixelsIn == 0 ||
+      (now - lastDiffStatsMillis) < static_cast<uint32_t>(ANIMATED_GIF_STATS_INTERVAL_MS))
+  {
+    return;
+  }
+#if defined(ANIMATED_GIF_USE_SD)
+  const char *name = kGifFiles[loadedGifIndex];
+#else
+  const char *name = "resource";
+#endif
+  Serial.printf("Animated GIF: panel diff %s sent %lu%% of %lu px in %lu writes, %lu KB saved\n", name,
+                static_cast<unsigned long>(static_cast<uint64_t>(stats.pixelsSent) * 100 / stats.pixelsIn),
+                static_cast<unsigned long>(stats.pixelsIn), static_cast<unsigned long>(stats.writes),
+                static_cast<unsigned long>((stats.pixelsIn - stats.pixelsSent) * sizeof(uint16_t) / 1024));
+  panelDiff.resetStats();
+  lastDiffStatsMillis = now;
+}
+
+// Schedules the next frame after the played delay; the first frame of the
+// next loop follows the last one without a wait.
+void scheduleNextFrame(int result, int delayMs, uint32_t now)
+{
+  if (delayMs > UINT16_MAX)
+  {
+    delayMs = UINT16_MAX;
+  }
+
+#if defined(ANIMATED_GIF_TELEMETRY_TABLE)
+  if (GifTelemetry *t = loadedTelemetry())
+  {
+    t->frameShown(lastFrameDelay, now - lastFrameMillis, ANIMATED_GIF_LATE_MARGIN_MS);
+  }
+#endif
+  lastFrameDelay = result == 0 ? 0 : static_cast<uint16_t>(delayMs);
+  lastFrameMillis = now;
+  reportPanelDiffStats(now);
+}
+
+void rewindAfterLastFrame()
+{
+  gif->reset();
+  nextFrame = 0;
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+  prepareFrameCache(loadedGifIndex);
+#endif
+}
+
+// Stops on errors, schedules the next frame and rewinds after the last one.
+void finishFrame(int result, int delayMs, uint32_t now)
+{
+  if (result < 0)
+  {
+    Serial.printf("Animated GIF: playback error %d\n", gif->getLastError());
+    gifReady = false;
+#if defined(ANIMATED_GIF_USE_SD)
+    // Drop the decoder so the next open parses the file again.
+    closeDecoderSlot(*activeSlot);
+#if ANIMATED_GIF_FRAME_INDEX
+    resumeFrames[loadedGifIndex] = 0;
+#endif
+#else
+    gif->close();
+#endif
+    return;
+  }
+
+  scheduleNextFrame(result, delayMs, now);
+  if (result == 0)
+  {
+    rewindAfterLastFrame();
+  }
+}
+
+#if defined(ANIMATED_GIF_USE_SD) && ANIMATED_GIF_FRAME_INDEX
+// Frame the loaded file plays next, from the frame cache or the decoder.
+size_t playbackPosition()
+{
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+  if (cachedGif)
+  {
+    return cachedFrameIndex;
+  }
+#endif
+  return nextFrame;
+}
+
+bool clockLocked()
+{
+  return currentTimebase().synced() && frameIndexes[loadedGifIndex].durationMs() > 0;
+}
+
+// Frame whose image is on screen at `frame`: repeats are skipped, so the
+// frame they repeat stays up.
+size_t shownFrameAt(const GifFrameIndex &frameIndex, size_t frame)
+{
+#if ANIMATED_GIF_SKIP_DUPLICATES
+  return frameIndex.shownFrame(frame);
+#else
+  return frame;
+#endif
+}
+
+void noteShownFrame()
+{
+  const GifFrameIndex &frameIndex = frameIndexes[loadedGifIndex];
+  const size_t count = frameIndex.frameCount();
+  clockedFrame = count > 0 ? shownFrameAt(frameIndex, (playbackPosition() + count - 1) % count) : SIZE_MAX;
+}
+
+// Shows the frame the shared clock is at. Frames it has already passed are
+// dropped where that is exact (a frame cache replay, or a seek to a keyframe
+// past the decoder's position); delta frames in between still have to be
+// decoded and go out back to back without their delays, at most
+// ANIMATED_GIF_SYNC_MAX_CATCHUP per call. Ahead of the clock the current
+// frame is held.
+void playClockedFrames(uint32_t now)
+{
+  const GifFrameIndex &frameIndex = frameIndexes[loadedGifIndex];
+  const size_t count = frameIndex.frameCount();
+  const size_t target = shownFrameAt(frameIndex, frameIndex.frameAtTime(currentTimebase().now(now)));
+  if (target == clockedFrame)
+  {
+    return;
+  }
+  const size_t position = playbackPosition();
+  const size_t behind = (target + count - position) % count;
+  if (clockedFrame != SIZE_MAX && (clockedFrame + count - target) % count < behind)
+  {
+    return;
+  }
+
+  if (behind > 0)
+  {
+    bool seek = target < position;
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+    seek = seek || cachedGif != nullptr;
+#endif
+    if (seek || frameIndex.keyframeAtOrBefore(target) > position)
+    {
+      seekToFrame(target);
+      ++clockSeeks;
+      const size_t dropped = (playbackPosition() + count - position) % count;
+      clockDroppedFrames += dropped;
+#if defined(ANIMATED_GIF_TELEMETRY_TABLE)
+      loadedTelemetry()->addDropped(dropped);
+#endif
+    }
+  }
+
+  for (uint32_t decoded = 1;; ++decoded)
+  {
+    const bool onTarget = playbackPosition() == target;
+    int delayMs = 0;
+    const int result = decodeNextFrame(&delayMs, now);
+    finishFrame(result, delayMs, now);
+    if (!gifReady)
+    {
+      return;
+    }
+    noteShownFrame();
+    if (onTarget)
+    {
+      return;
+    }
+    ++clockLateFrames;
+#if defined(ANIMATED_GIF_TELEMETRY_TABLE)
+    loadedTelemetry()->addLate(0);
+#endif
+    if (decoded >= ANIMATED_GIF_SYNC_MAX_CATCHUP)
+    {
+      return;
+    }
+  }
+}
+#endif
+
+#if defined(ANIMATED_GIF_USE_SD)
+int presentStagedFrame(int *delayMs)
+{
+  stagedFrameReady = false;
+  writePanel(0, 0, stagingFrame, CANVAS_WIDTH, CANVAS_HEIGHT);
+  *delayMs = stagedDelayMs;
+  return stagedResult;
+}
+
+// Opens `index` (or resumes it from the pool), which also fills the read-ahead
+// window, and decodes its next frame into the staging frame.
+void runPrepareJob(size_t index)
+{
+  const uint32_t start = millis();
+  if (!openGifAtIndex(index))
+  {
+    return;
+  }
+  const uint32_t openMs = millis() - start;
+  if (!stagingFrame)
+  {
+    stagingFrame = static_cast<uint16_t *>(psramAlloc(STAGING_PIXELS * sizeof(uint16_t)));
+  }
+  if (!stagingFrame)
+  {
+    return;
+  }
+  for (size_t i = 0; i < STAGING_PIXELS; ++i)
+  {
+    stagingFrame[i] = panelPixel(ANIMATED_GIF_BACKGROUND);
+  }
+  stagingTarget = stagingFrame;
+  stagedResult = decodeNextFrame(&stagedDelayMs, millis());
+  stagingTarget = nullptr;
+  stagedFrameReady = true;
+  Serial.printf("Animated GIF: prepared %s in %lu ms (open %lu ms)\n", kGifFiles[index],
+                static_cast<unsigned long>(millis() - start), static_cast<unsigned long>(openMs));
+}
+
+#if defined(ANIMATED_GIF_DECODE_AHEAD)
+// Decodes the next frame into the ring (prepare task). The rewind after the
+// last frame happens here too, since the task owns the decoder.
+void decodeAheadFrame()
+{
+  DecodedFrame &frame = decodedFrames[decodeAheadQueued % DECODE_AHEAD_FRAMES];
+  frame.used = 0;
+  frame.overflowed = false;
+  gif->getFramePosition(&frame.start);
+  frame.startFrame = nextFrame;
+  recordTarget = &frame;
+  frame.result = decodeNextFrame(&frame.delayMs, millis());
+  recordTarget = nullptr;
+  if (frame.overflowed)
+  {
+    // The render thread takes the decoder back at this frame.
+    decodeAheadOverflowed = true;
+  }
+  else if (frame.result == 0)
+  {
+    rewindAfterLastFrame();
+  }
+  if (frame.result < 0)
+  {
+    decodeAheadFailed = true;
+  }
+  portENTER_CRITICAL(&prepareLock);
+  ++decodeAheadQueued;
+  portEXIT_CRITICAL(&prepareLock);
+}
+
+void fillDecodeAhead()
+{
+  while (decodeAheadActive && !decodeAheadStop && !decodeAheadFailed && !decodeAheadOverflowed &&
+         decodeAheadQueued - decodeAheadShown < DECODE_AHEAD_FRAMES)
+  {
+    decodeAheadFrame();
+  }
+  if (decodeAheadStop)
+  {
+    decodeAheadActive = false;
+    decodeAheadStop = false;
+  }
+}
+
+void resetDecodeAheadStats(uint32_t now)
+{
+  decodeAheadUnderruns = 0;
+  decodeAheadFrames = 0;
+  decodeAheadFillTotal = 0;
+  decodeAheadMinFill = DECODE_AHEAD_FRAMES;
+  decodeAheadRedecodes = 0;
+  lastDecodeAheadStatsMillis = now;
 }
 
-void GIFCloseFile(void *pHandle)
+void reportDecodeAheadStats(uint32_t now)
 {
-  File *file = static_cast<File *>(pHandle);
-  if (file)
+  if (ANIMATED_GIF_STATS_INTERVAL_MS == 0 || decodeAheadFrames == 0 ||
+      (now - lastDecodeAheadStatsMillis) < static_cast<uint32_t>(ANIMATED_GIF_STATS_INTERVAL_MS))
   {
-    file->close();
+    return;
   }
+  const uint32_t fillTenths = decodeAheadFillTotal * 10 / decodeAheadFrames;
+  Serial.printf("Animated GIF: decode-ahead %s fill avg %lu.%lu/%u, min %lu, %lu underruns, %lu decoded "
+                "again on display (%lu frames)\n",
+                kGifFiles[loadedGifIndex], static_cast<unsigned long>(fillTenths / 10),
+                static_cast<unsigned long>(fillTenths % 10), static_cast<unsigned>(DECODE_AHEAD_FRAMES),
+                static_cast<unsigned long>(decodeAheadMinFill), static_cast<unsigned long>(decodeAheadUnderruns),
+                static_cast<unsigned long>(decodeAheadRedecodes), static_cast<unsigned long>(decodeAheadFrames));
+  resetDecodeAheadStats(now);
 }
 
-int32_t GIFReadFile(GIFFILE *pFile, uint8_t *pBuf, int32_t iLen)
+// Hands the decoder to the prepare task, which fills the ring from the
+// current frame on. Only files read from the card during playback use it.
+void startDecodeAhead()
 {
-  File *file = static_cast<File *>(pFile->fHandle);
-  if (!file)
+  if (decodeAheadActive || decodeAheadUnavailable || !prepareTask || gifPreloaded)
   {
-    return 0;
+    return;
   }
-
-  int32_t bytesToRead = iLen;
-  if ((pFile->iSize - pFile->iPos) < iLen)
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+  if (cachedGif)
   {
-    bytesToRead = pFile->iSize - pFile->iPos;
+    return;
   }
-  if (bytesToRead <= 0)
+#endif
+  if (!decodedFrames[0].data)
   {
-    return 0;
+    bool allocated = true;
+    for (DecodedFrame &frame : decodedFrames)
+    {
+      frame.data = static_cast<uint8_t *>(psramAlloc(DECODED_FRAME_BYTES));
+      allocated = allocated && frame.data;
+    }
+    if (!allocated)
+    {
+      for (DecodedFrame &frame : decodedFrames)
+      {
+        free(frame.data);
+        frame.data = nullptr;
+      }
+      decodeAheadUnavailable = true;
+      Serial.printf("Animated GIF: decode-ahead ring unavailable (%u bytes), decoding on display\n",
+                    static_cast<unsigned>(DECODE_AHEAD_FRAMES * DECODED_FRAME_BYTES));
+      return;
+    }
   }
-
-  const int32_t bytesRead = static_cast<int32_t>(file->read(pBuf, bytesToRead));
-  pFile->iPos += bytesRead;
-  return bytesRead;
+  decodeAheadQueued = 0;
+  decodeAheadShown = 0;
+  decodeAheadFailed = false;
+  decodeAheadOverflowed = false;
+  decodeAheadPrimed = false;
+  decodeAheadStarved = false;
+  if (decodeAheadStatsStale)
+  {
+    decodeAheadStatsStale = false;
+    resetDecodeAheadStats(millis());
+  }
+  decodeAheadActive = true;
+  xTaskNotifyGive(prepareTask);
 }
 
-int32_t GIFSeekFile(GIFFILE *pFile, int32_t iPosition)
+// Takes the decoder back from the prepare task. Queued frames are dropped, so
+// the decoder may be up to DECODE_AHEAD_FRAMES frames past the panel.
+void stopDecodeAhead()
 {
-  if (iPosition < 0)
+  if (!decodeAheadActive)
   {
-    iPosition = 0;
+    return;
   }
-  else if (iPosition >= pFile->iSize)
+  decodeAheadStop = true;
+  while (decodeAheadActive)
   {
-    iPosition = pFile->iSize - 1;
+    xTaskNotifyGive(prepareTask);
+    delay(1);
   }
+#if defined(ANIMATED_GIF_TELEMETRY_TABLE)
+  loadedTelemetry()->addDropped(decodeAheadQueued - decodeAheadShown);
+#endif
+#if ANIMATED_GIF_FRAME_INDEX
+  clockedFrame = SIZE_MAX;
+#endif
+}
 
-  File *file = static_cast<File *>(pFile->fHandle);
-  if (!file)
+// Takes the decoder back at a frame that overflowed its ring slot and decodes
+// it on display; the ring refills from the frame after it on the next loop.
+void redecodeOverflowedFrame(const DecodedFrame &frame, uint32_t now)
+{
+  const GIFFRAMEINFO start = frame.start;
+  const uint16_t startFrame = frame.startFrame;
+  portENTER_CRITICAL(&prepareLock);
+  ++decodeAheadShown;
+  portEXIT_CRITICAL(&prepareLock);
+  stopDecodeAhead();
+  ++decodeAheadRedecodes;
+  nextFrame = startFrame;
+  if (start.iOffset <= 0 || !gif->seekFrame(&start))
   {
-    return 0;
+    gif->reset();
+    nextFrame = 0;
   }
-
-  file->seek(iPosition);
-  pFile->iPos = iPosition;
-  return iPosition;
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+  // A recording already holds the frame once.
+  frameCache.abortRecording();
+#endif
+  int delayMs = 0;
+  const int result = decodeNextFrame(&delayMs, now);
+  finishFrame(result, delayMs, now);
 }
 
-bool openGifAtIndex(size_t index)
+// Shows the oldest frame of the ring once it is due.
+void showDecodedAheadFrame(uint32_t now)
 {
-  gif.close();
-  gifReady = false;
-
-  if (index >= kGifFileCount)
+  if (now - lastFrameMillis < lastFrameDelay)
   {
-    return false;
+    return;
   }
-
-  loadedGifIndex = index;
-  currentGifIndex = index;
-  const char *filename = kGifFiles[index];
-  if (!gif.open(filename, GIFOpenFile, GIFCloseFile, GIFReadFile, GIFSeekFile, GIFDraw))
+  const uint32_t fill = decodeAheadQueued - decodeAheadShown;
+  if (fill == 0)
   {
-    Serial.printf("Animated GIF: failed to open %s\n", filename);
-    return false;
+    if (decodeAheadPrimed && !decodeAheadStarved)
+    {
+      ++decodeAheadUnderruns;
+      decodeAheadStarved = true;
+    }
+    return;
   }
 
-  const int canvasWidth = gif.getCanvasWidth();
-  const int canvasHeight = gif.getCanvasHeight();
-
-  gifSourceWidth = static_cast<uint16_t>(canvasWidth);
-  gifSourceHeight = static_cast<uint16_t>(canvasHeight);
-  const uint8_t targetScale = static_cast<uint8_t>(
-      max((CANVAS_WIDTH + canvasWidth - 1) / canvasWidth, (CANVAS_HEIGHT + canvasHeight - 1) / canvasHeight));
-  gifScale = targetScale < 1 ? 1 : targetScale;
-  gifScaleEnabled = gifScale > 1;
-  const uint16_t scaledWidth = static_cast<uint16_t>(canvasWidth * gifScale);
-  const uint16_t scaledHeight = static_cast<uint16_t>(canvasHeight * gifScale);
-  offsetX = static_cast<int16_t>((static_cast<int32_t>(CANVAS_WIDTH) - static_cast<int32_t>(scaledWidth)) / 2);
-  offsetY = static_cast<int16_t>((static_cast<int32_t>(CANVAS_HEIGHT) - static_cast<int32_t>(scaledHeight)) / 2);
-
-  resetGifTiming();
-  gifReady = true;
-  return true;
-}
+  const DecodedFrame &frame = decodedFrames[decodeAheadShown % DECODE_AHEAD_FRAMES];
+  if (frame.overflowed)
+  {
+    redecodeOverflowedFrame(frame, now);
+    return;
+  }
+  drawPanelWrites(frame);
+  const int result = frame.result;
+  const int delayMs = frame.delayMs;
+  portENTER_CRITICAL(&prepareLock);
+  ++decodeAheadShown;
+  portEXIT_CRITICAL(&prepareLock);
+  xTaskNotifyGive(prepareTask);
 
-bool openNextGif()
-{
-  if (kGifFileCount == 0)
+  decodeAheadPrimed = true;
+  decodeAheadStarved = false;
+  ++decodeAheadFrames;
+  decodeAheadFillTotal += fill;
+  if (fill < decodeAheadMinFill)
   {
-    return false;
+    decodeAheadMinFill = fill;
+  }
+  if (result < 0)
+  {
+    stopDecodeAhead();
+    finishFrame(result, delayMs, now);
+    return;
   }
+  scheduleNextFrame(result, delayMs, now);
+  reportDecodeAheadStats(now);
+}
+#endif
 
-  for (size_t attempt = 0; attempt < kGifFileCount; ++attempt)
+#if defined(ARDUINO_ARCH_ESP32)
+void prepareTaskMain(void *)
+{
+  for (;;)
   {
-    const size_t index = (currentGifIndex + attempt) % kGifFileCount;
-    if (openGifAtIndex(index))
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    for (;;)
     {
-      return true;
+      portENTER_CRITICAL(&prepareLock);
+      const size_t index = prepareRequest;
+      prepareRequest = SIZE_MAX;
+      if (index == SIZE_MAX)
+      {
+        prepareBusy = false;
+      }
+      portEXIT_CRITICAL(&prepareLock);
+      if (index == SIZE_MAX)
+      {
+        break;
+      }
+      runPrepareJob(index);
+      prepareDoneIndex = index;
     }
+#if defined(ANIMATED_GIF_DECODE_AHEAD)
+    fillDecodeAhead();
+#endif
   }
+}
+#endif
 
-  return false;
+// The render thread leaves the player alone while a job runs; calls that need
+// it wait here.
+void waitForPrepareJob()
+{
+  while (prepareBusy)
+  {
+    delay(1);
+  }
 }
 #endif
 } // namespace
 
 void animatedGifSetup()
 {
-  gif.begin(LITTLE_ENDIAN_PIXELS);
-
   gfx->fillScreen(ANIMATED_GIF_BACKGROUND);
+#if defined(ANIMATED_GIF_USE_SD)
+  checkPsramPlan();
+#endif
+#if ANIMATED_GIF_PANEL_DIFF
+  if (!panelDiff.begin(CANVAS_WIDTH, CANVAS_HEIGHT, ANIMATED_GIF_DIFF_MERGE_GAP, ANIMATED_GIF_DIFF_FULL_ROW_PERCENT))
+  {
+    Serial.println("Animated GIF: panel copy unavailable, sending every write");
+  }
+#endif
 
 #if defined(ANIMATED_GIF_USE_SD)
+  spiBusLockBegin();
+  gifPlaylist.load(kGifFiles, kGifFileCount);
+#if ANIMATED_GIF_PRELOAD_MAX_BYTES > 0
+  for (size_t i = 0; i < kGifFileCount; ++i)
+  {
+    const uint32_t size = gifPlaylist.loaded() ? gifPlaylist.entry(i).fileSize : 0;
+    gifTooLargeToPreload[i] = size > ANIMATED_GIF_PRELOAD_MAX_BYTES || size > ANIMATED_GIF_PRELOAD_BUDGET_BYTES;
+  }
+#endif
+#if defined(ARDUINO_ARCH_ESP32) && ANIMATED_GIF_PREPARE_CORE >= 0
+  if (xTaskCreatePinnedToCore(prepareTaskMain, "gifPrepare", ANIMATED_GIF_PREPARE_STACK, nullptr, 1,
+                              &prepareTask, ANIMATED_GIF_PREPARE_CORE) != pdPASS)
+  {
+    prepareTask = nullptr;
+    Serial.println("Animated GIF: prepare task unavailable, switching synchronously");
+  }
+#endif
+  if (!gifReadCache.begin(ANIMATED_GIF_READ_CACHE_BYTES))
+  {
+    Serial.println("Animated GIF: read cache unavailable, reading SD directly");
+  }
+#if defined(ARDUINO_ARCH_ESP32) && ANIMATED_GIF_IO_CORE >= 0
+  else if (!gifReadCache.startIoTask(ANIMATED_GIF_IO_CORE, ANIMATED_GIF_IO_STACK))
+  {
+    Serial.println("Animated GIF: I/O task unavailable, reading synchronously");
+  }
+#endif
+#if defined(ANIMATED_GIF_FRAME_CACHE)
+  frameCache.begin(ANIMATED_GIF_FRAME_CACHE_BYTES);
+#endif
+
   currentGifIndex = 0;
   if (!openNextGif())
   {
@@ -451,28 +2699,18 @@ void animatedGifSetup()
     return;
   }
 #else
+  gif = createDecoder();
   const uint8_t *gifData = reinterpret_cast<const uint8_t *>(kAnimatedGifResource.data);
-  if (!gif.openFLASH(const_cast<uint8_t *>(gifData), static_cast<int>(kAnimatedGifResource.size), GIFDraw))
+  if (!gif ||
+      !gif->openFLASH(const_cast<uint8_t *>(gifData), static_cast<int>(kAnimatedGifResource.size), GIFDraw))
   {
     Serial.println("Animated GIF: failed to open memory resource");
     gifReady = false;
     return;
   }
 
-  const int canvasWidth = gif.getCanvasWidth();
-  const int canvasHeight = gif.getCanvasHeight();
-
-  gifSourceWidth = static_cast<uint16_t>(canvasWidth);
-  gifSourceHeight = static_cast<uint16_t>(canvasHeight);
-  const uint8_t targetScale = static_cast<uint8_t>(
-      max((CANVAS_WIDTH + canvasWidth - 1) / canvasWidth, (CANVAS_HEIGHT + canvasHeight - 1) / canvasHeight));
-  gifScale = targetScale < 1 ? 1 : targetScale;
-  gifScaleEnabled = gifScale > 1;
-  const uint16_t scaledWidth = static_cast<uint16_t>(canvasWidth * gifScale);
-  const uint16_t scaledHeight = static_cast<uint16_t>(canvasHeight * gifScale);
-  offsetX = static_cast<int16_t>((static_cast<int32_t>(CANVAS_WIDTH) - static_cast<int32_t>(scaledWidth)) / 2);
-  offsetY = static_cast<int16_t>((static_cast<int32_t>(CANVAS_HEIGHT) - static_cast<int32_t>(scaledHeight)) / 2);
-
+  applyCanvasLayout();
+  configureDecodeMode(frameBuffer, frameBufferSize);
   resetGifTiming();
   gifReady = true;
 #endif
@@ -480,6 +2718,9 @@ void animatedGifSetup()
 
 void animatedGifLoop()
 {
+#if defined(ANIMATED_GIF_USE_SD)
+  waitForPrepareJob();
+#endif
   if (!gifReady)
   {
     return;
@@ -491,6 +2732,9 @@ void animatedGifLoop()
   if (kGifFileCount > 1 && kGifSwitchIntervalMs > 0 &&
       (now - lastSwitchMillis) >= kGifSwitchIntervalMs)
   {
+#if defined(ANIMATED_GIF_DECODE_AHEAD)
+    stopDecodeAhead();
+#endif
     currentGifIndex = (currentGifIndex + 1) % kGifFileCount;
     if (openNextGif())
     {
@@ -499,38 +2743,78 @@ void animatedGifLoop()
   }
 #endif
 
-  if (now - lastFrameMillis < lastFrameDelay)
+#if ANIMATED_GIF_FRAME_INDEX
+  if (!stagedFrameReady && clockLocked())
   {
+#if defined(ANIMATED_GIF_DECODE_AHEAD)
+    stopDecodeAhead();
+#endif
+    playClockedFrames(now);
     return;
   }
+#endif
 
-  int delayMs = 0;
-  const int result = gif.playFrame(false, &delayMs);
-  if (result < 0)
+#if defined(ANIMATED_GIF_DECODE_AHEAD)
+  if (!stagedFrameReady)
+  {
+    startDecodeAhead();
+    if (decodeAheadActive)
+    {
+      showDecodedAheadFrame(now);
+      return;
+    }
+  }
+#endif
+
+  if (now - lastFrameMillis < lastFrameDelay)
   {
-    Serial.printf("Animated GIF: playback error %d\n", gif.getLastError());
-    gifReady = false;
-    gif.close();
     return;
   }
 
-  if (delayMs <= 0)
+  int delayMs = 0;
+  int result = 0;
+#if defined(ANIMATED_GIF_USE_SD)
+  if (stagedFrameReady)
   {
-    delayMs = ANIMATED_GIF_DEFAULT_DELAY;
+    result = presentStagedFrame(&delayMs);
   }
-  if (delayMs > ANIMATED_GIF_MAX_DELAY)
+  else
+#endif
   {
-    delayMs = ANIMATED_GIF_MAX_DELAY;
+    result = decodeNextFrame(&delayMs, now);
   }
+  finishFrame(result, delayMs, now);
+#if defined(ANIMATED_GIF_USE_SD) && ANIMATED_GIF_FRAME_INDEX
+  if (gifReady && frameIndexes[loadedGifIndex].valid())
+  {
+    noteShownFrame();
+  }
+#endif
+}
 
-  lastFrameDelay = static_cast<uint16_t>(delayMs);
-  lastFrameMillis = now;
-
-  if (result == 0)
+const char *animatedGifFirstPlayableFile()
+{
+#if defined(ANIMATED_GIF_USE_SD)
+  gifPlaylist.load(kGifFiles, kGifFileCount);
+  for (size_t i = 0; gifPlaylist.loaded() && i < kGifFileCount; ++i)
   {
-    gif.reset();
-    lastFrameDelay = 0;
+    if (!gifPlaylist.missing(i))
+    {
+      return kGifFiles[i];
+    }
   }
+#endif
+  return nullptr;
+}
+
+bool animatedGifIsMissing(size_t index)
+{
+#if defined(ANIMATED_GIF_USE_SD)
+  return gifPlaylist.missing(index);
+#else
+  (void)index;
+  return false;
+#endif
 }
 
 size_t animatedGifFileCount()
@@ -544,10 +2828,30 @@ size_t animatedGifFileCount()
 
 bool animatedGifOpenAtIndex(size_t index)
 {
+#if defined(ANIMATED_GIF_USE_SD)
+#if defined(ANIMATED_GIF_DECODE_AHEAD)
+  stopDecodeAhead();
+#endif
+  waitForPrepareJob();
+#endif
+  // Callers draw on the panel before (re)entering the player, unless they
+  // put this program's snapshot there.
+#if defined(ANIMATED_GIF_SNAPSHOTS)
+  captureSnapshot();
+  const bool snapshotShown = snapshotOnPanel == index;
+  snapshotOnPanel = SIZE_MAX;
+  if (!snapshotShown)
+  {
+    panelDiff.invalidate();
+  }
+#else
+  panelDiff.invalidate();
+#endif
 #if defined(ANIMATED_GIF_USE_SD)
   if (gifReady && index == loadedGifIndex)
   {
-    gif.reset();
+    // Already current (e.g. prepared ahead of a transition): keep playing from
+    // where it is, like a resume from the decoder pool.
     resetGifTiming();
     return true;
   }
@@ -558,7 +2862,8 @@ bool animatedGifOpenAtIndex(size_t index)
     return false;
   }
 
-  gif.reset();
+  gif->reset();
+  cookedCanvasTrusted = false;
   resetGifTiming();
   return true;
 #endif
@@ -569,4 +2874,153 @@ bool animatedGifIsReady()
   return gifReady;
 }
 
+void animatedGifSuspend()
+{
+#if defined(ANIMATED_GIF_USE_SD)
+#if defined(ANIMATED_GIF_DECODE_AHEAD)
+  stopDecodeAhead();
+#endif
+  waitForPrepareJob();
+#endif
+}
+
+void animatedGifReleaseSnapshots()
+{
+#if defined(ANIMATED_GIF_SNAPSHOTS)
+  releaseSnapshots();
+#endif
+}
+
+void animatedGifInvalidatePanel()
+{
+#if defined(ANIMATED_GIF_SNAPSHOTS)
+  captureSnapshot();
+  snapshotOnPanel = SIZE_MAX;
+#endif
+  panelDiff.invalidate();
+}
+
+bool animatedGifShowSnapshot(size_t index)
+{
+#if defined(ANIMATED_GIF_SNAPSHOTS)
+  captureSnapshot();
+  GifSnapshot *snapshot = findSnapshot(index);
+  if (!snapshot)
+  {
+    return false;
+  }
+  const uint32_t start = micros();
+  snapshot->lastUsed = ++snapshotClock;
+  panelDiff.invalidate();
+  blitToPanel(0, 0, snapshot->pixels, CANVAS_WIDTH, CANVAS_HEIGHT);
+  // Already kept; nothing to capture until the player draws again.
+  panelProgram = SIZE_MAX;
+  snapshotOnPanel = index;
+  Serial.printf("Animated GIF: snapshot of %s on the panel in %lu us\n", kGifFiles[index],
+                static_cast<unsigned long>(micros() - start));
+  return true;
+#else
+  (void)index;
+  return false;
+#endif
+}
+
+void animatedGifDumpTelemetry(bool reset)
+{
+#if defined(ANIMATED_GIF_TELEMETRY_TABLE)
+  // The prepare task may be counting a frame meanwhile; that frame can land
+  // on either side of a reset.
+  const uint32_t now = millis();
+  Serial.printf("Animated GIF: telemetry over %lu s\n",
+                static_cast<unsigned long>((now - telemetryStartMillis) / 1000));
+  for (size_t i = 0; i < kGifFileCount; ++i)
+  {
+    const GifTelemetry &t = telemetry[i];
+    if (t.frames() == 0 && t.decodes() == 0)
+    {
+      continue;
+    }
+    const uint32_t decodes = t.decodes() ? t.decodes() : 1;
+    const uint32_t frames = t.frames() ? t.frames() : 1;
+    const uint32_t timed = t.timedFrames() ? t.timedFrames() : 1;
+    Serial.printf("Animated GIF: %s %lu shown, %lu decoded: decode avg %lu us, max %lu us, read %lu us/frame "
+                  "(%lu bytes, %lu calls), blit %lu us/frame (%lu writes)\n",
+                  kGifFiles[i], static_cast<unsigned long>(t.frames()), static_cast<unsigned long>(t.decodes()),
+                  static_cast<unsigned long>(t.decodeMicros() / decodes),
+                  static_cast<unsigned long>(t.decodeMaxMicros()),
+                  static_cast<unsigned long>(t.readMicros() / decodes),
+                  static_cast<unsigned long>(t.readBytes() / decodes),
+                  static_cast<unsigned long>(t.readCalls() / decodes),
+                  static_cast<unsigned long>(t.blitMicros() / frames),
+                  static_cast<unsigned long>(t.blitWrites() / frames));
+    Serial.printf("Animated GIF: %s delay avg %lu ms for %lu requested, %lu late (max %lu ms over), "
+                  "%lu dropped\n",
+                  kGifFiles[i], static_cast<unsigned long>(t.achievedMs() / timed),
+                  static_cast<unsigned long>(t.requestedMs() / timed), static_cast<unsigned long>(t.lateFrames()),
+                  static_cast<unsigned long>(t.maxLateMs()), static_cast<unsigned long>(t.droppedFrames()));
+  }
+  if (reset)
+  {
+    for (GifTelemetry &t : telemetry)
+    {
+      t.reset();
+    }
+    telemetryStartMillis = now;
+  }
+#else
+  (void)reset;
+  Serial.println("Animated GIF: telemetry is off");
+#endif
+}
+
+void animatedGifSyncTimebase(uint32_t timebaseMs, uint32_t localMs)
+{
+#if defined(ANIMATED_GIF_USE_SD) && ANIMATED_GIF_FRAME_INDEX
+  TimebaseLock lock;
+  gifTimebase.sync(timebaseMs, localMs);
+#else
+  (void)timebaseMs;
+  (void)localMs;
+#endif
+}
+
+void animatedGifPrepareAsync(size_t index)
+{
+#if defined(ANIMATED_GIF_USE_SD)
+  if (index >= kGifFileCount)
+  {
+    return;
+  }
+#if defined(ANIMATED_GIF_DECODE_AHEAD)
+  stopDecodeAhead();
+#endif
+#if defined(ARDUINO_ARCH_ESP32)
+  if (prepareTask)
+  {
+    // A newer request replaces one that has not started yet.
+    portENTER_CRITICAL(&prepareLock);
+    prepareRequest = index;
+    prepareBusy = true;
+    portEXIT_CRITICAL(&prepareLock);
+    xTaskNotifyGive(prepareTask);
+    return;
+  }
+#endif
+  runPrepareJob(index);
+  prepareDoneIndex = index;
+#else
+  (void)index;
+#endif
+}
+
+bool animatedGifPrepareReady(size_t index)
+{
+#if defined(ANIMATED_GIF_USE_SD)
+  return !prepareBusy && prepareDoneIndex == index;
+#else
+  (void)index;
+  return true;
+#endif
+}
+
 #endif // ENABLE_ANIMATED_GIF
@@ -0,0 +1,346 @@
+#include "fat_extent.h"
+
+#include <string.h>
+
+namespace
+{
+constexpr size_t DIR_ENTRY_SIZE = 32;
+constexpr uint8_t ATTR_VOLUME_ID = 0x08;
+constexpr uint8_t ATTR_DIRECTORY = 0x10;
+constexpr uint8_t ATTR_LONG_NAME = 0x0F;
+constexpr uint8_t LAST_LONG_ENTRY = 0x40;
+constexpr size_t LONG_ENTRY_CHARS = 13;
+// Byte offsets of the 13 UCS-2 characters in a long-name entry.
+constexpr uint8_t LONG_CHAR_OFFSETS[LONG_ENTRY_CHARS] = {1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30};
+constexpr size_t MAX_LONG_ENTRIES = 20;
+constexpr uint32_t FAT16_MIN_CLUSTERS = 4085;
+constexpr uint32_t FAT32_MIN_CLUSTERS = 65525;
+
+uint16_t le16(const uint8_t *p)
+{
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t le32(const uint8_t *p)
+{
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+bool looksLikeBootSector(const uint8_t *sector)
+{
+  const uint8_t sectorsPerCluster = sector[13];
+  return (sector[0] == 0xEB || sector[0] == 0xE9) && le16(sector + 11) == FatVolume::SECTOR_SIZE &&
+         sectorsPerCluster != 0 && (sectorsPerCluster & (sectorsPerCluster - 1)) == 0 && le16(sector + 14) != 0 &&
+         (sector[16] == 1 || sector[16] == 2) && le16(sector + 510) == 0xAA55;
+}
+
+bool isFatPartition(uint8_t type)
+{
+  return type == 0x01 || type == 0x04 || type == 0x06 || type == 0x0B || type == 0x0C || type == 0x0E;
+}
+
+char foldCase(char c)
+{
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool namesEqual(const char *a, size_t aLength, const char *b, size_t bLength)
+{
+  if (aLength != bLength)
+  {
+    return false;
+  }
+  for (size_t i = 0; i < aLength; ++i)
+  {
+    if (foldCase(a[i]) != foldCase(b[i]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint8_t shortNameChecksum(const uint8_t *name)
+{
+  uint8_t sum = 0;
+  for (size_t i = 0; i < 11; ++i)
+  {
+    sum = static_cast<uint8_t>(((sum & 1) << 7) + (sum >> 1) + name[i]);
+  }
+  return sum;
+}
+
+// "NAME    EXT" as "NAME.EXT".
+size_t shortName(const uint8_t *entry, char *name)
+{
+  size_t length = 0;
+  for (size_t i = 0; i < 8 && entry[i] != ' '; ++i)
+  {
+    name[length++] = static_cast<char>(i == 0 && entry[0] == 0x05 ? 0xE5 : entry[i]);
+  }
+  if (entry[8] != ' ')
+  {
+    name[length++] = '.';
+    for (size_t i = 8; i < 11 && entry[i] != ' '; ++i)
+    {
+      name[length++] = static_cast<char>(entry[i]);
+    }
+  }
+  return length;
+}
+
+// Long name being collected from the entries in front of a short entry,
+// which come last part first. Characters outside ASCII never match a path.
+struct LongName
+{
+  char text[MAX_LONG_ENTRIES * LONG_ENTRY_CHARS];
+  size_t length;
+  uint8_t nextOrder;
+  uint8_t checksum;
+  bool valid;
+
+  void add(const uint8_t *entry)
+  {
+    const uint8_t order = entry[0] & 0x1F;
+    if (entry[0] & LAST_LONG_ENTRY)
+    {
+      valid = order >= 1 && order <= MAX_LONG_ENTRIES;
+      length = static_cast<size_t>(order) * LONG_ENTRY_CHARS;
+      checksum = entry[13];
+    }
+    else if (!valid || order != nextOrder || entry[13] != checksum)
+    {
+      valid = false;
+    }
+    if (!valid)
+    {
+      return;
+    }
+    nextOrder = static_cast<uint8_t>(order - 1);
+    const size_t base = static_cast<size_t>(order - 1) * LONG_ENTRY_CHARS;
+    for (size_t i = 0; i < LONG_ENTRY_CHARS; ++i)
+    {
+      const uint16_t c = le16(entry + LONG_CHAR_OFFSETS[i]);
+      if (c == 0x0000 && base + i < length)
+      {
+        length = base + i;
+      }
+      text[base + i] = c < 0x80 ? static_cast<char>(c) : '\x01';
+    }
+  }
+
+  bool matches(const uint8_t *shortEntry, const char *name, size_t nameLength) const
+  {
+    return valid && nextOrder == 0 && shortNameChecksum(shortEntry) == checksum &&
+           namesEqual(text, length, name, nameLength);
+  }
+};
+} // namespace
+
+bool FatVolume::readSector(uint32_t sector)
+{
+  if (sector == bufferedSector_)
+  {
+    return true;
+  }
+  bufferedSector_ = UINT32_MAX;
+  if (!reader_(context_, sector, sector_, 1))
+  {
+    return false;
+  }
+  bufferedSector_ = sector;
+  return true;
+}
+
+bool FatVolume::mount(SectorReader reader, void *context)
+{
+  reader_ = reader;
+  context_ = context;
+  bufferedSector_ = UINT32_MAX;
+
+  uint32_t volumeStart = 0;
+  bool ok = readSector(0);
+  if (ok && !looksLikeBootSector(sector_))
+  {
+    // Partitioned card: the volume is the first FAT partition in the MBR.
+    ok = le16(sector_ + 510) == 0xAA55;
+    for (size_t i = 0; ok && i < 4; ++i)
+    {
+      const uint8_t *partition = sector_ + 446 + 16 * i;
+      if (isFatPartition(partition[4]))
+      {
+        volumeStart = le32(partition + 8);
+        break;
+      }
+    }
+    ok = ok && volumeStart != 0 && readSector(volumeStart) && looksLikeBootSector(sector_);
+  }
+  if (!ok)
+  {
+    reader_ = nullptr;
+    return false;
+  }
+
+  const uint8_t *boot = sector_;
+  sectorsPerCluster_ = boot[13];
+  const uint32_t reservedSectors = le16(boot + 14);
+  const uint32_t fatCount = boot[16];
+  const uint32_t rootEntries = le16(boot + 17);
+  const uint32_t totalSectors = le16(boot + 19) ? le16(boot + 19) : le32(boot + 32);
+  const uint32_t fatSectors = le16(boot + 22) ? le16(boot + 22) : le32(boot + 36);
+  rootSectors_ = (rootEntries * DIR_ENTRY_SIZE + SECTOR_SIZE - 1) / SECTOR_SIZE;
+  const uint32_t overhead = reservedSectors + fatCount * fatSectors + rootSectors_;
+  fatStart_ = volumeStart + reservedSectors;
+  rootStart_ = fatStart_ + fatCount * fatSectors;
+  dataStart_ = rootStart_ + rootSectors_;
+  clusterCount_ = totalSectors > overhead ? (totalSectors - overhead) / sectorsPerCluster_ : 0;
+  fat32_ = clusterCount_ >= FAT32_MIN_CLUSTERS;
+  rootCluster_ = fat32_ ? le32(boot + 44) : 0;
+  // FAT12 is left to the FAT layer; FAT32 has no fixed root directory.
+  if (fatSectors == 0 || clusterCount_ < FAT16_MIN_CLUSTERS || fat32_ != (rootEntries == 0))
+  {
+    reader_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
+bool FatVolume::nextCluster(uint32_t cluster, uint32_t *next)
+{
+  if (cluster < 2 || cluster >= clusterCount_ + 2)
+  {
+    return false;
+  }
+  const uint32_t offset = cluster * (fat32_ ? 4 : 2);
+  if (!readSector(fatStart_ + offset / SECTOR_SIZE))
+  {
+    return false;
+  }
+  const uint8_t *value = sector_ + offset % SECTOR_SIZE;
+  *next = fat32_ ? (le32(value) & 0x0FFFFFFFUL) : le16(value);
+  return true;
+}
+
+bool FatVolume::findEntry(uint32_t cluster, const char *name, size_t nameLength, DirEntry *entry)
+{
+  LongName longName = {};
+  char nameBuffer[13];
+  uint32_t sector = cluster == 0 ? rootStart_ : clusterSector(cluster);
+  uint32_t remaining = cluster == 0 ? rootSectors_ : sectorsPerCluster_;
+  // A directory cannot have more clusters than the volume; this stops a
+  // looped chain on a damaged card.
+  uint32_t clustersLeft = clusterCount_;
+  for (;;)
+  {
+    if (remaining == 0)
+    {
+      if (cluster == 0 || clustersLeft-- == 0 || !nextCluster(cluster, &cluster) || cluster < 2 ||
+          cluster >= clusterCount_ + 2)
+      {
+        return false;
+      }
+      sector = clusterSector(cluster);
+      remaining = sectorsPerCluster_;
+    }
+    if (!readSector(sector))
+    {
+      return false;
+    }
+    for (size_t offset = 0; offset < SECTOR_SIZE; offset += DIR_ENTRY_SIZE)
+    {
+      const uint8_t *raw = sector_ + offset;
+      if (raw[0] == 0x00)
+      {
+        return false;
+      }
+      const uint8_t attributes = raw[11];
+      if (raw[0] == 0xE5)
+      {
+        longName.valid = false;
+        continue;
+      }
+      if ((attributes & 0x3F) == ATTR_LONG_NAME)
+      {
+        longName.add(raw);
+        continue;
+      }
+      const bool matched =
+          !(attributes & ATTR_VOLUME_ID) &&
+          (longName.matches(raw, name, nameLength) ||
+           namesEqual(nameBuffer, shortName(raw, nameBuffer), name, nameLength));
+      longName.valid = false;
+      if (matched)
+      {
+        entry->firstCluster = (static_cast<uint32_t>(le16(raw + 20)) << 16) | le16(raw + 26);
+        entry->size = le32(raw + 28);
+        entry->directory = (attributes & ATTR_DIRECTORY) != 0;
+        return true;
+      }
+    }
+    ++sector;
+    --remaining;
+  }
+}
+
+FatFileLayout FatVolume::locate(const char *path, FatExtent *extent)
+{
+  if (!reader_)
+  {
+    return FatFileLayout::Missing;
+  }
+  DirEntry entry = {rootCluster_, 0, true};
+  const char *name = path;
+  for (;;)
+  {
+    while (*name == '/')
+    {
+      ++name;
+    }
+    if (*name == '\0')
+    {
+      break;
+    }
+    const char *end = name;
+    while (*end != '\0' && *end != '/')
+    {
+      ++end;
+    }
+    // ".." entries point at cluster 0 for the root.
+    const uint32_t directory = entry.firstCluster == 0 ? rootCluster_ : entry.firstCluster;
+    if (!entry.directory || !findEntry(directory, name, static_cast<size_t>(end - name), &entry))
+    {
+      return FatFileLayout::Missing;
+    }
+    name = end;
+  }
+  if (entry.directory)
+  {
+    return FatFileLayout::Missing;
+  }
+  if (entry.size == 0 || entry.firstCluster < 2)
+  {
+    return FatFileLayout::Fragmented;
+  }
+
+  const uint32_t clusterBytes = sectorsPerCluster_ * SECTOR_SIZE;
+  const uint32_t clusters = (entry.size - 1) / clusterBytes + 1;
+  if (entry.firstCluster + clusters > clusterCount_ + 2)
+  {
+    return FatFileLayout::Fragmented;
+  }
+  uint32_t cluster = entry.firstCluster;
+  for (uint32_t i = 1; i < clusters; ++i)
+  {
+    uint32_t next = 0;
+    if (!nextCluster(cluster, &next) || next != cluster + 1)
+    {
+      return FatFileLayout::Fragmented;
+    }
+    cluster = next;
+  }
+  extent->firstSector = clusterSector(entry.firstCluster);
+  extent->sectorCount = (entry.size - 1) / SECTOR_SIZE + 1;
+  extent->fileSize = entry.size;
+  return FatFileLayout::Contiguous;
+}
@@ -0,0 +1,277 @@
+#include "gif_frame_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "psram_alloc.h"
+
+namespace
+{
+constexpr size_t COLOR_COUNT = 65536;
+} // namespace
+
+void GifFrameCache::begin(size_t budgetBytes)
+{
+  budget_ = budgetBytes;
+}
+
+const GifFrameCacheEntry *GifFrameCache::find(size_t fileIndex)
+{
+  for (GifFrameCacheEntry &entry : entries_)
+  {
+    if (entry.complete && entry.fileIndex == fileIndex)
+    {
+      entry.lastUsed = ++clock_;
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+void GifFrameCache::release(GifFrameCacheEntry &entry)
+{
+  for (uint16_t i = 0; i < entry.frameCount; ++i)
+  {
+    free(entry.frames[i].pixels);
+  }
+  free(entry.frames);
+  bytes_ -= entry.bytes;
+  entry = {};
+}
+
+bool GifFrameCache::evictLeastRecentlyUsed()
+{
+  GifFrameCacheEntry *oldest = nullptr;
+  for (GifFrameCacheEntry &entry : entries_)
+  {
+    if (entry.complete && (!oldest || entry.lastUsed < oldest->lastUsed))
+    {
+      oldest = &entry;
+    }
+  }
+  if (!oldest)
+  {
+    return false;
+  }
+  release(*oldest);
+  return true;
+}
+
+bool GifFrameCache::reserve(size_t bytes)
+{
+  while (bytes_ + bytes > budget_)
+  {
+    if (!evictLeastRecentlyUsed())
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+void GifFrameCache::freeRecordingBuffers()
+{
+  free(canvas_);
+  free(colorIndex_);
+  free(colorSeen_);
+  canvas_ = nullptr;
+  colorIndex_ = nullptr;
+  colorSeen_ = nullptr;
+}
+
+bool GifFrameCache::startRecording(size_t fileIndex, uint16_t width, uint16_t height, uint16_t background)
+{
+  abortRecording();
+  const size_t pixels = static_cast<size_t>(width) * height;
+  if (pixels == 0 || pixels > budget_)
+  {
+    return false;
+  }
+
+  GifFrameCacheEntry *slot = nullptr;
+  for (GifFrameCacheEntry &entry : entries_)
+  {
+    if (!entry.complete)
+    {
+      slot = &entry;
+      break;
+    }
+  }
+  if (!slot)
+  {
+    evictLeastRecentlyUsed();
+    return startRecording(fileIndex, width, height, background);
+  }
+
+  canvas_ = static_cast<uint16_t *>(psramAlloc(pixels * sizeof(uint16_t)));
+  colorIndex_ = static_cast<uint8_t *>(psramAlloc(COLOR_COUNT));
+  colorSeen_ = static_cast<uint8_t *>(psramAlloc(COLOR_COUNT / 8));
+  if (!canvas_ || !colorIndex_ || !colorSeen_)
+  {
+    freeRecordingBuffers();
+    return false;
+  }
+  for (size_t i = 0; i < pixels; ++i)
+  {
+    canvas_[i] = background;
+  }
+  memset(colorSeen_, 0, COLOR_COUNT / 8);
+
+  *slot = {};
+  slot->fileIndex = fileIndex;
+  slot->width = width;
+  slot->height = height;
+  slot->indexed = true;
+  recording_ = slot;
+  return true;
+}
+
+void GifFrameCache::abortRecording()
+{
+  if (recording_)
+  {
+    release(*recording_);
+    recording_ = nullptr;
+  }
+  freeRecordingBuffers();
+}
+
+// Maps the canvas onto the recording's palette; false once it would need more
+// than 256 colours.
+bool GifFrameCache::indexCanvas(uint8_t *dest)
+{
+  GifFrameCacheEntry &entry = *recording_;
+  const size_t pixels = static_cast<size_t>(entry.width) * entry.height;
+  for (size_t i = 0; i < pixels; ++i)
+  {
+    const uint16_t color = canvas_[i];
+    const uint8_t bit = static_cast<uint8_t>(1u << (color & 7));
+    uint8_t &seen = colorSeen_[color >> 3];
+    if (!(seen & bit))
+    {
+      if (entry.paletteSize == 256)
+      {
+        return false;
+      }
+      seen |= bit;
+      colorIndex_[color] = static_cast<uint8_t>(entry.paletteSize);
+      entry.palette[entry.paletteSize++] = color;
+    }
+    dest[i] = colorIndex_[color];
+  }
+  return true;
+}
+
+// Expands the frames recorded so far to RGB565 once the palette overflows.
+bool GifFrameCache::convertToRgb565()
+{
+  GifFrameCacheEntry &entry = *recording_;
+  const size_t pixels = static_cast<size_t>(entry.width) * entry.height;
+  if (!reserve(pixels * entry.frameCount))
+  {
+    return false;
+  }
+  for (uint16_t f = 0; f < entry.frameCount; ++f)
+  {
+    uint16_t *expanded = static_cast<uint16_t *>(psramAlloc(pixels * sizeof(uint16_t)));
+    if (!expanded)
+    {
+      return false;
+    }
+    const uint8_t *indices = entry.frames[f].pixels;
+    for (size_t i = 0; i < pixels; ++i)
+    {
+      expanded[i] = entry.palette[indices[i]];
+    }
+    free(entry.frames[f].pixels);
+    entry.frames[f].pixels = reinterpret_cast<uint8_t *>(expanded);
+    entry.bytes += pixels;
+    bytes_ += pixels;
+  }
+  entry.indexed = false;
+  free(colorIndex_);
+  free(colorSeen_);
+  colorIndex_ = nullptr;
+  colorSeen_ = nullptr;
+  return true;
+}
+
+bool GifFrameCache::commitFrame(uint16_t delayMs, uint32_t decodeMicros)
+{
+  if (!recording_)
+  {
+    return false;
+  }
+  GifFrameCacheEntry &entry = *recording_;
+  const size_t pixels = static_cast<size_t>(entry.width) * entry.height;
+
+  if (entry.frameCount == entry.frameCapacity)
+  {
+    const uint16_t capacity = static_cast<uint16_t>(entry.frameCapacity ? entry.frameCapacity * 2 : 16);
+    GifCachedFrame *frames =
+        static_cast<GifCachedFrame *>(realloc(entry.frames, capacity * sizeof(GifCachedFrame)));
+    if (!frames)
+    {
+      abortRecording();
+      return false;
+    }
+    entry.frames = frames;
+    entry.frameCapacity = capacity;
+  }
+
+  size_t frameBytes = entry.indexed ? pixels : pixels * sizeof(uint16_t);
+  uint8_t *data = reserve(frameBytes) ? static_cast<uint8_t *>(psramAlloc(frameBytes)) : nullptr;
+  if (!data)
+  {
+    abortRecording();
+    return false;
+  }
+
+  if (entry.indexed && !indexCanvas(data))
+  {
+    free(data);
+    if (!convertToRgb565())
+    {
+      abortRecording();
+      return false;
+    }
+    frameBytes = pixels * sizeof(uint16_t);
+    data = reserve(frameBytes) ? static_cast<uint8_t *>(psramAlloc(frameBytes)) : nullptr;
+    if (!data)
+    {
+      abortRecording();
+      return false;
+    }
+  }
+  if (!entry.indexed)
+  {
+    memcpy(data, canvas_, frameBytes);
+  }
+
+  GifCachedFrame &frame = entry.frames[entry.frameCount++];
+  frame.pixels = data;
+  frame.delayMs = delayMs;
+  frame.decodeMicros = decodeMicros;
+  entry.bytes += frameBytes;
+  bytes_ += frameBytes;
+  return true;
+}
+
+const GifFrameCacheEntry *GifFrameCache::finishRecording()
+{
+  GifFrameCacheEntry *entry = recording_;
+  if (!entry)
+  {
+    return nullptr;
+  }
+  recording_ = nullptr;
+  freeRecordingBuffers();
+  if (entry->frameCount == 0)
+  {
+    release(*entry);
+    return nullptr;
+  }
+  entry->complete = true;
+  entry->lastUsed = ++clock_;
+  return entry;
+}
@@ -0,0 +1,263 @@
+#include "gif_frame_index.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "psram_alloc.h"
+
+// Host builds (tools/gif_clock_check.cpp) get the frame timing without the
+// card sidecar.
+#if defined(ARDUINO)
+#include <Arduino.h>
+#include <SD.h>
+
+#include "spi_bus_lock.h"
+
+namespace
+{
+constexpr uint32_t INDEX_MAGIC = 0x58444947; // "GIDX"
+// 2: frames repeating the one before may carry GIF_FRAME_DUPLICATE (the
+// player finds them while playing; a scan no longer sets it).
+constexpr uint16_t INDEX_VERSION = 2;
+constexpr size_t MAX_PATH = 64;
+
+// Sidecar layout: this header, then frameCount GIFFRAMEINFO records. The GIF's
+// size and canvas are checked on load so a replaced file is indexed again.
+struct GifIndexHeader
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t frameCount;
+  uint32_t fileSize;
+  uint16_t canvasWidth;
+  uint16_t canvasHeight;
+};
+
+bool sidecarPath(const char *gifPath, char *path)
+{
+  const int length = snprintf(path, MAX_PATH, "%s.idx", gifPath);
+  return length > 0 && static_cast<size_t>(length) < MAX_PATH;
+}
+} // namespace
+#endif
+
+void GifFrameIndex::clear()
+{
+  free(frames_);
+  free(startMs_);
+  frames_ = nullptr;
+  startMs_ = nullptr;
+  frameCount_ = 0;
+  durationMs_ = 0;
+}
+
+bool GifFrameIndex::allocate(uint16_t frameCount)
+{
+  clear();
+  if (frameCount == 0)
+  {
+    return false;
+  }
+  frames_ = static_cast<GIFFRAMEINFO *>(psramAlloc(frameCount * sizeof(GIFFRAMEINFO)));
+  startMs_ = static_cast<uint32_t *>(psramAlloc(frameCount * sizeof(uint32_t)));
+  if (!frames_ || !startMs_)
+  {
+    clear();
+    return false;
+  }
+  frameCount_ = frameCount;
+  return true;
+}
+
+void GifFrameIndex::computeStartTimes()
+{
+  uint32_t elapsed = 0;
+  for (uint16_t i = 0; i < frameCount_; ++i)
+  {
+    startMs_[i] = elapsed;
+    uint16_t delayMs = frames_[i].iDelay;
+    if (delayMs == 0)
+    {
+      delayMs = defaultDelayMs_;
+    }
+    if (maxDelayMs_ > 0 && delayMs > maxDelayMs_)
+    {
+      delayMs = maxDelayMs_;
+    }
+    elapsed += delayMs;
+  }
+  durationMs_ = elapsed;
+}
+
+void GifFrameIndex::setPlaybackDelays(uint16_t defaultMs, uint16_t maxMs)
+{
+  defaultDelayMs_ = defaultMs;
+  maxDelayMs_ = maxMs;
+  if (frames_)
+  {
+    computeStartTimes();
+  }
+}
+
+bool GifFrameIndex::assign(const GIFFRAMEINFO *frames, uint16_t frameCount)
+{
+  if (!allocate(frameCount))
+  {
+    return false;
+  }
+  memcpy(frames_, frames, static_cast<size_t>(frameCount) * sizeof(GIFFRAMEINFO));
+  computeStartTimes();
+  return true;
+}
+
+#if defined(ARDUINO)
+bool GifFrameIndex::load(const char *path, uint32_t fileSize, uint16_t canvasWidth, uint16_t canvasHeight)
+{
+  SpiBusGuard bus;
+  if (!SD.exists(path))
+  {
+    return false;
+  }
+  File file = SD.open(path, FILE_READ);
+  if (!file)
+  {
+    return false;
+  }
+  GifIndexHeader header = {};
+  bool ok = file.read(reinterpret_cast<uint8_t *>(&header), sizeof(header)) == sizeof(header) &&
+            header.magic == INDEX_MAGIC && header.version == INDEX_VERSION && header.fileSize == fileSize &&
+            header.canvasWidth == canvasWidth && header.canvasHeight == canvasHeight &&
+            allocate(header.frameCount);
+  if (ok)
+  {
+    const size_t bytes = static_cast<size_t>(frameCount_) * sizeof(GIFFRAMEINFO);
+    ok = static_cast<size_t>(file.read(reinterpret_cast<uint8_t *>(frames_), bytes)) == bytes;
+  }
+  file.close();
+  if (!ok)
+  {
+    clear();
+  }
+  return ok;
+}
+
+bool GifFrameIndex::save(const char *path, uint32_t fileSize, uint16_t canvasWidth, uint16_t canvasHeight) const
+{
+  SpiBusGuard bus;
+  File file = SD.open(path, FILE_WRITE);
+  if (!file)
+  {
+    return false;
+  }
+  const GifIndexHeader header = {INDEX_MAGIC, INDEX_VERSION, frameCount_, fileSize, canvasWidth, canvasHeight};
+  const size_t bytes = static_cast<size_t>(frameCount_) * sizeof(GIFFRAMEINFO);
+  const bool ok = file.write(reinterpret_cast<const uint8_t *>(&header), sizeof(header)) == sizeof(header) &&
+                  file.write(reinterpret_cast<const uint8_t *>(frames_), bytes) == bytes;
+  file.close();
+  if (!ok)
+  {
+    SD.remove(path);
+  }
+  return ok;
+}
+
+bool GifFrameIndex::loadOrBuild(AnimatedGIF &gif, const char *gifPath, uint32_t fileSize)
+{
+  char path[MAX_PATH];
+  if (!sidecarPath(gifPath, path))
+  {
+    return false;
+  }
+  const uint16_t canvasWidth = static_cast<uint16_t>(gif.getCanvasWidth());
+  const uint16_t canvasHeight = static_cast<uint16_t>(gif.getCanvasHeight());
+  if (load(path, fileSize, canvasWidth, canvasHeight))
+  {
+    computeStartTimes();
+    return true;
+  }
+
+  const uint32_t start = millis();
+  const int frameCount = gif.getFrameIndex(nullptr, 0);
+  if (frameCount <= 0 || frameCount > UINT16_MAX || !allocate(static_cast<uint16_t>(frameCount)))
+  {
+    return false;
+  }
+  gif.getFrameIndex(frames_, frameCount);
+  computeStartTimes();
+  const bool saved = save(path, fileSize, canvasWidth, canvasHeight);
+  Serial.printf("Animated GIF: indexed %u frames of %s in %lu ms%s\n", static_cast<unsigned>(frameCount_), gifPath,
+                static_cast<unsigned long>(millis() - start), saved ? "" : " (sidecar not written)");
+  return true;
+}
+#endif
+
+size_t GifFrameIndex::keyframeAtOrBefore(size_t index) const
+{
+  if (frameCount_ == 0)
+  {
+    return 0;
+  }
+  if (index >= frameCount_)
+  {
+    index = frameCount_ - 1;
+  }
+  while (index > 0 && !(frames_[index].ucFlags & GIF_FRAME_KEY))
+  {
+    --index;
+  }
+  return index;
+}
+
+void GifFrameIndex::markDuplicate(size_t index)
+{
+  if (index == 0 || index >= frameCount_)
+  {
+    return;
+  }
+  const GIFFRAMEINFO &previous = frames_[index - 1];
+  GIFFRAMEINFO &frame = frames_[index];
+  if (frame.ucGIFBits == previous.ucGIFBits && frame.ucTransparent == previous.ucTransparent)
+  {
+    frame.ucFlags |= GIF_FRAME_DUPLICATE;
+  }
+}
+
+size_t GifFrameIndex::shownFrame(size_t index) const
+{
+  while (index > 0 && index < frameCount_ && duplicate(index))
+  {
+    --index;
+  }
+  return index;
+}
+
+uint32_t GifFrameIndex::playbackDelayMs(size_t index) const
+{
+  const uint32_t end = index + 1 < frameCount_ ? startMs_[index + 1] : durationMs_;
+  return end - startMs_[index];
+}
+
+size_t GifFrameIndex::frameAtTime(uint32_t elapsedMs) const
+{
+  if (frameCount_ == 0 || durationMs_ == 0)
+  {
+    return 0;
+  }
+  elapsedMs %= durationMs_;
+  size_t low = 0;
+  size_t high = frameCount_;
+  while (high - low > 1)
+  {
+    const size_t mid = (low + high) / 2;
+    if (startMs_[mid] <= elapsedMs)
+    {
+      low = mid;
+    }
+    else
+    {
+      high = mid;
+    }
+  }
+  return low;
+}
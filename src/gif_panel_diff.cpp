@@ -0,0 +1,221 @@
+#include "gif_panel_diff.h"
+
+#include <Arduino.h>
+#include <Arduino_GFX_Library.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "panel_pixels.h"
+#include "psram_alloc.h"
+
+bool GifPanelDiff::begin(uint16_t width, uint16_t height, uint16_t mergeGap, uint8_t fullRowPercent)
+{
+  mergeGap_ = mergeGap;
+  fullRowPercent_ = fullRowPercent;
+  if (shadow_ && width_ == width && height_ == height)
+  {
+    invalidate();
+    return true;
+  }
+  free(shadow_);
+  free(knownLeft_);
+  free(knownRight_);
+  shadow_ = static_cast<uint16_t *>(psramAlloc(static_cast<size_t>(width) * height * sizeof(uint16_t)));
+  knownLeft_ = static_cast<int16_t *>(malloc(height * sizeof(int16_t)));
+  knownRight_ = static_cast<int16_t *>(malloc(height * sizeof(int16_t)));
+  if (!shadow_ || !knownLeft_ || !knownRight_)
+  {
+    free(shadow_);
+    free(knownLeft_);
+    free(knownRight_);
+    shadow_ = nullptr;
+    knownLeft_ = nullptr;
+    knownRight_ = nullptr;
+    return false;
+  }
+  width_ = width;
+  height_ = height;
+  invalidate();
+  return true;
+}
+
+void GifPanelDiff::invalidate()
+{
+  if (!shadow_)
+  {
+    return;
+  }
+  for (uint16_t row = 0; row < height_; ++row)
+  {
+    knownLeft_[row] = 0;
+    knownRight_[row] = 0;
+  }
+}
+
+bool GifPanelDiff::copyTo(uint16_t *dest, uint16_t fill) const
+{
+  if (!shadow_)
+  {
+    return false;
+  }
+  bool trusted = false;
+  for (uint16_t row = 0; row < height_; ++row)
+  {
+    const size_t offset = static_cast<size_t>(row) * width_;
+    const int16_t left = knownLeft_[row];
+    const int16_t right = knownRight_[row];
+    for (int16_t px = 0; px < left; ++px)
+    {
+      dest[offset + px] = fill;
+    }
+    if (right > left)
+    {
+      memcpy(dest + offset + left, shadow_ + offset + left, static_cast<size_t>(right - left) * sizeof(uint16_t));
+      trusted = true;
+    }
+    for (int16_t px = right > left ? right : left; px < static_cast<int16_t>(width_); ++px)
+    {
+      dest[offset + px] = fill;
+    }
+  }
+  return trusted;
+}
+
+void GifPanelDiff::resetStats()
+{
+  stats_ = {};
+}
+
+void GifPanelDiff::send(Arduino_GFX *gfx, int16_t x, int16_t y, uint16_t *pixels, int16_t width, int16_t height)
+{
+  drawPanelPixels(gfx, x, y, pixels, width, height);
+  stats_.pixelsSent += static_cast<uint32_t>(width) * height;
+  ++stats_.writes;
+}
+
+int16_t GifPanelDiff::diffRow(int16_t row, int16_t left, int16_t right, const uint16_t *src)
+{
+  const uint16_t *shadowRow = shadow_ + static_cast<size_t>(row) * width_;
+  const int16_t knownLeft = knownLeft_[row];
+  const int16_t knownRight = knownRight_[row];
+  spanCount_ = 0;
+  int16_t changed = 0;
+  int16_t spanStart = -1;
+  int16_t spanEnd = -1;
+  for (int16_t px = left; px < right; ++px)
+  {
+    if (px >= knownLeft && px < knownRight && src[px - left] == shadowRow[px])
+    {
+      continue;
+    }
+    if (spanStart >= 0 && px - spanEnd < static_cast<int16_t>(mergeGap_))
+    {
+      spanEnd = static_cast<int16_t>(px + 1);
+      continue;
+    }
+    if (spanStart >= 0)
+    {
+      if (spanCount_ == MAX_ROW_SPANS)
+      {
+        // Out of room: the last span grows to cover the rest.
+        spanEnd = static_cast<int16_t>(px + 1);
+        continue;
+      }
+      spans_[spanCount_ * 2] = spanStart;
+      spans_[spanCount_ * 2 + 1] = spanEnd;
+      ++spanCount_;
+      changed = static_cast<int16_t>(changed + spanEnd - spanStart);
+    }
+    spanStart = px;
+    spanEnd = static_cast<int16_t>(px + 1);
+  }
+  if (spanStart >= 0)
+  {
+    if (spanCount_ == MAX_ROW_SPANS)
+    {
+      --spanCount_;
+      changed = static_cast<int16_t>(changed - (spans_[spanCount_ * 2 + 1] - spans_[spanCount_ * 2]));
+      spanStart = spans_[spanCount_ * 2];
+    }
+    spans_[spanCount_ * 2] = spanStart;
+    spans_[spanCount_ * 2 + 1] = spanEnd;
+    ++spanCount_;
+    changed = static_cast<int16_t>(changed + spanEnd - spanStart);
+  }
+  return changed;
+}
+
+void GifPanelDiff::updateRow(int16_t row, int16_t left, int16_t right, const uint16_t *src)
+{
+  memcpy(shadow_ + static_cast<size_t>(row) * width_ + left, src,
+         static_cast<size_t>(right - left) * sizeof(uint16_t));
+  int16_t &knownLeft = knownLeft_[row];
+  int16_t &knownRight = knownRight_[row];
+  if (knownRight > knownLeft && left <= knownRight && right >= knownLeft)
+  {
+    knownLeft = min(knownLeft, left);
+    knownRight = max(knownRight, right);
+  }
+  else if (right - left > knownRight - knownLeft)
+  {
+    knownLeft = left;
+    knownRight = right;
+  }
+}
+
+void GifPanelDiff::blit(Arduino_GFX *gfx, int16_t x, int16_t y, uint16_t *pixels, int16_t width, int16_t height)
+{
+  const int16_t left = x < 0 ? 0 : x;
+  const int16_t top = y < 0 ? 0 : y;
+  const int16_t right = min(static_cast<int16_t>(x + width), static_cast<int16_t>(width_));
+  const int16_t bottom = min(static_cast<int16_t>(y + height), static_cast<int16_t>(height_));
+  if (!shadow_)
+  {
+    stats_.pixelsIn += static_cast<uint32_t>(width) * height;
+    send(gfx, x, y, pixels, width, height);
+    return;
+  }
+  if (right <= left || bottom <= top)
+  {
+    return;
+  }
+  const int16_t span = static_cast<int16_t>(right - left);
+  stats_.pixelsIn += static_cast<uint32_t>(span) * (bottom - top);
+
+  // Whole rows are gathered into one rectangle while the write's rows are
+  // contiguous (not clipped at the sides).
+  const bool rowsContiguous = span == width;
+  int16_t wholeTop = -1;
+  for (int16_t row = top; row < bottom; ++row)
+  {
+    uint16_t *src = pixels + static_cast<size_t>(row - y) * width + (left - x);
+    const int16_t changed = diffRow(row, left, right, src);
+    const bool whole =
+        changed > 0 && static_cast<uint32_t>(changed) * 100 >= static_cast<uint32_t>(span) * fullRowPercent_;
+    updateRow(row, left, right, src);
+    if (wholeTop >= 0 && (!whole || !rowsContiguous))
+    {
+      send(gfx, left, wholeTop, pixels + static_cast<size_t>(wholeTop - y) * width + (left - x), span,
+           static_cast<int16_t>(row - wholeTop));
+      wholeTop = -1;
+    }
+    if (whole)
+    {
+      if (wholeTop < 0)
+      {
+        wholeTop = row;
+      }
+      continue;
+    }
+    for (size_t i = 0; i < spanCount_; ++i)
+    {
+      const int16_t spanLeft = spans_[i * 2];
+      send(gfx, spanLeft, row, src + (spanLeft - left), static_cast<int16_t>(spans_[i * 2 + 1] - spanLeft), 1);
+    }
+  }
+  if (wholeTop >= 0)
+  {
+    send(gfx, left, wholeTop, pixels + static_cast<size_t>(wholeTop - y) * width + (left - x), span,
+         static_cast<int16_t>(bottom - wholeTop));
+  }
+}
@@ -0,0 +1,358 @@
+#include "gif_playlist.h"
+
+#include <AnimatedGIF.h>
+#include <Arduino.h>
+#include <SD.h>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "config.h"
+#include "psram_alloc.h"
+#include "spi_bus_lock.h"
+
+namespace
+{
+constexpr uint32_t PLAYLIST_MAGIC = 0x4C504947; // "GIPL"
+constexpr uint16_t PLAYLIST_VERSION = 1;
+constexpr uint32_t FNV_OFFSET = 2166136261UL;
+constexpr uint32_t FNV_PRIME = 16777619UL;
+constexpr size_t CHECKSUM_BYTES = 512;
+
+// Index layout: this header, then `count` GifPlaylistEntry records in
+// playlist order.
+struct PlaylistIndexHeader
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t count;
+  // Names, sizes and write times of the GIFs the index was built from.
+  uint32_t signature;
+  // How long parsing every file took, for the boot report.
+  uint32_t scanMs;
+};
+
+uint32_t fnv1a(uint32_t hash, const void *data, size_t length)
+{
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < length; ++i)
+  {
+    hash = (hash ^ bytes[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+const char *baseName(const char *path)
+{
+  const char *slash = strrchr(path, '/');
+  return slash ? slash + 1 : path;
+}
+
+bool isGifName(const char *name)
+{
+  const size_t length = strlen(name);
+  return length > 4 && strcasecmp(name + length - 4, ".gif") == 0;
+}
+
+uint32_t fileChecksum(File &file, uint32_t size)
+{
+  uint8_t sector[CHECKSUM_BYTES];
+  uint32_t hash = fnv1a(FNV_OFFSET, &size, sizeof(size));
+  file.seek(0);
+  hash = fnv1a(hash, sector, static_cast<size_t>(file.read(sector, size < CHECKSUM_BYTES ? size : CHECKSUM_BYTES)));
+  if (size > CHECKSUM_BYTES)
+  {
+    file.seek(size - CHECKSUM_BYTES);
+    hash = fnv1a(hash, sector, static_cast<size_t>(file.read(sector, CHECKSUM_BYTES)));
+  }
+  return hash;
+}
+
+// The decoder that parses files for the table reads them through these.
+File scanFile;
+
+void *scanOpen(const char *path, int32_t *fileSize)
+{
+  scanFile = SD.open(path, FILE_READ);
+  if (!scanFile)
+  {
+    return nullptr;
+  }
+  *fileSize = static_cast<int32_t>(scanFile.size());
+  return &scanFile;
+}
+
+void scanClose(void *)
+{
+  scanFile.close();
+}
+
+int32_t scanRead(GIFFILE *pFile, uint8_t *pBuf, int32_t iLen)
+{
+  int32_t bytesToRead = pFile->iSize - pFile->iPos;
+  if (bytesToRead > iLen)
+  {
+    bytesToRead = iLen;
+  }
+  if (bytesToRead <= 0)
+  {
+    return 0;
+  }
+  const int32_t bytesRead = static_cast<int32_t>(scanFile.read(pBuf, static_cast<size_t>(bytesToRead)));
+  pFile->iPos += bytesRead > 0 ? bytesRead : 0;
+  return bytesRead > 0 ? bytesRead : 0;
+}
+
+int32_t scanSeek(GIFFILE *pFile, int32_t iPosition)
+{
+  if (iPosition < 0)
+  {
+    iPosition = 0;
+  }
+  else if (iPosition > pFile->iSize)
+  {
+    iPosition = pFile->iSize;
+  }
+  scanFile.seek(static_cast<uint32_t>(iPosition));
+  pFile->iPos = iPosition;
+  return iPosition;
+}
+
+void scanDraw(GIFDRAW *) {}
+
+bool parseGif(AnimatedGIF &gif, const char *path, GifPlaylistEntry &entry)
+{
+  if (!gif.open(path, scanOpen, scanClose, scanRead, scanSeek, scanDraw))
+  {
+    return false;
+  }
+  GIFINFO info = {};
+  const bool ok = gif.getInfo(&info) && info.iFrameCount > 0;
+  entry.canvasWidth = static_cast<uint16_t>(gif.getCanvasWidth());
+  entry.canvasHeight = static_cast<uint16_t>(gif.getCanvasHeight());
+  entry.frameCount = static_cast<uint16_t>(info.iFrameCount > UINT16_MAX ? UINT16_MAX : info.iFrameCount);
+  entry.durationMs = static_cast<uint32_t>(info.iDuration);
+  entry.checksum = fileChecksum(scanFile, entry.fileSize);
+  gif.close();
+  return ok;
+}
+} // namespace
+
+size_t GifPlaylist::presentCount() const
+{
+  size_t present = 0;
+  for (size_t i = 0; entries_ && i < count_; ++i)
+  {
+    present += entries_[i].fileSize > 0 ? 1 : 0;
+  }
+  return present;
+}
+
+uint32_t GifPlaylist::listDirectory(const char *const *paths)
+{
+  uint32_t signature = FNV_OFFSET;
+  File root = SD.open("/");
+  if (root && root.isDirectory())
+  {
+    for (File file = root.openNextFile(); file; file = root.openNextFile())
+    {
+      const char *name = baseName(file.name());
+      if (!file.isDirectory() && isGifName(name))
+      {
+        const uint32_t size = static_cast<uint32_t>(file.size());
+        const uint32_t written = static_cast<uint32_t>(file.getLastWrite());
+        signature = fnv1a(signature, name, strlen(name));
+        signature = fnv1a(signature, &size, sizeof(size));
+        signature = fnv1a(signature, &written, sizeof(written));
+        for (size_t i = 0; i < count_; ++i)
+        {
+          if (baseName(paths[i]) == paths[i] + 1 && strcasecmp(paths[i] + 1, name) == 0)
+          {
+            entries_[i].fileSize = size;
+          }
+        }
+      }
+      file.close();
+    }
+  }
+  if (root)
+  {
+    root.close();
+  }
+
+  // Entries outside the root directory are looked up one by one.
+  for (size_t i = 0; i < count_; ++i)
+  {
+    if (baseName(paths[i]) != paths[i] + 1)
+    {
+      File file = SD.open(paths[i], FILE_READ);
+      if (file && !file.isDirectory())
+      {
+        entries_[i].fileSize = static_cast<uint32_t>(file.size());
+        const uint32_t written = static_cast<uint32_t>(file.getLastWrite());
+        signature = fnv1a(signature, paths[i], strlen(paths[i]));
+        signature = fnv1a(signature, &entries_[i].fileSize, sizeof(entries_[i].fileSize));
+        signature = fnv1a(signature, &written, sizeof(written));
+      }
+      if (file)
+      {
+        file.close();
+      }
+    }
+  }
+  return signature;
+}
+
+bool GifPlaylist::readIndex(GifPlaylistEntry *stored, uint32_t *signature, uint32_t *scanMs) const
+{
+  if (!SD.exists(ANIMATED_GIF_PLAYLIST_INDEX))
+  {
+    return false;
+  }
+  File file = SD.open(ANIMATED_GIF_PLAYLIST_INDEX, FILE_READ);
+  if (!file)
+  {
+    return false;
+  }
+  PlaylistIndexHeader header = {};
+  const size_t bytes = count_ * sizeof(GifPlaylistEntry);
+  bool ok = file.read(reinterpret_cast<uint8_t *>(&header), sizeof(header)) == sizeof(header) &&
+            header.magic == PLAYLIST_MAGIC && header.version == PLAYLIST_VERSION && header.count == count_ &&
+            static_cast<size_t>(file.read(reinterpret_cast<uint8_t *>(stored), bytes)) == bytes;
+  file.close();
+  // A reordered or edited playlist invalidates the whole table.
+  for (size_t i = 0; ok && i < count_; ++i)
+  {
+    ok = stored[i].pathHash == entries_[i].pathHash;
+  }
+  if (ok)
+  {
+    *signature = header.signature;
+    *scanMs = header.scanMs;
+  }
+  return ok;
+}
+
+bool GifPlaylist::writeIndex(uint32_t signature, uint32_t scanMs) const
+{
+  File file = SD.open(ANIMATED_GIF_PLAYLIST_INDEX, FILE_WRITE);
+  if (!file)
+  {
+    return false;
+  }
+  const PlaylistIndexHeader header = {PLAYLIST_MAGIC, PLAYLIST_VERSION, static_cast<uint16_t>(count_), signature,
+                                      scanMs};
+  const size_t bytes = count_ * sizeof(GifPlaylistEntry);
+  const bool ok = file.write(reinterpret_cast<const uint8_t *>(&header), sizeof(header)) == sizeof(header) &&
+                  file.write(reinterpret_cast<const uint8_t *>(entries_), bytes) == bytes;
+  file.close();
+  if (!ok)
+  {
+    SD.remove(ANIMATED_GIF_PLAYLIST_INDEX);
+  }
+  return ok;
+}
+
+void GifPlaylist::load(const char *const *paths, size_t count)
+{
+  if (entries_ || count == 0 || count > UINT16_MAX)
+  {
+    return;
+  }
+  const uint32_t start = millis();
+  entries_ = static_cast<GifPlaylistEntry *>(psramAlloc(count * sizeof(GifPlaylistEntry)));
+  GifPlaylistEntry *stored = static_cast<GifPlaylistEntry *>(psramAlloc(count * sizeof(GifPlaylistEntry)));
+  if (!entries_ || !stored)
+  {
+    free(entries_);
+    free(stored);
+    entries_ = nullptr;
+    Serial.println("Animated GIF: no memory for the playlist table, probing files on open");
+    return;
+  }
+  count_ = count;
+  for (size_t i = 0; i < count; ++i)
+  {
+    entries_[i] = {};
+    entries_[i].pathHash = fnv1a(FNV_OFFSET, paths[i], strlen(paths[i]));
+  }
+
+  SpiBusGuard bus;
+  const uint32_t signature = listDirectory(paths);
+  uint32_t storedSignature = 0;
+  uint32_t scanMs = 0;
+  const bool haveIndex = readIndex(stored, &storedSignature, &scanMs);
+  if (haveIndex && storedSignature == signature)
+  {
+    memcpy(entries_, stored, count * sizeof(GifPlaylistEntry));
+    free(stored);
+    const uint32_t elapsed = millis() - start;
+    Serial.printf("Animated GIF: playlist index matches the card, %u of %u files in %lu ms (a full scan took "
+                  "%lu ms)\n",
+                  static_cast<unsigned>(presentCount()), static_cast<unsigned>(count_),
+                  static_cast<unsigned long>(elapsed), static_cast<unsigned long>(scanMs));
+    return;
+  }
+
+  AnimatedGIF *gif = nullptr;
+  size_t parsed = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    GifPlaylistEntry &entry = entries_[i];
+    if (entry.fileSize == 0)
+    {
+      Serial.printf("Animated GIF: %s is not on the card, skipping it\n", paths[i]);
+      continue;
+    }
+    // Same size and checksum as last time: the stored details still hold.
+    if (haveIndex && stored[i].fileSize == entry.fileSize)
+    {
+      File file = SD.open(paths[i], FILE_READ);
+      const bool unchanged = file && fileChecksum(file, entry.fileSize) == stored[i].checksum;
+      if (file)
+      {
+        file.close();
+      }
+      if (unchanged)
+      {
+        entry = stored[i];
+        continue;
+      }
+    }
+    if (!gif)
+    {
+      void *memory = psramAlloc(sizeof(AnimatedGIF));
+      gif = memory ? new (memory) AnimatedGIF() : nullptr;
+      if (gif)
+      {
+        gif->begin(LITTLE_ENDIAN_PIXELS);
+      }
+    }
+    if (!gif || !parseGif(*gif, paths[i], entry))
+    {
+      Serial.printf("Animated GIF: %s could not be parsed, skipping it\n", paths[i]);
+      entry.fileSize = 0;
+      continue;
+    }
+    ++parsed;
+  }
+  if (gif)
+  {
+    gif->~AnimatedGIF();
+    free(gif);
+  }
+  free(stored);
+
+  const uint32_t elapsed = millis() - start;
+  // Keep the full-scan time from the last complete scan when only some files
+  // were parsed again.
+  if (parsed == presentCount() || !haveIndex)
+  {
+    scanMs = elapsed;
+  }
+  const bool written = writeIndex(signature, scanMs);
+  Serial.printf("Animated GIF: scanned the playlist in %lu ms, %u of %u files present, %u parsed%s\n",
+                static_cast<unsigned long>(elapsed), static_cast<unsigned>(presentCount()),
+                static_cast<unsigned>(count_), static_cast<unsigned>(parsed), written ? "" : " (index not written)");
+}
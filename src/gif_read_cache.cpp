@@ -0,0 +1,323 @@
+#include "gif_read_cache.h"
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "psram_alloc.h"
+#include "spi_bus_lock.h"
+
+namespace
+{
+constexpr int32_t SECTOR_SIZE = 512;
+} // namespace
+
+bool GifReadCache::begin(size_t capacity)
+{
+  capacity = capacity & ~static_cast<size_t>(SECTOR_SIZE - 1);
+  if (windows_[0].data && capacity_ >= capacity)
+  {
+    return true;
+  }
+  waitForPrefetch();
+  free(windows_[0].data);
+  free(windows_[1].data);
+  windows_[0] = {};
+  windows_[1] = {};
+  current_ = 0;
+  capacity_ = 0;
+  if (capacity == 0)
+  {
+    return false;
+  }
+  windows_[0].data = static_cast<uint8_t *>(psramAlloc(capacity));
+  if (!windows_[0].data)
+  {
+    return false;
+  }
+  capacity_ = capacity;
+  return true;
+}
+
+bool GifReadCache::startIoTask(int core, uint32_t stackBytes)
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  if (ioTask_)
+  {
+    return true;
+  }
+  if (!windows_[0].data || core < 0)
+  {
+    return false;
+  }
+  if (!windows_[1].data)
+  {
+    windows_[1].data = static_cast<uint8_t *>(psramAlloc(capacity_));
+  }
+  if (!prefetchDone_)
+  {
+    prefetchDone_ = xSemaphoreCreateBinary();
+  }
+  if (!windows_[1].data || !prefetchDone_ ||
+      xTaskCreatePinnedToCore(ioTaskMain, "gifIo", stackBytes, this, 2, &ioTask_, core) != pdPASS)
+  {
+    ioTask_ = nullptr;
+    free(windows_[1].data);
+    windows_[1] = {};
+    return false;
+  }
+  return true;
+#else
+  (void)core;
+  (void)stackBytes;
+  return false;
+#endif
+}
+
+void GifReadCache::setSectorReader(FatVolume::SectorReader reader, void *context)
+{
+  waitForPrefetch();
+  sectorReader_ = reader;
+  sectorContext_ = context;
+}
+
+void GifReadCache::attach(File *file, int32_t fileSize, const FatExtent *extent)
+{
+  waitForPrefetch();
+  file_ = file;
+  fileSize_ = fileSize;
+  extent_ = {};
+  if (extent && sectorReader_ && extent->sectorCount > 0 && extent->fileSize == static_cast<uint32_t>(fileSize))
+  {
+    extent_ = *extent;
+  }
+  // Files are re-attached mid-stream when a pooled decoder resumes, so the
+  // first refill always seeks.
+  filePosition_ = -1;
+  windows_[0].length = 0;
+  windows_[1].length = 0;
+}
+
+void GifReadCache::detach()
+{
+  waitForPrefetch();
+  file_ = nullptr;
+  fileSize_ = 0;
+  filePosition_ = -1;
+  extent_ = {};
+  windows_[0].length = 0;
+  windows_[1].length = 0;
+}
+
+void GifReadCache::resetStats()
+{
+  stats_ = {};
+}
+
+int32_t GifReadCache::readFromFile(int32_t position, uint8_t *dest, int32_t length)
+{
+  SpiBusGuard bus(SpiBusUser::Sd);
+  const uint32_t start = micros();
+  if (filePosition_ != position)
+  {
+    file_->seek(static_cast<uint32_t>(position));
+  }
+  int32_t bytesRead = static_cast<int32_t>(file_->read(dest, static_cast<size_t>(length)));
+  if (bytesRead < 0)
+  {
+    bytesRead = 0;
+  }
+  filePosition_ = position + bytesRead;
+  stats_.bytesFromCard += static_cast<uint32_t>(bytesRead);
+  stats_.ioMicros += micros() - start;
+  return bytesRead;
+}
+
+int32_t GifReadCache::readFromSectors(int32_t position, uint8_t *dest, int32_t length)
+{
+  SpiBusGuard bus(SpiBusUser::Sd);
+  const uint32_t start = micros();
+  const uint32_t sectors = (static_cast<uint32_t>(length) + SECTOR_SIZE - 1) / SECTOR_SIZE;
+  if (!sectorReader_(sectorContext_, extent_.firstSector + static_cast<uint32_t>(position) / SECTOR_SIZE, dest,
+                     sectors))
+  {
+    // Leave the file to the FAT layer from here on.
+    extent_ = {};
+    return readFromFile(position, dest, length);
+  }
+  stats_.bytesFromCard += static_cast<uint32_t>(length);
+  stats_.bytesDirect += static_cast<uint32_t>(length);
+  stats_.ioMicros += micros() - start;
+  return length;
+}
+
+void GifReadCache::readWindow(Window &window)
+{
+  int32_t length = static_cast<int32_t>(capacity_);
+  if (window.start + length > fileSize_)
+  {
+    length = fileSize_ - window.start;
+  }
+  if (length <= 0)
+  {
+    window.length = 0;
+  }
+  else if (extent_.sectorCount > 0)
+  {
+    // Windows are whole sectors long, so the last sector fits too.
+    window.length = readFromSectors(window.start, window.data, length);
+  }
+  else
+  {
+    window.length = readFromFile(window.start, window.data, length);
+  }
+}
+
+bool GifReadCache::fill(Window &window, int32_t position)
+{
+  // Windows start on a sector boundary so the card is read in whole sectors.
+  window.start = position & ~(SECTOR_SIZE - 1);
+  readWindow(window);
+  ++stats_.refills;
+  return contains(window, position);
+}
+
+void GifReadCache::requestPrefetch()
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  if (!ioTask_)
+  {
+    return;
+  }
+  const Window &current = windows_[current_];
+  Window &next = windows_[current_ ^ 1];
+  const int32_t start = current.start + current.length;
+  if (start >= fileSize_ || (next.length > 0 && next.start == start))
+  {
+    return;
+  }
+  next.start = start;
+  next.length = 0;
+  prefetchBusy_ = true;
+  xTaskNotifyGive(ioTask_);
+#endif
+}
+
+void GifReadCache::waitForPrefetch()
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  if (!prefetchBusy_)
+  {
+    return;
+  }
+  const uint32_t start = micros();
+  while (prefetchBusy_)
+  {
+    xSemaphoreTake(prefetchDone_, portMAX_DELAY);
+  }
+  ++stats_.stalls;
+  stats_.stallMicros += micros() - start;
+#endif
+}
+
+#if defined(ARDUINO_ARCH_ESP32)
+void GifReadCache::ioTaskMain(void *cache)
+{
+  GifReadCache &self = *static_cast<GifReadCache *>(cache);
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (!self.prefetchBusy_)
+    {
+      continue;
+    }
+    // The decoder does not touch this window or the file until
+    // prefetchBusy_ drops.
+    self.readWindow(self.windows_[self.current_ ^ 1]);
+    ++self.stats_.prefetches;
+    self.prefetchBusy_ = false;
+    xSemaphoreGive(self.prefetchDone_);
+  }
+}
+#endif
+
+GifReadCache::Window *GifReadCache::windowFor(int32_t position)
+{
+  Window &current = windows_[current_];
+  if (contains(current, position))
+  {
+    return &current;
+  }
+  waitForPrefetch();
+  Window &next = windows_[current_ ^ 1];
+  if (next.data && contains(next, position))
+  {
+    current_ ^= 1;
+    ++stats_.prefetchHits;
+    requestPrefetch();
+    return &next;
+  }
+  if (!fill(current, position))
+  {
+    return nullptr;
+  }
+  requestPrefetch();
+  return &current;
+}
+
+int32_t GifReadCache::read(int32_t position, uint8_t *dest, int32_t length)
+{
+  if (!file_ || length <= 0 || position < 0 || position >= fileSize_)
+  {
+    return 0;
+  }
+  ++stats_.readCalls;
+  if (position + length > fileSize_)
+  {
+    length = fileSize_ - position;
+  }
+
+  if (!windows_[0].data)
+  {
+    const int32_t bytesRead = readFromFile(position, dest, length);
+    stats_.bytesServed += static_cast<uint32_t>(bytesRead);
+    return bytesRead;
+  }
+
+  int32_t copied = 0;
+  while (copied < length)
+  {
+    const int32_t current = position + copied;
+    const Window *window = windowFor(current);
+    if (!window)
+    {
+      break;
+    }
+    int32_t chunk = window->start + window->length - current;
+    if (chunk > length - copied)
+    {
+      chunk = length - copied;
+    }
+    memcpy(dest + copied, window->data + (current - window->start), static_cast<size_t>(chunk));
+    copied += chunk;
+  }
+  stats_.bytesServed += static_cast<uint32_t>(copied);
+  return copied;
+}
+
+uint8_t *GifReadCache::map(int32_t position, int32_t *available)
+{
+  *available = 0;
+  if (!file_ || !windows_[0].data || position < 0 || position >= fileSize_)
+  {
+    return nullptr;
+  }
+  ++stats_.mapCalls;
+  const Window *window = windowFor(position);
+  if (!window)
+  {
+    return nullptr;
+  }
+  *available = window->start + window->length - position;
+  return window->data + (position - window->start);
+}
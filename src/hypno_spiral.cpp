@@ -5,31 +5,67 @@
 #include <string.h>
 #include <stdlib.h>
 
-#if defined(ESP32)
-#include <esp_heap_caps.h>
-#endif
-
 #include "config.h"
+#include "panel_pixels.h"
+#include "psram_alloc.h"
+#include "spi_bus_lock.h"
 
 #if !defined(ENABLE_HYPNO_SPIRAL)
 
 void hypnoSetup() {}
 void hypnoStep() {}
+void hypnoTeardown() {}
+void hypnoInvalidatePanel() {}
 
 #else
 
+// The cache goes on the GIF player's card.
+#if defined(HYPNO_MAP_CACHE) && defined(ENABLE_ANIMATED_GIF) && defined(ANIMATED_GIF_USE_SD)
+#define HYPNO_USE_MAP_CACHE
+#include <SD.h>
+#endif
+
 extern Arduino_GFX *gfx;
 
 namespace
 {
 constexpr uint16_t WIDTH = DISPLAY_WIDTH;
 constexpr uint16_t HEIGHT = DISPLAY_HEIGHT;
-constexpr size_t PIXEL_COUNT = static_cast<size_t>(WIDTH) * HEIGHT;
 
-uint16_t *spiralBuffer = nullptr;
-uint16_t *phaseMap = nullptr;
-uint8_t *maskMap = nullptr;
+constexpr uint16_t HALF_WIDTH = WIDTH / 2;
+constexpr uint16_t HALF_HEIGHT = HEIGHT / 2;
+static_assert(WIDTH % 2 == 0 && HEIGHT % 2 == 0, "the spiral is mirrored from one quadrant");
+
+// The spiral is symmetric about the panel's centre lines: the radius is the
+// same in all four quadrants and the angle only changes sign or turns by
+// half a revolution. Only the top half's phases are kept, as two tables of
+// one quadrant each: row r holds the r-th row up from the centre, pixels from
+// the centre out to the circle (quadrantSpan[r] of them, left table read
+// leftwards, right table rightwards). The bottom half is the top turned half
+// a revolution about the centre: its left side reads the right table and the
+// other way round, half a turn on in angle (halfTurnPhase).
+uint16_t quadrantSpan[HALF_HEIGHT];
+uint32_t quadrantRow[HALF_HEIGHT];
+// Both tables in one block (PSRAM, only while the spiral is in use).
+uint8_t *leftPhase = nullptr;
+uint8_t *rightPhase = nullptr;
+size_t quadrantSize = 0;
+uint8_t halfTurnPhase = 0;
 uint16_t phaseOffset = 0;
+// Colour of each phase byte this frame, with the offset folded in.
+uint16_t colorLut[256];
+
+// Rows rendered and sent to the panel together, in internal RAM for the DMA.
+alignas(4) uint16_t bandBuffer[WIDTH * HYPNO_BAND_LINES];
+// The corners outside the circle never change, so after the first frame
+// each band only covers the widest of its rows; set when the panel has been
+// drawn over since.
+bool panelStale = true;
+
+uint32_t statsFrames = 0;
+uint32_t statsFrameMicros = 0;
+uint32_t lastStatsMillis = 0;
+uint32_t lastStepMillis = 0;
 
 #if defined(HYPNO_RAINBOW_PRIMARY)
 constexpr uint16_t rgb565FromRgb888(uint8_t r, uint8_t g, uint8_t b)
@@ -58,131 +94,350 @@ uint16_t wheelRgb565(uint8_t wheelPos)
   const uint8_t ramp = static_cast<uint8_t>(wheelPos * 3);
   return rgb565FromRgb888(ramp, static_cast<uint8_t>(255 - ramp), 0);
 }
+
+// wheelRgb565() for each phase byte, in panel byte order.
+uint16_t wheelLut[256];
 #endif
-} // namespace
 
-void hypnoSetup()
+// The colour of a pixel only depends on its phase plus the offset, so the
+// frame's colours for every phase byte are worked out once here.
+void buildColorLut()
 {
-#if defined(ESP32)
-  if (!spiralBuffer)
+  float duty = HYPNO_STRIPE_DUTY;
+  if (duty < 0.0f)
   {
-    spiralBuffer = static_cast<uint16_t *>(
-        heap_caps_malloc(PIXEL_COUNT * sizeof(uint16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    duty = 0.0f;
   }
-  if (!phaseMap)
+  else if (duty > 1.0f)
   {
-    phaseMap = static_cast<uint16_t *>(
-        heap_caps_malloc(PIXEL_COUNT * sizeof(uint16_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    duty = 1.0f;
   }
-  if (!maskMap)
+  const uint16_t dutyThreshold = static_cast<uint16_t>(duty * 65535.0f);
+  constexpr uint16_t secondary = panelPixel(HYPNO_SECONDARY_COLOR);
+#if !defined(HYPNO_RAINBOW_PRIMARY)
+  constexpr uint16_t primary = panelPixel(HYPNO_PRIMARY_COLOR);
+#endif
+
+  for (uint16_t phase = 0; phase < 256; ++phase)
   {
-    maskMap = static_cast<uint8_t *>(
-        heap_caps_malloc(PIXEL_COUNT * sizeof(uint8_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
-  }
+    const uint16_t value = static_cast<uint16_t>((phase << 8) + phaseOffset);
+    if (value >= dutyThreshold)
+    {
+      colorLut[phase] = secondary;
+      continue;
+    }
+#if defined(HYPNO_RAINBOW_PRIMARY)
+    colorLut[phase] = wheelLut[value >> 8];
 #else
-  if (!spiralBuffer)
+    colorLut[phase] = primary;
+#endif
+  }
+}
+
+void reportStats(uint32_t frameMicros)
+{
+  const uint32_t now = millis();
+  if (now - lastStepMillis > 1000)
   {
-    spiralBuffer = static_cast<uint16_t *>(malloc(PIXEL_COUNT * sizeof(uint16_t)));
+    // The spiral was off screen: count from this frame.
+    statsFrames = 0;
+    statsFrameMicros = 0;
+    lastStatsMillis = now;
   }
-  if (!phaseMap)
+  lastStepMillis = now;
+  ++statsFrames;
+  statsFrameMicros += frameMicros;
+  const uint32_t elapsed = now - lastStatsMillis;
+  if (HYPNO_STATS_INTERVAL_MS == 0 || elapsed < static_cast<uint32_t>(HYPNO_STATS_INTERVAL_MS))
   {
-    phaseMap = static_cast<uint16_t *>(malloc(PIXEL_COUNT * sizeof(uint16_t)));
+    return;
   }
-  if (!maskMap)
+  Serial.printf("Hypno spiral: %lu fps, %lu us/frame\n",
+                static_cast<unsigned long>(statsFrames * 1000UL / elapsed),
+                static_cast<unsigned long>(statsFrameMicros / statsFrames));
+  statsFrames = 0;
+  statsFrameMicros = 0;
+  lastStatsMillis = now;
+}
+
+// Quadrant row that row `y` of the panel mirrors.
+uint16_t quadrantRowOf(uint16_t y)
+{
+  return y < HALF_HEIGHT ? static_cast<uint16_t>(HALF_HEIGHT - 1 - y) : static_cast<uint16_t>(y - HALF_HEIGHT);
+}
+
+// Renders rows [y, y + rows) into the band, `left` to `right` (which cover
+// the circle's part of every row), and sends it.
+void drawBand(uint16_t y, uint16_t rows, uint16_t left, uint16_t right)
+{
+  constexpr uint16_t background = panelPixel(HYPNO_BACKGROUND_COLOR);
+  const uint16_t width = static_cast<uint16_t>(right - left);
+  uint16_t *out = bandBuffer;
+  for (uint16_t row = y; row < y + rows; ++row)
   {
-    maskMap = static_cast<uint8_t *>(malloc(PIXEL_COUNT * sizeof(uint8_t)));
+    const uint16_t quadrant = quadrantRowOf(row);
+    const uint16_t span = quadrantSpan[quadrant];
+    const bool top = row < HALF_HEIGHT;
+    const uint8_t add = top ? 0 : halfTurnPhase;
+    const uint8_t *leftRow = (top ? leftPhase : rightPhase) + quadrantRow[quadrant];
+    const uint8_t *rightRow = (top ? rightPhase : leftPhase) + quadrantRow[quadrant];
+    for (uint16_t x = left; x < HALF_WIDTH - span; ++x)
+    {
+      *out++ = background;
+    }
+    for (uint16_t i = span; i > 0; --i)
+    {
+      *out++ = colorLut[static_cast<uint8_t>(leftRow[i - 1] + add)];
+    }
+    for (uint16_t i = 0; i < span; ++i)
+    {
+      *out++ = colorLut[static_cast<uint8_t>(rightRow[i] + add)];
+    }
+    for (uint16_t x = HALF_WIDTH + span; x < right; ++x)
+    {
+      *out++ = background;
+    }
   }
-#endif
+  SpiBusGuard bus(SpiBusUser::Panel);
+  drawPanelPixels(gfx, static_cast<int16_t>(left), static_cast<int16_t>(y), bandBuffer, static_cast<int16_t>(width),
+                  static_cast<int16_t>(rows));
+}
+
+// Phase byte at polar angle `angle` (-pi..pi) and eased radius `easedRadius`
+// (0..1).
+uint8_t spiralPhase(float easedRadius, float angle)
+{
+  angle = (angle + PI) / (2.0f * PI); // 0..1
+
+  float combined = angle * HYPNO_STRIPE_COUNT + easedRadius * HYPNO_TWIST_FACTOR;
+  combined = combined - floorf(combined); // keep fractional part in [0,1)
+  // Rounded; a turn wraps back to 0.
+  return static_cast<uint8_t>(static_cast<uint16_t>(combined * 256.0f + 0.5f));
+}
+
+constexpr float CENTER_X = (static_cast<float>(WIDTH) - 1.0f) * 0.5f;
+constexpr float CENTER_Y = (static_cast<float>(HEIGHT) - 1.0f) * 0.5f;
+constexpr float MAX_RADIUS = 0.5f * static_cast<float>(WIDTH < HEIGHT ? WIDTH : HEIGHT);
+
+#if defined(HYPNO_USE_MAP_CACHE)
+constexpr uint32_t MAP_MAGIC = 0x4D505948; // "HYPM"
+constexpr uint16_t MAP_VERSION = 2;
+
+// Cache file layout: this header, then both phase tables. The parameters the
+// map is built from are kept in it, so a change to any of them rebuilds it.
+struct HypnoMapHeader
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t width;
+  uint16_t height;
+  uint16_t reserved;
+  float stripeCount;
+  float twistFactor;
+  float radiusExponent;
+  uint32_t tableBytes;
+};
+
+HypnoMapHeader mapHeader()
+{
+  HypnoMapHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = MAP_MAGIC;
+  header.version = MAP_VERSION;
+  header.width = WIDTH;
+  header.height = HEIGHT;
+  header.stripeCount = HYPNO_STRIPE_COUNT;
+  header.twistFactor = HYPNO_TWIST_FACTOR;
+  header.radiusExponent = HYPNO_RADIUS_EXPONENT;
+  header.tableBytes = static_cast<uint32_t>(quadrantSize * 2);
+  return header;
+}
 
-  if (!spiralBuffer || !phaseMap || !maskMap)
+bool loadMap()
+{
+  SpiBusGuard bus(SpiBusUser::Sd);
+  if (!SD.exists(HYPNO_MAP_CACHE))
   {
-    Serial.println("Hypno spiral: buffer allocation failed");
-    return;
+    return false;
+  }
+  File file = SD.open(HYPNO_MAP_CACHE, FILE_READ);
+  if (!file)
+  {
+    return false;
+  }
+  const HypnoMapHeader expected = mapHeader();
+  HypnoMapHeader header;
+  const bool ok = file.read(reinterpret_cast<uint8_t *>(&header), sizeof(header)) == sizeof(header) &&
+                  memcmp(&header, &expected, sizeof(header)) == 0 &&
+                  static_cast<uint32_t>(file.read(leftPhase, expected.tableBytes)) == expected.tableBytes;
+  file.close();
+  return ok;
+}
+
+bool saveMap()
+{
+  SpiBusGuard bus(SpiBusUser::Sd);
+  File file = SD.open(HYPNO_MAP_CACHE, FILE_WRITE);
+  if (!file)
+  {
+    return false;
+  }
+  const HypnoMapHeader header = mapHeader();
+  const bool ok = file.write(reinterpret_cast<const uint8_t *>(&header), sizeof(header)) == sizeof(header) &&
+                  file.write(leftPhase, header.tableBytes) == header.tableBytes;
+  file.close();
+  if (!ok)
+  {
+    SD.remove(HYPNO_MAP_CACHE);
   }
+  return ok;
+}
+#endif
 
-  const float cx = (static_cast<float>(WIDTH) - 1.0f) * 0.5f;
-  const float cy = (static_cast<float>(HEIGHT) - 1.0f) * 0.5f;
-  const float maxRadius = 0.5f * static_cast<float>(WIDTH < HEIGHT ? WIDTH : HEIGHT);
-  const float invMaxRadius = (maxRadius > 0.0f) ? (1.0f / maxRadius) : 0.0f;
+// Fills both phase tables.
+void buildMap()
+{
+  const float invMaxRadius = (MAX_RADIUS > 0.0f) ? (1.0f / MAX_RADIUS) : 0.0f;
   const float radiusExponent = HYPNO_RADIUS_EXPONENT;
   const bool applyRadiusExponent = fabsf(radiusExponent - 1.0f) > 1e-5f;
 
-  for (uint16_t y = 0; y < HEIGHT; ++y)
+  for (uint16_t row = 0; row < HALF_HEIGHT; ++row)
   {
-    const float fy = static_cast<float>(y) - cy;
-    for (uint16_t x = 0; x < WIDTH; ++x)
+    const float fy = static_cast<float>(HALF_HEIGHT - 1 - row) - CENTER_Y; // above the centre
+    uint8_t *left = leftPhase + quadrantRow[row];
+    uint8_t *right = rightPhase + quadrantRow[row];
+    for (uint16_t i = 0; i < quadrantSpan[row]; ++i)
     {
-      const size_t index = static_cast<size_t>(y) * WIDTH + x;
-      const float fx = static_cast<float>(x) - cx;
+      const float fx = static_cast<float>(HALF_WIDTH + i) - CENTER_X;
       const float radius = sqrtf(fx * fx + fy * fy);
-      const bool inside = radius <= maxRadius;
-      maskMap[index] = inside ? 1 : 0;
-
-      if (!inside)
-      {
-        phaseMap[index] = 0;
-        continue;
-      }
-
       const float normalizedRadius = radius * invMaxRadius; // 0..1
       const float easedRadius =
           applyRadiusExponent ? powf(normalizedRadius, radiusExponent) : normalizedRadius;
-
-      float angle = atan2f(fy, fx); // -pi..pi
-      angle = (angle + PI) / (2.0f * PI); // 0..1
-
-      float combined = angle * HYPNO_STRIPE_COUNT + easedRadius * HYPNO_TWIST_FACTOR;
-      combined = combined - floorf(combined); // keep fractional part in [0,1)
-      phaseMap[index] = static_cast<uint16_t>(combined * 65535.0f);
+      // The left pixel is the right one mirrored: same radius, angle
+      // reflected about the vertical.
+      const float angle = atan2f(fy, fx); // -pi/2..0
+      right[i] = spiralPhase(easedRadius, angle);
+      left[i] = spiralPhase(easedRadius, -PI - angle);
     }
   }
 }
 
-void hypnoStep()
+} // namespace
+
+void hypnoSetup()
 {
-  if (!spiralBuffer || !phaseMap || !maskMap)
+  if (leftPhase)
   {
     return;
   }
 
-  phaseOffset = static_cast<uint16_t>(phaseOffset + HYPNO_PHASE_INCREMENT);
+#if defined(HYPNO_RAINBOW_PRIMARY)
+  for (uint16_t i = 0; i < 256; ++i)
+  {
+    wheelLut[i] = panelPixel(wheelRgb565(static_cast<uint8_t>(i)));
+  }
+#endif
 
-  float duty = HYPNO_STRIPE_DUTY;
-  if (duty < 0.0f)
+  const uint32_t start = micros();
+  // Each quadrant row runs from the centre out to the circle.
+  quadrantSize = 0;
+  for (uint16_t row = 0; row < HALF_HEIGHT; ++row)
   {
-    duty = 0.0f;
+    const float fy = static_cast<float>(HALF_HEIGHT - 1 - row) - CENTER_Y;
+    uint16_t span = 0;
+    while (span < HALF_WIDTH)
+    {
+      const float fx = static_cast<float>(HALF_WIDTH + span) - CENTER_X;
+      if (sqrtf(fx * fx + fy * fy) > MAX_RADIUS)
+      {
+        break;
+      }
+      ++span;
+    }
+    quadrantSpan[row] = span;
+    quadrantRow[row] = static_cast<uint32_t>(quadrantSize);
+    quadrantSize += span;
   }
-  else if (duty > 1.0f)
+
+  leftPhase = static_cast<uint8_t *>(psramAlloc(quadrantSize * 2));
+  if (!leftPhase)
   {
-    duty = 1.0f;
+    Serial.println("Hypno spiral: buffer allocation failed");
+    return;
   }
-  const uint16_t dutyThreshold = static_cast<uint16_t>(duty * 65535.0f);
+  rightPhase = leftPhase + quadrantSize;
+  halfTurnPhase = static_cast<uint8_t>(static_cast<int32_t>(HYPNO_STRIPE_COUNT * 128.0f + 0.5f));
 
-  for (size_t i = 0; i < PIXEL_COUNT; ++i)
+  const char *source = "built";
+#if defined(HYPNO_USE_MAP_CACHE)
+  if (loadMap())
   {
-    if (!maskMap[i])
+    source = "loaded from " HYPNO_MAP_CACHE;
+  }
+  else
+  {
+    buildMap();
+    if (!saveMap())
     {
-      spiralBuffer[i] = HYPNO_BACKGROUND_COLOR;
-      continue;
+      source = "built (cache not written)";
     }
-
-    const uint16_t value = static_cast<uint16_t>(phaseMap[i] + phaseOffset);
-    const bool stripeOn = value < dutyThreshold;
-    if (stripeOn)
-    {
-#if defined(HYPNO_RAINBOW_PRIMARY)
-      spiralBuffer[i] = wheelRgb565(static_cast<uint8_t>(value >> 8));
+  }
 #else
-      spiralBuffer[i] = HYPNO_PRIMARY_COLOR;
+  buildMap();
 #endif
-    }
-    else
+  panelStale = true;
+  Serial.printf("Hypno spiral: %u byte phase tables (PSRAM) %s in %lu us, %u byte band\n",
+                static_cast<unsigned>(quadrantSize * 2), source, static_cast<unsigned long>(micros() - start),
+                static_cast<unsigned>(sizeof(bandBuffer)));
+}
+
+void hypnoStep()
+{
+  if (!leftPhase)
+  {
+    return;
+  }
+
+  const uint32_t start = micros();
+  phaseOffset = static_cast<uint16_t>(phaseOffset + HYPNO_PHASE_INCREMENT);
+  buildColorLut();
+  for (uint16_t y = 0; y < HEIGHT; y = static_cast<uint16_t>(y + HYPNO_BAND_LINES))
+  {
+    const uint16_t rows = HEIGHT - y < HYPNO_BAND_LINES ? static_cast<uint16_t>(HEIGHT - y) : HYPNO_BAND_LINES;
+    uint16_t left = 0;
+    uint16_t right = WIDTH;
+    if (!panelStale)
     {
-      spiralBuffer[i] = HYPNO_SECONDARY_COLOR;
+      uint16_t span = 0;
+      for (uint16_t row = y; row < y + rows; ++row)
+      {
+        const uint16_t rowSpan = quadrantSpan[quadrantRowOf(row)];
+        span = rowSpan > span ? rowSpan : span;
+      }
+      if (span == 0)
+      {
+        continue;
+      }
+      left = static_cast<uint16_t>(HALF_WIDTH - span);
+      right = static_cast<uint16_t>(HALF_WIDTH + span);
     }
+    drawBand(y, rows, left, right);
   }
+  panelStale = false;
+  reportStats(micros() - start);
+}
 
-  gfx->draw16bitRGBBitmap(0, 0, spiralBuffer, WIDTH, HEIGHT);
+void hypnoTeardown()
+{
+  free(leftPhase);
+  leftPhase = nullptr;
+  rightPhase = nullptr;
+  quadrantSize = 0;
+}
+
+void hypnoInvalidatePanel()
+{
+  panelStale = true;
 }
 
 #endif // ENABLE_HYPNO_SPIRAL
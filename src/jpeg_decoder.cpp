@@ -0,0 +1,683 @@
+#include "jpeg_decoder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+constexpr int FAST_BITS = 9;
+
+// Natural (row-major) position of each coefficient in zig-zag order.
+constexpr uint8_t ZIGZAG[64] = {0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+                                12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+                                35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+                                58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+// Inverse DCT constants, scaled by 2^13 (the accurate integer IDCT of the
+// IJG library).
+constexpr int CONST_BITS = 13;
+constexpr int PASS1_BITS = 2;
+constexpr int32_t FIX_0_298631336 = 2446;
+constexpr int32_t FIX_0_390180644 = 3196;
+constexpr int32_t FIX_0_541196100 = 4433;
+constexpr int32_t FIX_0_765366865 = 6270;
+constexpr int32_t FIX_0_899976223 = 7373;
+constexpr int32_t FIX_1_175875602 = 9633;
+constexpr int32_t FIX_1_501321110 = 12299;
+constexpr int32_t FIX_1_847759065 = 15137;
+constexpr int32_t FIX_1_961570560 = 16069;
+constexpr int32_t FIX_2_053119869 = 16819;
+constexpr int32_t FIX_2_562915447 = 20995;
+constexpr int32_t FIX_3_072711026 = 25172;
+
+// YCbCr to RGB factors, scaled by 2^16.
+constexpr int32_t CR_TO_R = 91881;
+constexpr int32_t CB_TO_G = 22554;
+constexpr int32_t CR_TO_G = 46802;
+constexpr int32_t CB_TO_B = 116130;
+constexpr int32_t ONE_HALF = 1 << 15;
+
+int32_t descale(int32_t x, int n)
+{
+  return (x + (1 << (n - 1))) >> n;
+}
+
+uint8_t clampSample(int32_t x)
+{
+  return static_cast<uint8_t>(x < 0 ? 0 : (x > 255 ? 255 : x));
+}
+
+uint16_t readBe16(const uint8_t *p)
+{
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+// Dequantized coefficients (natural order) to 8x8 samples.
+void inverseDct(const int32_t *in, uint8_t *out, int stride)
+{
+  int32_t workspace[64];
+
+  // Columns; the common all-AC-zero column is a constant.
+  for (int column = 0; column < 8; ++column)
+  {
+    const int32_t *c = in + column;
+    int32_t *w = workspace + column;
+    if ((c[8] | c[16] | c[24] | c[32] | c[40] | c[48] | c[56]) == 0)
+    {
+      const int32_t dc = c[0] * (1 << PASS1_BITS);
+      for (int row = 0; row < 8; ++row)
+      {
+        w[row * 8] = dc;
+      }
+      continue;
+    }
+
+    int32_t z2 = c[16];
+    int32_t z3 = c[48];
+    int32_t z1 = (z2 + z3) * FIX_0_541196100;
+    int32_t tmp2 = z1 - z3 * FIX_1_847759065;
+    int32_t tmp3 = z1 + z2 * FIX_0_765366865;
+    z2 = c[0];
+    z3 = c[32];
+    int32_t tmp0 = (z2 + z3) * (1 << CONST_BITS);
+    int32_t tmp1 = (z2 - z3) * (1 << CONST_BITS);
+    const int32_t tmp10 = tmp0 + tmp3;
+    const int32_t tmp13 = tmp0 - tmp3;
+    const int32_t tmp11 = tmp1 + tmp2;
+    const int32_t tmp12 = tmp1 - tmp2;
+
+    tmp0 = c[56];
+    tmp1 = c[40];
+    tmp2 = c[24];
+    tmp3 = c[8];
+    z1 = tmp0 + tmp3;
+    z2 = tmp1 + tmp2;
+    z3 = tmp0 + tmp2;
+    int32_t z4 = tmp1 + tmp3;
+    const int32_t z5 = (z3 + z4) * FIX_1_175875602;
+    tmp0 *= FIX_0_298631336;
+    tmp1 *= FIX_2_053119869;
+    tmp2 *= FIX_3_072711026;
+    tmp3 *= FIX_1_501321110;
+    z1 *= -FIX_0_899976223;
+    z2 *= -FIX_2_562915447;
+    z3 = z3 * -FIX_1_961570560 + z5;
+    z4 = z4 * -FIX_0_390180644 + z5;
+    tmp0 += z1 + z3;
+    tmp1 += z2 + z4;
+    tmp2 += z2 + z3;
+    tmp3 += z1 + z4;
+
+    constexpr int shift = CONST_BITS - PASS1_BITS;
+    w[0] = descale(tmp10 + tmp3, shift);
+    w[56] = descale(tmp10 - tmp3, shift);
+    w[8] = descale(tmp11 + tmp2, shift);
+    w[48] = descale(tmp11 - tmp2, shift);
+    w[16] = descale(tmp12 + tmp1, shift);
+    w[40] = descale(tmp12 - tmp1, shift);
+    w[24] = descale(tmp13 + tmp0, shift);
+    w[32] = descale(tmp13 - tmp0, shift);
+  }
+
+  // Rows, level-shifted back to 0..255.
+  constexpr int shift = CONST_BITS + PASS1_BITS + 3;
+  for (int row = 0; row < 8; ++row)
+  {
+    const int32_t *w = workspace + row * 8;
+    uint8_t *o = out + row * stride;
+    if ((w[1] | w[2] | w[3] | w[4] | w[5] | w[6] | w[7]) == 0)
+    {
+      const uint8_t dc = clampSample(descale(w[0], PASS1_BITS + 3) + 128);
+      memset(o, dc, 8);
+      continue;
+    }
+
+    int32_t z2 = w[2];
+    int32_t z3 = w[6];
+    int32_t z1 = (z2 + z3) * FIX_0_541196100;
+    int32_t tmp2 = z1 - z3 * FIX_1_847759065;
+    int32_t tmp3 = z1 + z2 * FIX_0_765366865;
+    int32_t tmp0 = (w[0] + w[4]) * (1 << CONST_BITS);
+    int32_t tmp1 = (w[0] - w[4]) * (1 << CONST_BITS);
+    const int32_t tmp10 = tmp0 + tmp3;
+    const int32_t tmp13 = tmp0 - tmp3;
+    const int32_t tmp11 = tmp1 + tmp2;
+    const int32_t tmp12 = tmp1 - tmp2;
+
+    tmp0 = w[7];
+    tmp1 = w[5];
+    tmp2 = w[3];
+    tmp3 = w[1];
+    z1 = tmp0 + tmp3;
+    z2 = tmp1 + tmp2;
+    z3 = tmp0 + tmp2;
+    int32_t z4 = tmp1 + tmp3;
+    const int32_t z5 = (z3 + z4) * FIX_1_175875602;
+    tmp0 *= FIX_0_298631336;
+    tmp1 *= FIX_2_053119869;
+    tmp2 *= FIX_3_072711026;
+    tmp3 *= FIX_1_501321110;
+    z1 *= -FIX_0_899976223;
+    z2 *= -FIX_2_562915447;
+    z3 = z3 * -FIX_1_961570560 + z5;
+    z4 = z4 * -FIX_0_390180644 + z5;
+    tmp0 += z1 + z3;
+    tmp1 += z2 + z4;
+    tmp2 += z2 + z3;
+    tmp3 += z1 + z4;
+
+    o[0] = clampSample(descale(tmp10 + tmp3, shift) + 128);
+    o[7] = clampSample(descale(tmp10 - tmp3, shift) + 128);
+    o[1] = clampSample(descale(tmp11 + tmp2, shift) + 128);
+    o[6] = clampSample(descale(tmp11 - tmp2, shift) + 128);
+    o[2] = clampSample(descale(tmp12 + tmp1, shift) + 128);
+    o[5] = clampSample(descale(tmp12 - tmp1, shift) + 128);
+    o[3] = clampSample(descale(tmp13 + tmp0, shift) + 128);
+    o[4] = clampSample(descale(tmp13 - tmp0, shift) + 128);
+  }
+}
+
+uint16_t packRgb565(int32_t r, int32_t g, int32_t b, bool swap)
+{
+  const uint16_t pixel = static_cast<uint16_t>(((clampSample(r) & 0xF8) << 8) | ((clampSample(g) & 0xFC) << 3) |
+                                               (clampSample(b) >> 3));
+  return swap ? static_cast<uint16_t>((pixel >> 8) | (pixel << 8)) : pixel;
+}
+} // namespace
+
+JpegDecoder::~JpegDecoder()
+{
+  freePlanes();
+}
+
+void JpegDecoder::freePlanes()
+{
+  free(planes_[0]);
+  planes_[0] = planes_[1] = planes_[2] = nullptr;
+  planeBytes_ = 0;
+}
+
+bool JpegDecoder::allocatePlanes()
+{
+  const uint16_t mcuWidth = static_cast<uint16_t>(8 * maxH_);
+  const uint16_t mcusX = static_cast<uint16_t>((width_ + mcuWidth - 1) / mcuWidth);
+  size_t bytes = 0;
+  for (uint8_t i = 0; i < componentCount_; ++i)
+  {
+    planeStride_[i] = static_cast<uint16_t>(mcusX * components_[i].h * 8);
+    bytes += static_cast<size_t>(planeStride_[i]) * components_[i].v * 8;
+  }
+  if (bytes > planeBytes_)
+  {
+    freePlanes();
+    planes_[0] = static_cast<uint8_t *>(malloc(bytes));
+    if (!planes_[0])
+    {
+      return false;
+    }
+    planeBytes_ = bytes;
+  }
+  for (uint8_t i = 1; i < componentCount_; ++i)
+  {
+    planes_[i] = planes_[i - 1] + static_cast<size_t>(planeStride_[i - 1]) * components_[i - 1].v * 8;
+  }
+  return true;
+}
+
+bool JpegDecoder::readFrameHeader(const uint8_t *p, size_t length)
+{
+  if (length < 6 || p[0] != 8)
+  {
+    return false;
+  }
+  height_ = readBe16(p + 1);
+  width_ = readBe16(p + 3);
+  componentCount_ = p[5];
+  if (width_ == 0 || height_ == 0 || width_ > MAX_FRAME_WIDTH || (componentCount_ != 1 && componentCount_ != 3) ||
+      length < 6 + 3 * static_cast<size_t>(componentCount_))
+  {
+    componentCount_ = 0;
+    return false;
+  }
+  maxH_ = 1;
+  maxV_ = 1;
+  for (uint8_t i = 0; i < componentCount_; ++i)
+  {
+    Component &component = components_[i];
+    component.id = p[6 + 3 * i];
+    component.h = static_cast<uint8_t>(p[7 + 3 * i] >> 4);
+    component.v = static_cast<uint8_t>(p[7 + 3 * i] & 0x0F);
+    component.quantTable = p[8 + 3 * i];
+    // A single-component scan codes one block per MCU whatever the factors.
+    if (componentCount_ == 1)
+    {
+      component.h = 1;
+      component.v = 1;
+    }
+    // Luma at full or half resolution over chroma at 1x1 only.
+    const bool chroma = i > 0;
+    if (component.h < 1 || component.h > 2 || component.v < 1 || component.v > 2 || component.quantTable > 3 ||
+        (chroma && (component.h != 1 || component.v != 1)))
+    {
+      componentCount_ = 0;
+      return false;
+    }
+    maxH_ = component.h > maxH_ ? component.h : maxH_;
+    maxV_ = component.v > maxV_ ? component.v : maxV_;
+  }
+  return allocatePlanes();
+}
+
+bool JpegDecoder::readQuantTables(const uint8_t *p, size_t length)
+{
+  while (length > 0)
+  {
+    const uint8_t precision = p[0] >> 4;
+    const uint8_t id = p[0] & 0x0F;
+    const size_t bytes = 1 + 64 * (precision ? 2 : 1);
+    if (id > 3 || precision > 1 || length < bytes)
+    {
+      return false;
+    }
+    for (int k = 0; k < 64; ++k)
+    {
+      quant_[id][k] = precision ? readBe16(p + 1 + 2 * k) : p[1 + k];
+    }
+    p += bytes;
+    length -= bytes;
+  }
+  return true;
+}
+
+bool JpegDecoder::readHuffmanTables(const uint8_t *p, size_t length)
+{
+  while (length >= 17)
+  {
+    const uint8_t tableClass = p[0] >> 4;
+    const uint8_t id = p[0] & 0x0F;
+    if (tableClass > 1 || id > 1)
+    {
+      return false;
+    }
+    size_t total = 0;
+    for (int i = 1; i <= 16; ++i)
+    {
+      total += p[i];
+    }
+    if (total > 256 || length < 17 + total)
+    {
+      return false;
+    }
+    HuffmanTable &table = tableClass ? acTables_[id] : dcTables_[id];
+    memset(table.fast, 0, sizeof(table.fast));
+    memcpy(table.values, p + 17, total);
+
+    // Canonical codes: each length continues from the last code of the one
+    // before, shifted left.
+    int32_t code = 0;
+    int32_t index = 0;
+    for (int bits = 1; bits <= 16; ++bits)
+    {
+      const uint8_t count = p[bits];
+      table.valueOffset[bits] = index - code;
+      for (uint8_t i = 0; i < count; ++i, ++code, ++index)
+      {
+        if (code >= (1 << bits))
+        {
+          return false; // more codes than fit in this length
+        }
+        if (bits <= FAST_BITS)
+        {
+          const int32_t first = code << (FAST_BITS - bits);
+          const int32_t span = 1 << (FAST_BITS - bits);
+          for (int32_t j = 0; j < span; ++j)
+          {
+            table.fast[first + j] = static_cast<uint16_t>((bits << 8) | table.values[index]);
+          }
+        }
+      }
+      table.maxCode[bits] = count ? code - 1 : -1;
+      code <<= 1;
+    }
+    table.maxCode[17] = INT32_MAX;
+    table.defined = true;
+    p += 17 + total;
+    length -= 17 + total;
+  }
+  return length == 0;
+}
+
+bool JpegDecoder::readScanHeader(const uint8_t *p, size_t length)
+{
+  if (componentCount_ == 0 || length < 1 || p[0] != componentCount_ ||
+      length < 1 + 2 * static_cast<size_t>(componentCount_) + 3)
+  {
+    return false;
+  }
+  for (uint8_t i = 0; i < componentCount_; ++i)
+  {
+    // Baseline scans list the components in frame order.
+    Component &component = components_[i];
+    const uint8_t dcTable = p[2 + 2 * i] >> 4;
+    const uint8_t acTable = p[2 + 2 * i] & 0x0F;
+    if (p[1 + 2 * i] != component.id || dcTable > 1 || acTable > 1 || !dcTables_[dcTable].defined ||
+        !acTables_[acTable].defined)
+    {
+      return false;
+    }
+    component.dcTable = dcTable;
+    component.acTable = acTable;
+    component.dcPredictor = 0;
+  }
+  const uint8_t *spectral = p + 1 + 2 * componentCount_;
+  return spectral[0] == 0 && spectral[1] == 63 && spectral[2] == 0;
+}
+
+void JpegDecoder::fillBits()
+{
+  while (bitCount_ <= 24)
+  {
+    uint32_t byte = 0;
+    if (!markerHit_ && pos_ < end_)
+    {
+      byte = *pos_;
+      if (byte != 0xFF)
+      {
+        ++pos_;
+      }
+      else if (pos_ + 1 < end_ && pos_[1] == 0x00)
+      {
+        pos_ += 2;
+      }
+      else
+      {
+        // A marker ends the entropy data; it reads as zeros from here.
+        markerHit_ = true;
+        byte = 0;
+      }
+    }
+    bitBuffer_ |= byte << (24 - bitCount_);
+    bitCount_ += 8;
+  }
+}
+
+uint32_t JpegDecoder::getBits(int count)
+{
+  fillBits();
+  const uint32_t value = bitBuffer_ >> (32 - count);
+  bitBuffer_ <<= count;
+  bitCount_ -= count;
+  return value;
+}
+
+int JpegDecoder::decodeHuffman(const HuffmanTable &table)
+{
+  fillBits();
+  const uint16_t entry = table.fast[bitBuffer_ >> (32 - FAST_BITS)];
+  if (entry)
+  {
+    const int bits = entry >> 8;
+    bitBuffer_ <<= bits;
+    bitCount_ -= bits;
+    return entry & 0xFF;
+  }
+  for (int bits = FAST_BITS + 1; bits <= 16; ++bits)
+  {
+    const int32_t code = static_cast<int32_t>(bitBuffer_ >> (32 - bits));
+    if (code <= table.maxCode[bits])
+    {
+      const int32_t index = code + table.valueOffset[bits];
+      if (index < 0 || index > 255)
+      {
+        return -1;
+      }
+      bitBuffer_ <<= bits;
+      bitCount_ -= bits;
+      return table.values[index];
+    }
+  }
+  return -1;
+}
+
+int32_t JpegDecoder::receiveExtend(int size)
+{
+  if (size == 0)
+  {
+    return 0;
+  }
+  const int32_t value = static_cast<int32_t>(getBits(size));
+  return value < (1 << (size - 1)) ? value - (1 << size) + 1 : value;
+}
+
+bool JpegDecoder::restart()
+{
+  bitBuffer_ = 0;
+  bitCount_ = 0;
+  markerHit_ = false;
+  while (pos_ + 1 < end_)
+  {
+    if (pos_[0] == 0xFF && pos_[1] >= 0xD0 && pos_[1] <= 0xD7)
+    {
+      pos_ += 2;
+      for (uint8_t i = 0; i < componentCount_; ++i)
+      {
+        components_[i].dcPredictor = 0;
+      }
+      return true;
+    }
+    ++pos_;
+  }
+  return false;
+}
+
+bool JpegDecoder::decodeBlock(Component &component, uint8_t *out, int stride)
+{
+  int32_t coefficients[64] = {};
+  const uint16_t *quant = quant_[component.quantTable];
+  const int dcSize = decodeHuffman(dcTables_[component.dcTable]);
+  if (dcSize < 0 || dcSize > 11)
+  {
+    return false;
+  }
+  component.dcPredictor += receiveExtend(dcSize);
+  coefficients[0] = component.dcPredictor * quant[0];
+
+  const HuffmanTable &acTable = acTables_[component.acTable];
+  for (int k = 1; k < 64;)
+  {
+    const int symbol = decodeHuffman(acTable);
+    if (symbol < 0)
+    {
+      return false;
+    }
+    const int run = symbol >> 4;
+    const int size = symbol & 0x0F;
+    if (size == 0)
+    {
+      if (run != 15)
+      {
+        break; // end of block
+      }
+      k += 16;
+      continue;
+    }
+    k += run;
+    if (k > 63)
+    {
+      return false;
+    }
+    coefficients[ZIGZAG[k]] = receiveExtend(size) * quant[k];
+    ++k;
+  }
+  inverseDct(coefficients, out, stride);
+  return true;
+}
+
+void JpegDecoder::convertRows(uint16_t *band, int lines) const
+{
+  const uint8_t *luma = planes_[0];
+  if (componentCount_ == 1)
+  {
+    for (int y = 0; y < lines; ++y)
+    {
+      const uint8_t *row = luma + static_cast<size_t>(y) * planeStride_[0];
+      uint16_t *out = band + static_cast<size_t>(y) * width_;
+      for (uint16_t x = 0; x < width_; ++x)
+      {
+        out[x] = packRgb565(row[x], row[x], row[x], swapBytes_);
+      }
+    }
+    return;
+  }
+
+  const int shiftX = maxH_ - 1;
+  const int shiftY = maxV_ - 1;
+  for (int y = 0; y < lines; ++y)
+  {
+    const uint8_t *yRow = luma + static_cast<size_t>(y) * planeStride_[0];
+    const size_t chromaRow = static_cast<size_t>(y >> shiftY) * planeStride_[1];
+    const uint8_t *cbRow = planes_[1] + chromaRow;
+    const uint8_t *crRow = planes_[2] + chromaRow;
+    uint16_t *out = band + static_cast<size_t>(y) * width_;
+    for (uint16_t x = 0; x < width_; ++x)
+    {
+      const int32_t luminance = yRow[x];
+      const int32_t cb = cbRow[x >> shiftX] - 128;
+      const int32_t cr = crRow[x >> shiftX] - 128;
+      const int32_t r = luminance + ((CR_TO_R * cr + ONE_HALF) >> 16);
+      const int32_t g = luminance + ((-CB_TO_G * cb - CR_TO_G * cr + ONE_HALF) >> 16);
+      const int32_t b = luminance + ((CB_TO_B * cb + ONE_HALF) >> 16);
+      out[x] = packRgb565(r, g, b, swapBytes_);
+    }
+  }
+}
+
+bool JpegDecoder::decodeScan(uint16_t *band, BandWriter writer, void *context)
+{
+  const int mcuWidth = 8 * maxH_;
+  const int mcuHeight = 8 * maxV_;
+  const int mcusX = (width_ + mcuWidth - 1) / mcuWidth;
+  const int mcusY = (height_ + mcuHeight - 1) / mcuHeight;
+  uint32_t untilRestart = restartInterval_;
+  for (int mcuY = 0; mcuY < mcusY; ++mcuY)
+  {
+    for (int mcuX = 0; mcuX < mcusX; ++mcuX)
+    {
+      if (restartInterval_ > 0)
+      {
+        if (untilRestart == 0)
+        {
+          if (!restart())
+          {
+            return false;
+          }
+          untilRestart = restartInterval_;
+        }
+        --untilRestart;
+      }
+      for (uint8_t i = 0; i < componentCount_; ++i)
+      {
+        Component &component = components_[i];
+        const int stride = planeStride_[i];
+        for (int blockY = 0; blockY < component.v; ++blockY)
+        {
+          for (int blockX = 0; blockX < component.h; ++blockX)
+          {
+            uint8_t *out = planes_[i] + static_cast<size_t>(blockY) * 8 * stride +
+                           static_cast<size_t>(mcuX * component.h + blockX) * 8;
+            if (!decodeBlock(component, out, stride))
+            {
+              return false;
+            }
+          }
+        }
+      }
+    }
+    const int y = mcuY * mcuHeight;
+    const int lines = height_ - y < mcuHeight ? height_ - y : mcuHeight;
+    convertRows(band, lines);
+    writer(context, static_cast<int16_t>(y), band, static_cast<int16_t>(width_), static_cast<int16_t>(lines));
+  }
+  return true;
+}
+
+bool JpegDecoder::decode(const uint8_t *data, size_t length, uint16_t *band, size_t bandPixels, BandWriter writer,
+                         void *context)
+{
+  if (!data || length < 4 || data[0] != 0xFF || data[1] != 0xD8)
+  {
+    return false;
+  }
+  const uint8_t *end = data + length;
+  const uint8_t *p = data + 2;
+  componentCount_ = 0;
+  restartInterval_ = 0;
+  while (p + 4 <= end)
+  {
+    if (p[0] != 0xFF)
+    {
+      return false;
+    }
+    const uint8_t marker = p[1];
+    if (marker == 0xFF)
+    {
+      ++p; // fill byte
+      continue;
+    }
+    p += 2;
+    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+    {
+      continue;
+    }
+    if (marker == 0xD9)
+    {
+      return false; // no scan
+    }
+    const size_t segment = readBe16(p);
+    if (segment < 2 || p + segment > end)
+    {
+      return false;
+    }
+    const uint8_t *body = p + 2;
+    const size_t bodyLength = segment - 2;
+    bool ok = true;
+    switch (marker)
+    {
+    case 0xC0: // baseline
+    case 0xC1: // extended sequential, Huffman
+      ok = readFrameHeader(body, bodyLength);
+      break;
+    case 0xC4:
+      ok = readHuffmanTables(body, bodyLength);
+      break;
+    case 0xDB:
+      ok = readQuantTables(body, bodyLength);
+      break;
+    case 0xDD:
+      ok = bodyLength >= 2;
+      restartInterval_ = ok ? readBe16(body) : 0;
+      break;
+    case 0xDA:
+      if (!readScanHeader(body, bodyLength) || bandPixels < static_cast<size_t>(width_) * 8 * maxV_)
+      {
+        return false;
+      }
+      pos_ = p + segment;
+      end_ = end;
+      bitBuffer_ = 0;
+      bitCount_ = 0;
+      markerHit_ = false;
+      return decodeScan(band, writer, context);
+    default:
+      // Progressive, lossless, hierarchical and arithmetic-coded frames.
+      ok = !((marker >= 0xC2 && marker <= 0xCB) || (marker >= 0xCD && marker <= 0xCF));
+      break;
+    }
+    if (!ok)
+    {
+      return false;
+    }
+    p += segment;
+  }
+  return false;
+}
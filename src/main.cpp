@@ -27,6 +27,7 @@ Arduino_DataBus *bus =
 Arduino_GFX *gfx = new Arduino_GC9A01(bus, TFT_RST, /*rotation=*/0, /*IPS=*/true);
 
 #include "config.h"
+#include "spi_bus_lock.h"
 
 #if defined(ENABLE_EYE_PROGRAM) || (!defined(ENABLE_ANIMATED_GIF) && !defined(ENABLE_HYPNO_SPIRAL))
 #define ENABLE_EYE_ANIMATION
@@ -45,6 +46,14 @@ void user_loop(void);
 #include "animated_gif_player.h"
 #endif
 
+#if defined(ENABLE_MJPEG_PLAYER)
+#include "mjpeg_player.h"
+#endif
+
+#if defined(ENABLE_RDA_PLAYER)
+#include "rda_player.h"
+#endif
+
 #if defined(ENABLE_HYPNO_SPIRAL)
 #include "hypno_spiral.h"
 #endif
@@ -57,6 +66,10 @@ EyeState eye[NUM_EYES];
 #endif
 
 uint32_t startTime = 0;
+// Arrival time of the BLE preset being applied, and of the one whose program
+// switch is in flight (0 = none); the switch logs its latency at first frame.
+uint32_t presetPacketMs = 0;
+uint32_t switchPacketMs = 0;
 
 #if defined(ENABLE_EYE_ANIMATION)
 void user_setup(void) {}
@@ -69,12 +82,18 @@ namespace
 enum class ProgramMode
 {
   Gif,
+  Mjpeg,
+  Rda,
   Eye,
   Hypno
 };
 
 ProgramMode currentProgram = ProgramMode::Gif;
 size_t gifProgramCount = 0;
+// MJPEG clips follow the GIFs in the program order, then the round delta
+// animations, then the eyes.
+size_t mjpegProgramCount = 0;
+size_t rdaProgramCount = 0;
 size_t eyeProgramCount = 0;
 size_t programIndex = 0;
 uint32_t programStartMs = 0;
@@ -95,6 +114,52 @@ struct SwirlTransitionState
 SwirlTransitionState g_swirlTransition;
 #endif
 
+// Programs in front of the eyes.
+size_t clipProgramCount()
+{
+  return gifProgramCount + mjpegProgramCount + rdaProgramCount;
+}
+
+// Programs with nothing to play are passed over by the rotation; effect
+// numbers still reach them (and fall back to the eye).
+bool programMissing(size_t index)
+{
+  if (index < gifProgramCount)
+  {
+    return animatedGifIsMissing(index);
+  }
+  index -= gifProgramCount;
+#if defined(ENABLE_MJPEG_PLAYER)
+  if (index < mjpegProgramCount)
+  {
+    return mjpegClipMissing(index);
+  }
+#endif
+  index -= mjpegProgramCount;
+#if defined(ENABLE_RDA_PLAYER)
+  if (index < rdaProgramCount)
+  {
+    return rdaClipMissing(index);
+  }
+#endif
+  return false;
+}
+
+// Program the rotation moves to after `index`.
+size_t nextProgram(size_t index)
+{
+  const size_t programCount = clipProgramCount() + eyeProgramCount;
+  for (size_t step = 1; step <= programCount; ++step)
+  {
+    const size_t candidate = (index + step) % programCount;
+    if (!programMissing(candidate))
+    {
+      return candidate;
+    }
+  }
+  return index;
+}
+
 void setProgramRotation(ProgramMode mode)
 {
   if (mode == ProgramMode::Eye)
@@ -111,12 +176,31 @@ void setProgramRotation(ProgramMode mode)
   }
 }
 
+// The spiral's phase map is only kept while the spiral program or a swirl
+// transition shows it.
+void releaseHypno()
+{
+#if defined(ENABLE_HYPNO_SPIRAL)
+  if (hypnoInitialized)
+  {
+    hypnoTeardown();
+    hypnoInitialized = false;
+  }
+#endif
+}
+
 void fallbackToDefaultEye()
 {
+  animatedGifSuspend();
+  animatedGifReleaseSnapshots();
+  releaseHypno();
   currentProgram = ProgramMode::Eye;
   activeMappedIndex = -1;
   setProgramRotation(currentProgram);
-  gfx->fillScreen(EYE_BACKGROUND_COLOR);
+  {
+    SpiBusGuard bus(SpiBusUser::Panel);
+    gfx->fillScreen(EYE_BACKGROUND_COLOR);
+  }
   const EyeAsset *asset = getEyeAsset(0);
   if (asset)
   {
@@ -129,6 +213,8 @@ void fallbackToDefaultEye()
 void enterHypno()
 {
 #if defined(ENABLE_HYPNO_SPIRAL)
+  animatedGifSuspend();
+  animatedGifReleaseSnapshots();
   if (!hypnoInitialized)
   {
     hypnoSetup();
@@ -144,32 +230,83 @@ void enterHypno()
 
 void enterProgram(size_t index)
 {
-  const size_t programCount = gifProgramCount + eyeProgramCount;
+  const size_t programCount = clipProgramCount() + eyeProgramCount;
   if (programCount == 0)
   {
     return;
   }
   programIndex = index % programCount;
   programStartMs = millis();
+  releaseHypno();
+  if (programIndex >= gifProgramCount)
+  {
+    // Nothing of the GIF player's may draw over, or read the card under,
+    // the program taking over.
+    animatedGifSuspend();
+    animatedGifReleaseSnapshots();
+  }
 
   if (gifProgramCount > 0 && programIndex < gifProgramCount)
   {
     currentProgram = ProgramMode::Gif;
     activeMappedIndex = static_cast<int16_t>(programIndex);
     setProgramRotation(currentProgram);
-    gfx->fillScreen(ANIMATED_GIF_BACKGROUND);
+    {
+      // A transition that timed out can get here while the prepare task is
+      // still reading SD.
+      SpiBusGuard bus;
+      if (!animatedGifShowSnapshot(programIndex))
+      {
+        gfx->fillScreen(ANIMATED_GIF_BACKGROUND);
+      }
+    }
     if (!animatedGifOpenAtIndex(programIndex))
     {
       fallbackToDefaultEye();
     }
   }
+#if defined(ENABLE_MJPEG_PLAYER)
+  else if (programIndex < gifProgramCount + mjpegProgramCount)
+  {
+    currentProgram = ProgramMode::Mjpeg;
+    activeMappedIndex = static_cast<int16_t>(programIndex);
+    setProgramRotation(currentProgram);
+    {
+      SpiBusGuard bus;
+      gfx->fillScreen(ANIMATED_GIF_BACKGROUND);
+    }
+    if (!mjpegOpenAtIndex(programIndex - gifProgramCount))
+    {
+      fallbackToDefaultEye();
+    }
+  }
+#endif
+#if defined(ENABLE_RDA_PLAYER)
+  else if (programIndex < clipProgramCount())
+  {
+    currentProgram = ProgramMode::Rda;
+    activeMappedIndex = static_cast<int16_t>(programIndex);
+    setProgramRotation(currentProgram);
+    {
+      SpiBusGuard bus;
+      gfx->fillScreen(ANIMATED_GIF_BACKGROUND);
+    }
+    if (!rdaOpenAtIndex(programIndex - gifProgramCount - mjpegProgramCount))
+    {
+      fallbackToDefaultEye();
+    }
+  }
+#endif
   else
   {
     currentProgram = ProgramMode::Eye;
     activeMappedIndex = -1;
     setProgramRotation(currentProgram);
-    gfx->fillScreen(EYE_BACKGROUND_COLOR);
-    const size_t eyeIndex = programIndex - gifProgramCount;
+    {
+      SpiBusGuard bus(SpiBusUser::Panel);
+      gfx->fillScreen(EYE_BACKGROUND_COLOR);
+    }
+    const size_t eyeIndex = programIndex - clipProgramCount();
     const EyeAsset *asset = getEyeAsset(eyeIndex);
     if (asset)
     {
@@ -180,27 +317,66 @@ void enterProgram(size_t index)
   }
 }
 
-void renderFirstFrame()
+void reportSwitchLatency()
 {
-  if (currentProgram == ProgramMode::Eye)
+  if (switchPacketMs == 0)
   {
-    updateEye();
     return;
   }
+  Serial.printf("Program switch: first frame %lu ms after BLE packet\n",
+                static_cast<unsigned long>(millis() - switchPacketMs));
+  switchPacketMs = 0;
+}
 
-  if (currentProgram == ProgramMode::Hypno)
+// The eye draws straight to the panel; the bus lock keeps its writes clear of
+// card reads the GIF player's tasks may still have in flight.
+void drawEyeFrame()
+{
+  SpiBusGuard bus(SpiBusUser::Panel);
+  updateEye();
+}
+
+void renderFirstFrame()
+{
+  if (currentProgram == ProgramMode::Eye)
+  {
+    drawEyeFrame();
+  }
+  else if (currentProgram == ProgramMode::Hypno)
   {
 #if defined(ENABLE_HYPNO_SPIRAL)
     hypnoStep();
 #endif
-    return;
   }
-
-  animatedGifLoop();
-  if (!animatedGifIsReady())
+#if defined(ENABLE_MJPEG_PLAYER)
+  else if (currentProgram == ProgramMode::Mjpeg)
   {
-    fallbackToDefaultEye();
+    mjpegLoop();
+    if (!mjpegIsReady())
+    {
+      fallbackToDefaultEye();
+    }
   }
+#endif
+#if defined(ENABLE_RDA_PLAYER)
+  else if (currentProgram == ProgramMode::Rda)
+  {
+    rdaLoop();
+    if (!rdaIsReady())
+    {
+      fallbackToDefaultEye();
+    }
+  }
+#endif
+  else
+  {
+    animatedGifLoop();
+    if (!animatedGifIsReady())
+    {
+      fallbackToDefaultEye();
+    }
+  }
+  reportSwitchLatency();
 }
 
 void applyMappedProgramImmediate(int16_t mappedIndex)
@@ -217,7 +393,7 @@ void applyMappedProgramImmediate(int16_t mappedIndex)
     return;
   }
 
-  if (static_cast<size_t>(mappedIndex) >= gifProgramCount)
+  if (static_cast<size_t>(mappedIndex) >= clipProgramCount())
   {
     fallbackToDefaultEye();
     return;
@@ -226,7 +402,10 @@ void applyMappedProgramImmediate(int16_t mappedIndex)
   enterProgram(static_cast<size_t>(mappedIndex));
 }
 
-void prepareMappedProgram(int16_t mappedIndex)
+// Returns true when the target is ready to show; GIF targets are opened and
+// their first frame decoded in the background (see swirlTransitionActive).
+// MJPEG and RDA clips open when the transition ends.
+bool prepareMappedProgram(int16_t mappedIndex)
 {
   if (mappedIndex == -2)
   {
@@ -237,20 +416,21 @@ void prepareMappedProgram(int16_t mappedIndex)
       hypnoInitialized = true;
     }
 #endif
-    return;
+    return true;
   }
 
   if (mappedIndex < 0)
   {
-    return;
+    return true;
   }
 
   if (static_cast<size_t>(mappedIndex) >= gifProgramCount)
   {
-    return;
+    return true;
   }
 
-  (void)animatedGifOpenAtIndex(static_cast<size_t>(mappedIndex));
+  animatedGifPrepareAsync(static_cast<size_t>(mappedIndex));
+  return false;
 }
 
 void requestMappedProgram(int16_t mappedIndex)
@@ -262,7 +442,7 @@ void requestMappedProgram(int16_t mappedIndex)
 #endif
   }
 
-  if (mappedIndex >= 0 && static_cast<size_t>(mappedIndex) >= gifProgramCount)
+  if (mappedIndex >= 0 && static_cast<size_t>(mappedIndex) >= clipProgramCount())
   {
     mappedIndex = -1;
   }
@@ -272,20 +452,27 @@ void requestMappedProgram(int16_t mappedIndex)
   {
     if (!g_swirlTransition.active && mappedIndex == activeMappedIndex)
     {
+      presetPacketMs = 0;
       return;
     }
 
     if (g_swirlTransition.active && mappedIndex == g_swirlTransition.targetMappedIndex)
     {
+      presetPacketMs = 0;
       return;
     }
 
+    switchPacketMs = presetPacketMs;
+    presetPacketMs = 0;
+
     g_swirlTransition.active = true;
     g_swirlTransition.targetMappedIndex = mappedIndex;
     g_swirlTransition.startMs = millis();
     g_swirlTransition.lastFrameMs = 0;
     g_swirlTransition.targetPrepared = false;
 
+    // The transition draws over whatever was playing.
+    animatedGifSuspend();
 #if defined(ENABLE_HYPNO_SPIRAL)
     if (!hypnoInitialized)
     {
@@ -297,17 +484,20 @@ void requestMappedProgram(int16_t mappedIndex)
     g_swirlTransition.lastFrameMs = g_swirlTransition.startMs;
 #endif
 
-    prepareMappedProgram(mappedIndex);
-    g_swirlTransition.targetPrepared = true;
+    g_swirlTransition.targetPrepared = prepareMappedProgram(mappedIndex);
     return;
   }
 #endif
 
   if (mappedIndex == activeMappedIndex)
   {
+    presetPacketMs = 0;
     return;
   }
 
+  switchPacketMs = presetPacketMs;
+  presetPacketMs = 0;
+
   applyMappedProgramImmediate(mappedIndex);
   renderFirstFrame();
 }
@@ -334,6 +524,13 @@ bool swirlTransitionActive(uint32_t now)
     g_swirlTransition.lastFrameMs = now;
   }
 
+  if (!g_swirlTransition.targetPrepared && g_swirlTransition.targetMappedIndex >= 0 &&
+      static_cast<size_t>(g_swirlTransition.targetMappedIndex) < gifProgramCount)
+  {
+    g_swirlTransition.targetPrepared =
+        animatedGifPrepareReady(static_cast<size_t>(g_swirlTransition.targetMappedIndex));
+  }
+
   const uint32_t elapsed = now - g_swirlTransition.startMs;
   uint32_t minDuration = SWIRL_TRANSITION_MIN_MS;
   uint32_t maxDuration = SWIRL_TRANSITION_DURATION_MS;
@@ -412,6 +609,7 @@ void drawCenteredLines(const UiLine *lines, size_t count)
 
 void showCenteredStatusScreen(const UiLine *lines, size_t count, uint8_t textSize = 2)
 {
+  SpiBusGuard bus(SpiBusUser::Panel);
   const uint8_t prevRotation = gfx->getRotation();
   gfx->setRotation(DISPLAY_ROTATION);
   gfx->fillScreen(BLACK);
@@ -423,7 +621,9 @@ void showCenteredStatusScreen(const UiLine *lines, size_t count, uint8_t textSiz
 // Map incoming WLED effect numbers to programs.
 // - `-1` = default eye
 // - `-2` = hypno spiral
-// - `>=0` = GIF index (must match `ANIMATED_GIF_FILES` ordering in `include/config.h`)
+// - `>=0` = GIF index (must match `ANIMATED_GIF_FILES` ordering in `include/config.h`),
+//   then MJPEG clips (`MJPEG_FILES` ordering) after the last GIF, then round
+//   delta animations (`RDA_FILES` ordering); effects pick those by path
 enum class GifProgram : int16_t
 {
   Beer = 0,
@@ -451,6 +651,37 @@ constexpr int16_t gifProgram(GifProgram program)
 {
   return static_cast<int16_t>(program);
 }
+
+#if defined(ENABLE_MJPEG_PLAYER)
+// Clips are looked up by path, so MJPEG_FILES can be reordered or trimmed;
+// one that is not listed maps to the default eye.
+int16_t mjpegProgram(const char *path)
+{
+  const size_t clip = mjpegClipIndex(path);
+  if (clip >= mjpegClipCount())
+  {
+    return kProgramDefaultEye;
+  }
+  return static_cast<int16_t>(animatedGifFileCount() + clip);
+}
+#endif
+
+#if defined(ENABLE_RDA_PLAYER)
+// Looked up by path, like the MJPEG clips.
+int16_t rdaProgram(const char *path)
+{
+  const size_t clip = rdaClipIndex(path);
+  if (clip >= rdaClipCount())
+  {
+    return kProgramDefaultEye;
+  }
+#if defined(ENABLE_MJPEG_PLAYER)
+  return static_cast<int16_t>(animatedGifFileCount() + mjpegClipCount() + clip);
+#else
+  return static_cast<int16_t>(animatedGifFileCount() + clip);
+#endif
+}
+#endif
 constexpr bool kEnableAutoSwitch = false;
 
 int16_t mapEffectToProgram(uint8_t effect)
@@ -491,6 +722,22 @@ int16_t mapEffectToProgram(uint8_t effect)
     return gifProgram(GifProgram::Drop2);
   case 17:
     return gifProgram(GifProgram::Drop1);
+#if defined(ENABLE_MJPEG_PLAYER)
+  case 18:
+    return mjpegProgram("/fish.mjpeg");
+  case 19:
+    return mjpegProgram("/hearth.mjpeg");
+  case 20:
+    return mjpegProgram("/beer.mjpeg");
+#endif
+#if defined(ENABLE_RDA_PLAYER)
+  case 21:
+    return rdaProgram("/fish.rda");
+  case 22:
+    return rdaProgram("/drop1.rda");
+  case 23:
+    return rdaProgram("/optical1.rda");
+#endif
   default:
     return kProgramDefaultEye;
   }
@@ -905,6 +1152,8 @@ void setBleGroupFilter(uint64_t groupKey, bool persist)
   g_blePairUiDirty = false;
   g_blePairUiNextRefreshMs = (refreshMs > 0) ? (now + refreshMs) : 0;
 
+  // The GIF player's tasks may still be reading the card.
+  SpiBusGuard bus(SpiBusUser::Panel);
   const uint8_t prevRotation = gfx->getRotation();
   gfx->setRotation(DISPLAY_ROTATION);
   gfx->fillScreen(BLACK);
@@ -1204,6 +1453,7 @@ class BleSyncCallbacks : public NimBLEAdvertisedDeviceCallbacks
   }
   const uint8_t effect = g_bleEffect;
   const uint32_t timebase = g_bleTimebase;
+  const uint32_t packetMs = g_bleLastMs;
   const uint64_t groupKey = g_bleLastGroup;
   g_blePending = false;
 
@@ -1242,6 +1492,10 @@ class BleSyncCallbacks : public NimBLEAdvertisedDeviceCallbacks
 #endif
 	    return;
 	  }
+#if defined(ENABLE_ANIMATED_GIF)
+	  animatedGifSyncTimebase(timebase, packetMs);
+#endif
+	  presetPacketMs = packetMs;
 	  applyMappedProgram(effect);
 	}
 
@@ -1329,22 +1583,12 @@ bool sdFindReadableFile(char *outPath, size_t outPathLen)
   }
   outPath[0] = '\0';
 
-  const char *const candidates[] = ANIMATED_GIF_FILES;
-  const size_t candidateCount = sizeof(candidates) / sizeof(candidates[0]);
-  for (size_t i = 0; i < candidateCount; ++i)
+  const char *playable = animatedGifFirstPlayableFile();
+  if (playable)
   {
-    File probe = SD.open(candidates[i], FILE_READ);
-    if (probe && !probe.isDirectory())
-    {
-      strncpy(outPath, candidates[i], outPathLen - 1);
-      outPath[outPathLen - 1] = '\0';
-      probe.close();
-      return true;
-    }
-    if (probe)
-    {
-      probe.close();
-    }
+    strncpy(outPath, playable, outPathLen - 1);
+    outPath[outPathLen - 1] = '\0';
+    return true;
   }
 
   File root = SD.open("/");
@@ -1808,6 +2052,22 @@ void otaLoop()
 void otaSetup() {}
 void otaLoop() {}
 #endif
+
+// One-letter commands over the USB serial port: 't' prints the GIF
+// telemetry, 'T' prints it and starts it over.
+void serialCommandLoop()
+{
+#if defined(ENABLE_ANIMATED_GIF)
+  while (Serial.available() > 0)
+  {
+    const int command = Serial.read();
+    if (command == 't' || command == 'T')
+    {
+      animatedGifDumpTelemetry(command == 'T');
+    }
+  }
+#endif
+}
 } // namespace
 
 void setup()
@@ -1915,14 +2175,20 @@ void setup()
   Serial.println("Animated GIF initialized");
 #if defined(ENABLE_ANIMATED_GIF) && defined(ENABLE_EYE_PROGRAM)
   gifProgramCount = animatedGifFileCount();
+#if defined(ENABLE_MJPEG_PLAYER)
+  mjpegProgramCount = mjpegClipCount();
+#endif
+#if defined(ENABLE_RDA_PLAYER)
+  rdaProgramCount = rdaClipCount();
+#endif
   eyeProgramCount = eyeAssetCount();
   if (eyeProgramCount > 0)
   {
-    enterProgram(gifProgramCount); // start on the default eye (eye index 0)
+    enterProgram(clipProgramCount()); // start on the default eye (eye index 0)
   }
   else
   {
-    enterProgram(0);
+    enterProgram(programMissing(0) ? nextProgram(0) : 0);
   }
 #endif
 #elif defined(ENABLE_HYPNO_SPIRAL)
@@ -1937,12 +2203,26 @@ void setup()
 void loop()
 {
   otaLoop();
+  serialCommandLoop();
 
   bleSyncLoop();
+  static bool pairUiShown = false;
   if (blePairingUiLoop())
   {
+    pairUiShown = true;
     return;
   }
+  if (pairUiShown)
+  {
+    // The GIF or spiral resumes over what is left of the pairing screen.
+    pairUiShown = false;
+#if defined(ENABLE_ANIMATED_GIF)
+    animatedGifInvalidatePanel();
+#endif
+#if defined(ENABLE_HYPNO_SPIRAL)
+    hypnoInvalidatePanel();
+#endif
+  }
 #if defined(ENABLE_ANIMATED_GIF) && defined(ENABLE_EYE_PROGRAM)
   const uint32_t now = millis();
   if (swirlTransitionActive(now))
@@ -1952,12 +2232,12 @@ void loop()
   if (kEnableAutoSwitch && !bleSyncHasLock() && ANIMATED_GIF_SWITCH_INTERVAL_MS > 0 &&
       (now - programStartMs) >= ANIMATED_GIF_SWITCH_INTERVAL_MS)
   {
-    enterProgram(programIndex + 1);
+    enterProgram(nextProgram(programIndex));
   }
 
   if (currentProgram == ProgramMode::Eye)
   {
-    updateEye();
+    drawEyeFrame();
   }
   else if (currentProgram == ProgramMode::Hypno)
   {
@@ -1965,6 +2245,26 @@ void loop()
     hypnoStep();
 #endif
   }
+#if defined(ENABLE_MJPEG_PLAYER)
+  else if (currentProgram == ProgramMode::Mjpeg)
+  {
+    mjpegLoop();
+    if (!mjpegIsReady())
+    {
+      fallbackToDefaultEye();
+    }
+  }
+#endif
+#if defined(ENABLE_RDA_PLAYER)
+  else if (currentProgram == ProgramMode::Rda)
+  {
+    rdaLoop();
+    if (!rdaIsReady())
+    {
+      fallbackToDefaultEye();
+    }
+  }
+#endif
   else
   {
     animatedGifLoop();
@@ -0,0 +1,335 @@
+#include "mjpeg_index.h"
+
+#include <Arduino.h>
+#include <SD.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "psram_alloc.h"
+#include "spi_bus_lock.h"
+
+namespace
+{
+constexpr size_t MAX_PATH = 64;
+constexpr size_t SCAN_BUFFER_BYTES = 4096;
+constexpr uint16_t INITIAL_FRAMES = 64;
+
+bool sidecarPath(const char *clipPath, char *path)
+{
+  const int length = snprintf(path, MAX_PATH, "%s.idx", clipPath);
+  return length > 0 && static_cast<size_t>(length) < MAX_PATH;
+}
+
+// Buffered byte reader over the clip for the frame scan.
+struct ClipReader
+{
+  File &file;
+  uint8_t *buffer;
+  size_t length;
+  size_t index;
+  uint32_t base;
+
+  uint32_t position() const { return base + static_cast<uint32_t>(index); }
+
+  int next()
+  {
+    if (index == length)
+    {
+      base += static_cast<uint32_t>(length);
+      SpiBusGuard bus(SpiBusUser::Sd);
+      const int bytesRead = file.read(buffer, SCAN_BUFFER_BYTES);
+      length = bytesRead > 0 ? static_cast<size_t>(bytesRead) : 0;
+      index = 0;
+      if (length == 0)
+      {
+        return -1;
+      }
+    }
+    return buffer[index++];
+  }
+
+  bool skip(uint32_t count)
+  {
+    if (count <= length - index)
+    {
+      index += count;
+      return true;
+    }
+    base = position() + count;
+    index = 0;
+    length = 0;
+    SpiBusGuard bus(SpiBusUser::Sd);
+    return file.seek(base);
+  }
+};
+
+// Reads one marker segment after its marker byte; SOS sets `entropy`.
+bool readSegment(ClipReader &reader, int marker, bool &entropy, uint16_t &width, uint16_t &height)
+{
+  if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+  {
+    return true;
+  }
+  const int high = reader.next();
+  const int low = reader.next();
+  if (high < 0 || low < 0 || ((high << 8) | low) < 2)
+  {
+    return false;
+  }
+  uint32_t remaining = static_cast<uint32_t>((high << 8) | low) - 2;
+  if ((marker == 0xC0 || marker == 0xC1 || marker == 0xC2) && remaining >= 5 && width == 0)
+  {
+    uint8_t header[5];
+    for (uint8_t &byte : header)
+    {
+      const int value = reader.next();
+      if (value < 0)
+      {
+        return false;
+      }
+      byte = static_cast<uint8_t>(value);
+    }
+    height = static_cast<uint16_t>((header[1] << 8) | header[2]);
+    width = static_cast<uint16_t>((header[3] << 8) | header[4]);
+    remaining -= 5;
+  }
+  entropy = marker == 0xDA;
+  return reader.skip(remaining);
+}
+
+// Follows one frame from just after its SOI to just after its EOI.
+bool scanFrame(ClipReader &reader, uint16_t &width, uint16_t &height)
+{
+  bool entropy = false;
+  for (;;)
+  {
+    int value = reader.next();
+    if (value < 0)
+    {
+      return false;
+    }
+    if (value != 0xFF)
+    {
+      if (entropy)
+      {
+        continue;
+      }
+      return false;
+    }
+    do
+    {
+      value = reader.next();
+    } while (value == 0xFF);
+    if (value < 0 || value == 0xD8)
+    {
+      return false;
+    }
+    if (value == 0xD9)
+    {
+      return true;
+    }
+    // Stuffed zeros and restart markers stay inside the entropy data.
+    if (entropy && (value == 0x00 || (value >= 0xD0 && value <= 0xD7)))
+    {
+      continue;
+    }
+    if (!readSegment(reader, value, entropy, width, height))
+    {
+      return false;
+    }
+  }
+}
+} // namespace
+
+void MjpegIndex::clear()
+{
+  free(frames_);
+  frames_ = nullptr;
+  frameCount_ = 0;
+  width_ = 0;
+  height_ = 0;
+  maxFrameLength_ = 0;
+}
+
+bool MjpegIndex::allocate(uint16_t frameCount)
+{
+  clear();
+  if (frameCount == 0)
+  {
+    return false;
+  }
+  frames_ = static_cast<MjpegFrameInfo *>(psramAlloc(frameCount * sizeof(MjpegFrameInfo)));
+  if (!frames_)
+  {
+    return false;
+  }
+  frameCount_ = frameCount;
+  return true;
+}
+
+void MjpegIndex::finish()
+{
+  maxFrameLength_ = 0;
+  for (uint16_t i = 0; i < frameCount_; ++i)
+  {
+    if (frames_[i].length > maxFrameLength_)
+    {
+      maxFrameLength_ = frames_[i].length;
+    }
+  }
+}
+
+bool MjpegIndex::load(const char *path, uint32_t fileSize)
+{
+  SpiBusGuard bus;
+  if (!SD.exists(path))
+  {
+    return false;
+  }
+  File file = SD.open(path, FILE_READ);
+  if (!file)
+  {
+    return false;
+  }
+  MjpegIndexHeader header = {};
+  bool ok = file.read(reinterpret_cast<uint8_t *>(&header), sizeof(header)) == sizeof(header) &&
+            header.magic == MAGIC && header.version == VERSION && header.fileSize == fileSize &&
+            allocate(header.frameCount);
+  if (ok)
+  {
+    const size_t bytes = static_cast<size_t>(frameCount_) * sizeof(MjpegFrameInfo);
+    ok = static_cast<size_t>(file.read(reinterpret_cast<uint8_t *>(frames_), bytes)) == bytes;
+  }
+  file.close();
+  for (uint16_t i = 0; ok && i < frameCount_; ++i)
+  {
+    ok = frames_[i].length > 0 && frames_[i].offset <= fileSize && frames_[i].length <= fileSize - frames_[i].offset;
+  }
+  if (!ok)
+  {
+    clear();
+    return false;
+  }
+  width_ = header.width;
+  height_ = header.height;
+  return true;
+}
+
+bool MjpegIndex::save(const char *path, uint32_t fileSize) const
+{
+  SpiBusGuard bus;
+  File file = SD.open(path, FILE_WRITE);
+  if (!file)
+  {
+    return false;
+  }
+  const MjpegIndexHeader header = {MAGIC, VERSION, frameCount_, fileSize, width_, height_};
+  const size_t bytes = static_cast<size_t>(frameCount_) * sizeof(MjpegFrameInfo);
+  const bool ok = file.write(reinterpret_cast<const uint8_t *>(&header), sizeof(header)) == sizeof(header) &&
+                  file.write(reinterpret_cast<const uint8_t *>(frames_), bytes) == bytes;
+  file.close();
+  if (!ok)
+  {
+    SD.remove(path);
+  }
+  return ok;
+}
+
+bool MjpegIndex::scan(const char *clipPath, uint16_t defaultDelayMs)
+{
+  clear();
+  File file;
+  {
+    SpiBusGuard bus(SpiBusUser::Sd);
+    file = SD.open(clipPath, FILE_READ);
+  }
+  uint8_t *buffer = static_cast<uint8_t *>(malloc(SCAN_BUFFER_BYTES));
+  if (!file || !buffer)
+  {
+    free(buffer);
+    return false;
+  }
+
+  ClipReader reader = {file, buffer, 0, 0, 0};
+  uint16_t capacity = 0;
+  int previous = -1;
+  for (;;)
+  {
+    const int value = reader.next();
+    if (value < 0)
+    {
+      break;
+    }
+    // Anything between frames is skipped up to the next SOI.
+    if (previous != 0xFF || value != 0xD8)
+    {
+      previous = value;
+      continue;
+    }
+    previous = -1;
+    const uint32_t start = reader.position() - 2;
+    if (!scanFrame(reader, width_, height_))
+    {
+      break;
+    }
+    if (frameCount_ == capacity)
+    {
+      if (capacity == UINT16_MAX)
+      {
+        break;
+      }
+      const uint16_t grown = capacity == 0 ? INITIAL_FRAMES
+                                           : static_cast<uint16_t>(capacity > UINT16_MAX / 2 ? UINT16_MAX : capacity * 2);
+      MjpegFrameInfo *frames = static_cast<MjpegFrameInfo *>(psramAlloc(grown * sizeof(MjpegFrameInfo)));
+      if (!frames)
+      {
+        break;
+      }
+      if (frames_)
+      {
+        memcpy(frames, frames_, frameCount_ * sizeof(MjpegFrameInfo));
+        free(frames_);
+      }
+      frames_ = frames;
+      capacity = grown;
+    }
+    frames_[frameCount_++] = {start, reader.position() - start, defaultDelayMs, 0};
+  }
+  free(buffer);
+  {
+    SpiBusGuard bus(SpiBusUser::Sd);
+    file.close();
+  }
+  if (frameCount_ == 0)
+  {
+    clear();
+    return false;
+  }
+  return true;
+}
+
+bool MjpegIndex::loadOrBuild(const char *clipPath, uint32_t fileSize, uint16_t defaultDelayMs)
+{
+  char path[MAX_PATH];
+  if (!sidecarPath(clipPath, path))
+  {
+    return false;
+  }
+  if (load(path, fileSize))
+  {
+    finish();
+    return true;
+  }
+
+  const uint32_t start = millis();
+  if (!scan(clipPath, defaultDelayMs))
+  {
+    return false;
+  }
+  finish();
+  const bool saved = save(path, fileSize);
+  Serial.printf("MJPEG: indexed %u frames of %s in %lu ms%s\n", static_cast<unsigned>(frameCount_), clipPath,
+                static_cast<unsigned long>(millis() - start), saved ? "" : " (sidecar not written)");
+  return true;
+}
@@ -0,0 +1,271 @@
+#include "mjpeg_player.h"
+
+#include <Arduino.h>
+#include <Arduino_GFX_Library.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+#if !defined(ENABLE_MJPEG_PLAYER)
+
+size_t mjpegClipCount() { return 0; }
+size_t mjpegClipIndex(const char *) { return SIZE_MAX; }
+bool mjpegClipMissing(size_t) { return false; }
+bool mjpegOpenAtIndex(size_t) { return false; }
+void mjpegLoop() {}
+bool mjpegIsReady() { return false; }
+
+#else
+
+#include <SD.h>
+
+#include "jpeg_decoder.h"
+#include "mjpeg_index.h"
+#include "panel_pixels.h"
+#include "psram_alloc.h"
+#include "spi_bus_lock.h"
+
+extern Arduino_GFX *gfx;
+
+namespace
+{
+const char *const kMjpegFiles[] = MJPEG_FILES;
+constexpr size_t kMjpegFileCount = sizeof(kMjpegFiles) / sizeof(kMjpegFiles[0]);
+
+// Frame tables stay loaded once read, so switching back does not rescan.
+MjpegIndex clipIndexes[kMjpegFileCount];
+// Looked up on the card once; the list is fixed at build time.
+bool clipChecked[kMjpegFileCount] = {};
+bool clipAbsent[kMjpegFileCount] = {};
+JpegDecoder decoder;
+File clipFile;
+size_t loadedClip = SIZE_MAX;
+bool clipReady = false;
+uint16_t frameNumber = 0;
+int16_t offsetX = 0;
+int16_t offsetY = 0;
+
+// Compressed frame, read from the card in one piece (PSRAM).
+uint8_t *frameData = nullptr;
+uint32_t frameDataSize = 0;
+// One MCU row of decoded pixels, in internal RAM for the panel DMA.
+alignas(4) uint16_t bandBuffer[DISPLAY_WIDTH * JpegDecoder::MAX_BAND_LINES];
+
+uint32_t lastFrameMillis = 0;
+uint16_t lastFrameDelay = 0;
+
+uint32_t statsFrames = 0;
+uint32_t statsBytes = 0;
+uint32_t statsReadMicros = 0;
+uint32_t statsDecodeMicros = 0;
+uint32_t statsDecodeMax = 0;
+uint32_t lastStatsMillis = 0;
+
+void resetStats()
+{
+  statsFrames = 0;
+  statsBytes = 0;
+  statsReadMicros = 0;
+  statsDecodeMicros = 0;
+  statsDecodeMax = 0;
+  lastStatsMillis = millis();
+}
+
+void reportStats(uint32_t now)
+{
+  if (ANIMATED_GIF_STATS_INTERVAL_MS == 0 || statsFrames == 0 ||
+      (now - lastStatsMillis) < static_cast<uint32_t>(ANIMATED_GIF_STATS_INTERVAL_MS))
+  {
+    return;
+  }
+  Serial.printf("MJPEG: %s decode avg %lu us/frame, max %lu us, read %lu us/frame, %lu bytes/frame (%lu frames)\n",
+                kMjpegFiles[loadedClip], static_cast<unsigned long>(statsDecodeMicros / statsFrames),
+                static_cast<unsigned long>(statsDecodeMax), static_cast<unsigned long>(statsReadMicros / statsFrames),
+                static_cast<unsigned long>(statsBytes / statsFrames), static_cast<unsigned long>(statsFrames));
+  resetStats();
+}
+
+void writeBand(void *, int16_t y, uint16_t *pixels, int16_t width, int16_t lines)
+{
+  // The GIF player's I/O task may be reading the card on the other core.
+  SpiBusGuard bus(SpiBusUser::Panel);
+  drawPanelPixels(gfx, offsetX, static_cast<int16_t>(offsetY + y), pixels, width, lines);
+}
+
+void closeClip()
+{
+  clipReady = false;
+  loadedClip = SIZE_MAX;
+  if (clipFile)
+  {
+    SpiBusGuard bus(SpiBusUser::Sd);
+    clipFile.close();
+  }
+}
+
+bool openClip(size_t index)
+{
+  closeClip();
+  const char *path = kMjpegFiles[index];
+  uint32_t fileSize = 0;
+  {
+    SpiBusGuard bus(SpiBusUser::Sd);
+    clipFile = SD.open(path, FILE_READ);
+    fileSize = clipFile ? static_cast<uint32_t>(clipFile.size()) : 0;
+  }
+  if (!clipFile)
+  {
+    Serial.printf("MJPEG: failed to open %s\n", path);
+    return false;
+  }
+
+  MjpegIndex &frames = clipIndexes[index];
+  if (!frames.valid() && !frames.loadOrBuild(path, fileSize, MJPEG_DEFAULT_DELAY))
+  {
+    Serial.printf("MJPEG: no frames in %s\n", path);
+    closeClip();
+    return false;
+  }
+  if (frames.width() == 0 || frames.width() > DISPLAY_WIDTH || frames.height() > DISPLAY_HEIGHT)
+  {
+    Serial.printf("MJPEG: %s is %ux%u, larger than the panel\n", path, static_cast<unsigned>(frames.width()),
+                  static_cast<unsigned>(frames.height()));
+    closeClip();
+    return false;
+  }
+  if (!psramReserve(frameData, frameDataSize, frames.maxFrameLength()))
+  {
+    Serial.printf("MJPEG: no memory for %lu byte frames\n", static_cast<unsigned long>(frames.maxFrameLength()));
+    closeClip();
+    return false;
+  }
+
+  offsetX = static_cast<int16_t>((DISPLAY_WIDTH - frames.width()) / 2);
+  offsetY = static_cast<int16_t>((DISPLAY_HEIGHT - frames.height()) / 2);
+  loadedClip = index;
+  frameNumber = 0;
+  lastFrameMillis = millis();
+  lastFrameDelay = 0;
+  clipReady = true;
+  resetStats();
+  Serial.printf("MJPEG: %s, %u frames at %ux%u\n", path, static_cast<unsigned>(frames.frameCount()),
+                static_cast<unsigned>(frames.width()), static_cast<unsigned>(frames.height()));
+  return true;
+}
+
+bool readFrame(const MjpegFrameInfo &frame)
+{
+  SpiBusGuard bus(SpiBusUser::Sd);
+  return clipFile.seek(frame.offset) &&
+         clipFile.read(frameData, frame.length) == static_cast<int>(frame.length);
+}
+} // namespace
+
+size_t mjpegClipCount()
+{
+  return kMjpegFileCount;
+}
+
+size_t mjpegClipIndex(const char *path)
+{
+  for (size_t i = 0; i < kMjpegFileCount; ++i)
+  {
+    if (strcmp(kMjpegFiles[i], path) == 0)
+    {
+      return i;
+    }
+  }
+  return SIZE_MAX;
+}
+
+bool mjpegClipMissing(size_t index)
+{
+  if (index >= kMjpegFileCount)
+  {
+    return true;
+  }
+  if (!clipChecked[index])
+  {
+    {
+      SpiBusGuard bus(SpiBusUser::Sd);
+      clipAbsent[index] = !SD.exists(kMjpegFiles[index]);
+    }
+    clipChecked[index] = true;
+    if (clipAbsent[index])
+    {
+      Serial.printf("MJPEG: %s is not on the card\n", kMjpegFiles[index]);
+    }
+  }
+  return clipAbsent[index];
+}
+
+bool mjpegOpenAtIndex(size_t index)
+{
+  if (index >= kMjpegFileCount)
+  {
+    return false;
+  }
+  if (clipReady && index == loadedClip)
+  {
+    lastFrameMillis = millis();
+    lastFrameDelay = 0;
+    return true;
+  }
+  decoder.setSwapBytes(PANEL_NATIVE_PIXELS);
+  return openClip(index);
+}
+
+void mjpegLoop()
+{
+  if (!clipReady)
+  {
+    return;
+  }
+  const uint32_t now = millis();
+  if (now - lastFrameMillis < lastFrameDelay)
+  {
+    return;
+  }
+
+  const MjpegIndex &index = clipIndexes[loadedClip];
+  const MjpegFrameInfo &frame = index.frame(frameNumber);
+  const uint32_t readStart = micros();
+  if (!readFrame(frame))
+  {
+    Serial.printf("MJPEG: read of frame %u of %s failed\n", static_cast<unsigned>(frameNumber),
+                  kMjpegFiles[loadedClip]);
+    closeClip();
+    return;
+  }
+  const uint32_t decodeStart = micros();
+  if (!decoder.decode(frameData, frame.length, bandBuffer, sizeof(bandBuffer) / sizeof(bandBuffer[0]), writeBand,
+                      nullptr))
+  {
+    // A damaged frame leaves the previous one partly on screen; carry on.
+    Serial.printf("MJPEG: frame %u of %s did not decode\n", static_cast<unsigned>(frameNumber),
+                  kMjpegFiles[loadedClip]);
+  }
+  const uint32_t decodeMicros = micros() - decodeStart;
+
+  ++statsFrames;
+  statsBytes += frame.length;
+  statsReadMicros += decodeStart - readStart;
+  statsDecodeMicros += decodeMicros;
+  if (decodeMicros > statsDecodeMax)
+  {
+    statsDecodeMax = decodeMicros;
+  }
+
+  lastFrameMillis = now;
+  lastFrameDelay = frame.delayMs ? frame.delayMs : MJPEG_DEFAULT_DELAY;
+  frameNumber = static_cast<uint16_t>((frameNumber + 1) % index.frameCount());
+  reportStats(now);
+}
+
+bool mjpegIsReady()
+{
+  return clipReady;
+}
+
+#endif
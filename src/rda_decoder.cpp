@@ -0,0 +1,236 @@
+#include "rda_decoder.h"
+
+#include <string.h>
+
+namespace
+{
+uint32_t isqrt(uint32_t value)
+{
+  uint32_t root = 0;
+  uint32_t bit = 1u << 30;
+  while (bit > value)
+  {
+    bit >>= 2;
+  }
+  while (bit != 0)
+  {
+    if (value >= root + bit)
+    {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else
+    {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+uint16_t swap16(uint16_t value)
+{
+  return static_cast<uint16_t>((value >> 8) | (value << 8));
+}
+} // namespace
+
+void RdaDecoder::rowSpan(uint16_t width, uint16_t height, uint16_t y, uint16_t &x0, uint16_t &x1)
+{
+  // In half pixels from the centre: pixel x is inside when
+  // (2x + 1 - width)^2 + (2y + 1 - height)^2 <= (diameter + 1)^2.
+  const int32_t diameter = width < height ? width : height;
+  const int32_t dy = 2 * static_cast<int32_t>(y) + 1 - height;
+  const int32_t limit = (diameter + 1) * (diameter + 1) - dy * dy;
+  x0 = 0;
+  x1 = 0;
+  if (limit < 0)
+  {
+    return;
+  }
+  const int32_t reach = static_cast<int32_t>(isqrt(static_cast<uint32_t>(limit)));
+  const int32_t first = width - 1 - reach <= 0 ? 0 : (width - reach) / 2;
+  const int32_t last = (width - 1 + reach) / 2 + 1;
+  x0 = static_cast<uint16_t>(first);
+  x1 = static_cast<uint16_t>(last > width ? width : last);
+}
+
+bool RdaDecoder::expand(const uint16_t *&p, const uint16_t *end, uint16_t type, uint16_t count,
+                        uint16_t *out) const
+{
+  if (type == OP_COPY)
+  {
+    if (end - p < count)
+    {
+      return false;
+    }
+    if (swapBytes_)
+    {
+      memcpy(out, p, count * sizeof(uint16_t));
+    }
+    else
+    {
+      for (uint16_t i = 0; i < count; ++i)
+      {
+        out[i] = swap16(p[i]);
+      }
+    }
+    p += count;
+    return true;
+  }
+  if (type == OP_FILL)
+  {
+    if (p == end)
+    {
+      return false;
+    }
+    const uint16_t pixel = swapBytes_ ? *p : swap16(*p);
+    ++p;
+    for (uint16_t i = 0; i < count; ++i)
+    {
+      out[i] = pixel;
+    }
+    return true;
+  }
+  return false;
+}
+
+bool RdaDecoder::decode(const uint8_t *data, size_t length, uint16_t *band, size_t bandPixels, uint16_t background,
+                        Writer writer, void *context) const
+{
+  if (width_ == 0 || bandPixels < width_ || (length & 1) != 0 || (reinterpret_cast<uintptr_t>(data) & 1) != 0)
+  {
+    return false;
+  }
+  const uint16_t *p = reinterpret_cast<const uint16_t *>(data);
+  const uint16_t *end = p + length / 2;
+  if (p == end)
+  {
+    return true;
+  }
+  const size_t bandLines = bandPixels / width_;
+  int16_t bandY = 0;
+  int16_t bandRows = 0;
+  int32_t lastY = -1;
+  const uint16_t rowCount = *p++;
+
+  for (uint16_t row = 0; row < rowCount; ++row)
+  {
+    if (end - p < 2)
+    {
+      return false;
+    }
+    const bool hasSkips = (*p & ROW_HAS_SKIPS) != 0;
+    const uint16_t y = static_cast<uint16_t>(*p & ~ROW_HAS_SKIPS);
+    const uint16_t opCount = p[1];
+    p += 2;
+    if (y >= height_ || static_cast<int32_t>(y) <= lastY)
+    {
+      return false;
+    }
+    lastY = y;
+    uint16_t x0;
+    uint16_t x1;
+    rowSpan(width_, height_, y, x0, x1);
+
+    if (!hasSkips)
+    {
+      // Consecutive whole rows go out as one band; the corners are outside
+      // the panel's circle, so they take the background.
+      if (bandRows > 0 && (bandY + bandRows != y || static_cast<size_t>(bandRows) == bandLines))
+      {
+        writer(context, 0, bandY, band, static_cast<int16_t>(width_), bandRows);
+        bandRows = 0;
+      }
+      if (bandRows == 0)
+      {
+        bandY = static_cast<int16_t>(y);
+      }
+      uint16_t *out = band + static_cast<size_t>(bandRows) * width_;
+      for (uint16_t x = 0; x < x0; ++x)
+      {
+        out[x] = background;
+      }
+      for (uint16_t x = x1; x < width_; ++x)
+      {
+        out[x] = background;
+      }
+      uint16_t x = x0;
+      for (uint16_t op = 0; op < opCount; ++op)
+      {
+        if (p == end)
+        {
+          return false;
+        }
+        const uint16_t type = static_cast<uint16_t>(*p >> OP_SHIFT);
+        const uint16_t count = static_cast<uint16_t>(*p & OP_COUNT_MASK);
+        ++p;
+        if (count > x1 - x || !expand(p, end, type, count, out + x))
+        {
+          return false;
+        }
+        x = static_cast<uint16_t>(x + count);
+      }
+      if (x != x1)
+      {
+        return false;
+      }
+      ++bandRows;
+      continue;
+    }
+
+    if (bandRows > 0)
+    {
+      writer(context, 0, bandY, band, static_cast<int16_t>(width_), bandRows);
+      bandRows = 0;
+    }
+    // Each run between skips is gathered and written on its own.
+    uint16_t x = x0;
+    uint16_t runStart = x0;
+    uint16_t runLength = 0;
+    for (uint16_t op = 0; op < opCount; ++op)
+    {
+      if (p == end)
+      {
+        return false;
+      }
+      const uint16_t type = static_cast<uint16_t>(*p >> OP_SHIFT);
+      const uint16_t count = static_cast<uint16_t>(*p & OP_COUNT_MASK);
+      ++p;
+      if (count > x1 - x)
+      {
+        return false;
+      }
+      if (type == OP_SKIP)
+      {
+        if (runLength > 0)
+        {
+          writer(context, static_cast<int16_t>(runStart), static_cast<int16_t>(y), band,
+                 static_cast<int16_t>(runLength), 1);
+          runLength = 0;
+        }
+        x = static_cast<uint16_t>(x + count);
+        continue;
+      }
+      if (runLength == 0)
+      {
+        runStart = x;
+      }
+      if (!expand(p, end, type, count, band + runLength))
+      {
+        return false;
+      }
+      runLength = static_cast<uint16_t>(runLength + count);
+      x = static_cast<uint16_t>(x + count);
+    }
+    if (runLength > 0)
+    {
+      writer(context, static_cast<int16_t>(runStart), static_cast<int16_t>(y), band, static_cast<int16_t>(runLength),
+             1);
+    }
+  }
+  if (bandRows > 0)
+  {
+    writer(context, 0, bandY, band, static_cast<int16_t>(width_), bandRows);
+  }
+  return true;
+}
@@ -0,0 +1,329 @@
+#include "rda_player.h"
+
+#include <Arduino.h>
+#include <Arduino_GFX_Library.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+
+#if !defined(ENABLE_RDA_PLAYER)
+
+size_t rdaClipCount() { return 0; }
+size_t rdaClipIndex(const char *) { return SIZE_MAX; }
+bool rdaClipMissing(size_t) { return false; }
+bool rdaOpenAtIndex(size_t) { return false; }
+void rdaLoop() {}
+bool rdaIsReady() { return false; }
+
+#else
+
+#include <SD.h>
+
+#include "panel_pixels.h"
+#include "psram_alloc.h"
+#include "rda_decoder.h"
+#include "spi_bus_lock.h"
+
+extern Arduino_GFX *gfx;
+
+namespace
+{
+const char *const kRdaFiles[] = RDA_FILES;
+constexpr size_t kRdaFileCount = sizeof(kRdaFiles) / sizeof(kRdaFiles[0]);
+// Looked up on the card once; the list is fixed at build time.
+bool clipChecked[kRdaFileCount] = {};
+bool clipAbsent[kRdaFileCount] = {};
+
+RdaDecoder decoder;
+File clipFile;
+size_t loadedClip = SIZE_MAX;
+bool clipReady = false;
+int16_t offsetX = 0;
+int16_t offsetY = 0;
+
+// Frame table of the open clip (frameCount + 1 entries, PSRAM) and the
+// entry to show next; after the last frame comes the one back to frame 0,
+// then frame 1.
+RdaFrameInfo *frames = nullptr;
+uint16_t frameCount = 0;
+uint16_t frameNumber = 0;
+uint32_t framesCapacity = 0;
+
+// Frame being applied, read from the card in one piece (PSRAM).
+uint8_t *frameData = nullptr;
+uint32_t frameDataSize = 0;
+// Whole rows gathered for one panel write, in internal RAM for the DMA.
+alignas(4) uint16_t bandBuffer[DISPLAY_WIDTH * RDA_BAND_LINES];
+
+uint32_t lastFrameMillis = 0;
+uint16_t lastFrameDelay = 0;
+
+uint32_t statsFrames = 0;
+uint32_t statsBytes = 0;
+uint32_t statsWrites = 0;
+uint32_t statsReadMicros = 0;
+uint32_t statsDrawMicros = 0;
+uint32_t statsDrawMax = 0;
+uint32_t lastStatsMillis = 0;
+
+void resetStats()
+{
+  statsFrames = 0;
+  statsBytes = 0;
+  statsWrites = 0;
+  statsReadMicros = 0;
+  statsDrawMicros = 0;
+  statsDrawMax = 0;
+  lastStatsMillis = millis();
+}
+
+void reportStats(uint32_t now)
+{
+  if (ANIMATED_GIF_STATS_INTERVAL_MS == 0 || statsFrames == 0 ||
+      (now - lastStatsMillis) < static_cast<uint32_t>(ANIMATED_GIF_STATS_INTERVAL_MS))
+  {
+    return;
+  }
+  Serial.printf("RDA: %s draw avg %lu us/frame, max %lu us, %lu writes/frame, read %lu us/frame, %lu bytes/frame "
+                "(%lu frames)\n",
+                kRdaFiles[loadedClip], static_cast<unsigned long>(statsDrawMicros / statsFrames),
+                static_cast<unsigned long>(statsDrawMax), static_cast<unsigned long>(statsWrites / statsFrames),
+                static_cast<unsigned long>(statsReadMicros / statsFrames),
+                static_cast<unsigned long>(statsBytes / statsFrames), static_cast<unsigned long>(statsFrames));
+  resetStats();
+}
+
+void writePixels(void *, int16_t x, int16_t y, uint16_t *pixels, int16_t width, int16_t lines)
+{
+  drawPanelPixels(gfx, static_cast<int16_t>(offsetX + x), static_cast<int16_t>(offsetY + y), pixels, width, lines);
+  ++statsWrites;
+}
+
+void closeClip()
+{
+  clipReady = false;
+  loadedClip = SIZE_MAX;
+  if (clipFile)
+  {
+    SpiBusGuard bus(SpiBusUser::Sd);
+    clipFile.close();
+  }
+}
+
+// Reads the header and frame table and checks every frame lies in the file.
+bool readFrameTable(const char *path, uint32_t fileSize)
+{
+  RdaHeader header = {};
+  {
+    SpiBusGuard bus(SpiBusUser::Sd);
+    if (clipFile.read(reinterpret_cast<uint8_t *>(&header), sizeof(header)) != sizeof(header))
+    {
+      Serial.printf("RDA: %s is too short for a header\n", path);
+      return false;
+    }
+  }
+  if (header.magic != RdaDecoder::MAGIC || header.version != RdaDecoder::VERSION || header.frameCount == 0)
+  {
+    Serial.printf("RDA: %s is not a version %u clip\n", path, static_cast<unsigned>(RdaDecoder::VERSION));
+    return false;
+  }
+  if (header.width == 0 || header.width > DISPLAY_WIDTH || header.height == 0 || header.height > DISPLAY_HEIGHT)
+  {
+    Serial.printf("RDA: %s is %ux%u, larger than the panel\n", path, static_cast<unsigned>(header.width),
+                  static_cast<unsigned>(header.height));
+    return false;
+  }
+  const uint32_t tableBytes = (static_cast<uint32_t>(header.frameCount) + 1) * sizeof(RdaFrameInfo);
+  if (!psramReserve(frames, framesCapacity, tableBytes))
+  {
+    Serial.printf("RDA: no memory for the %lu byte frame table of %s\n", static_cast<unsigned long>(tableBytes),
+                  path);
+    return false;
+  }
+  {
+    SpiBusGuard bus(SpiBusUser::Sd);
+    if (clipFile.read(reinterpret_cast<uint8_t *>(frames), tableBytes) != static_cast<int>(tableBytes))
+    {
+      Serial.printf("RDA: %s ends inside its frame table\n", path);
+      return false;
+    }
+  }
+  uint32_t largest = 0;
+  for (uint32_t i = 0; i <= header.frameCount; ++i)
+  {
+    const RdaFrameInfo &frame = frames[i];
+    if (frame.offset > fileSize || frame.length > fileSize - frame.offset || (frame.offset & 1) != 0)
+    {
+      Serial.printf("RDA: %s has a damaged frame table\n", path);
+      return false;
+    }
+    largest = frame.length > largest ? frame.length : largest;
+  }
+  if (!psramReserve(frameData, frameDataSize, largest))
+  {
+    Serial.printf("RDA: no memory for %lu byte frames\n", static_cast<unsigned long>(largest));
+    return false;
+  }
+  frameCount = header.frameCount;
+  decoder.setSize(header.width, header.height);
+  offsetX = static_cast<int16_t>((DISPLAY_WIDTH - header.width) / 2);
+  offsetY = static_cast<int16_t>((DISPLAY_HEIGHT - header.height) / 2);
+  return true;
+}
+
+bool openClip(size_t index)
+{
+  closeClip();
+  const char *path = kRdaFiles[index];
+  uint32_t fileSize = 0;
+  {
+    SpiBusGuard bus(SpiBusUser::Sd);
+    clipFile = SD.open(path, FILE_READ);
+    fileSize = clipFile ? static_cast<uint32_t>(clipFile.size()) : 0;
+  }
+  if (!clipFile)
+  {
+    Serial.printf("RDA: failed to open %s\n", path);
+    return false;
+  }
+  if (!readFrameTable(path, fileSize))
+  {
+    closeClip();
+    return false;
+  }
+  loadedClip = index;
+  Serial.printf("RDA: %s, %u frames at %ux%u\n", path, static_cast<unsigned>(frameCount),
+                static_cast<unsigned>(decoder.width()), static_cast<unsigned>(decoder.height()));
+  return true;
+}
+
+bool readFrame(const RdaFrameInfo &frame)
+{
+  if (frame.length == 0)
+  {
+    return true;
+  }
+  SpiBusGuard bus(SpiBusUser::Sd);
+  return clipFile.seek(frame.offset) &&
+         clipFile.read(frameData, frame.length) == static_cast<int>(frame.length);
+}
+} // namespace
+
+size_t rdaClipCount()
+{
+  return kRdaFileCount;
+}
+
+size_t rdaClipIndex(const char *path)
+{
+  for (size_t i = 0; i < kRdaFileCount; ++i)
+  {
+    if (strcmp(kRdaFiles[i], path) == 0)
+    {
+      return i;
+    }
+  }
+  return SIZE_MAX;
+}
+
+bool rdaClipMissing(size_t index)
+{
+  if (index >= kRdaFileCount)
+  {
+    return true;
+  }
+  if (!clipChecked[index])
+  {
+    {
+      SpiBusGuard bus(SpiBusUser::Sd);
+      clipAbsent[index] = !SD.exists(kRdaFiles[index]);
+    }
+    clipChecked[index] = true;
+    if (clipAbsent[index])
+    {
+      Serial.printf("RDA: %s is not on the card\n", kRdaFiles[index]);
+    }
+  }
+  return clipAbsent[index];
+}
+
+bool rdaOpenAtIndex(size_t index)
+{
+  if (index >= kRdaFileCount)
+  {
+    return false;
+  }
+  // The caller has cleared the panel, so even the open clip starts over
+  // from its first frame.
+  if (index != loadedClip && !openClip(index))
+  {
+    return false;
+  }
+  decoder.setSwapBytes(PANEL_NATIVE_PIXELS);
+  frameNumber = 0;
+  lastFrameMillis = millis();
+  lastFrameDelay = 0;
+  clipReady = true;
+  resetStats();
+  return true;
+}
+
+void rdaLoop()
+{
+  if (!clipReady)
+  {
+    return;
+  }
+  const uint32_t now = millis();
+  if (now - lastFrameMillis < lastFrameDelay)
+  {
+    return;
+  }
+
+  const RdaFrameInfo &frame = frames[frameNumber];
+  const uint32_t readStart = micros();
+  if (!readFrame(frame))
+  {
+    Serial.printf("RDA: read of frame %u of %s failed\n", static_cast<unsigned>(frameNumber), kRdaFiles[loadedClip]);
+    closeClip();
+    return;
+  }
+  const uint32_t drawStart = micros();
+  bool ok;
+  {
+    // One bus hold for the whole frame, between the GIF I/O task's reads.
+    SpiBusGuard bus(SpiBusUser::Panel);
+    ok = decoder.decode(frameData, frame.length, bandBuffer, sizeof(bandBuffer) / sizeof(bandBuffer[0]),
+                        panelPixel(ANIMATED_GIF_BACKGROUND), writePixels, nullptr);
+  }
+  const uint32_t drawMicros = micros() - drawStart;
+  if (!ok)
+  {
+    // Later frames build on this one, so the clip cannot carry on.
+    Serial.printf("RDA: frame %u of %s is damaged\n", static_cast<unsigned>(frameNumber), kRdaFiles[loadedClip]);
+    closeClip();
+    return;
+  }
+
+  ++statsFrames;
+  statsBytes += frame.length;
+  statsReadMicros += drawStart - readStart;
+  statsDrawMicros += drawMicros;
+  if (drawMicros > statsDrawMax)
+  {
+    statsDrawMax = drawMicros;
+  }
+
+  lastFrameMillis = now;
+  lastFrameDelay = frame.delayMs ? frame.delayMs : RDA_DEFAULT_DELAY;
+  frameNumber = frameNumber == frameCount ? 1 : static_cast<uint16_t>(frameNumber + 1);
+  reportStats(now);
+}
+
+bool rdaIsReady()
+{
+  return clipReady;
+}
+
+#endif
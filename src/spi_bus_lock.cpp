@@ -0,0 +1,74 @@
+#include "spi_bus_lock.h"
+
+namespace
+{
+SpiBusStats busStats = {};
+} // namespace
+
+const SpiBusStats &spiBusStats()
+{
+  return busStats;
+}
+
+void spiBusResetStats()
+{
+  busStats = {};
+}
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+namespace
+{
+SemaphoreHandle_t busMutex = nullptr;
+// Only touched by the task holding the mutex.
+uint32_t holdDepth = 0;
+uint32_t holdStart = 0;
+SpiBusUser holder = SpiBusUser::Other;
+} // namespace
+
+void spiBusLockBegin()
+{
+  if (!busMutex)
+  {
+    busMutex = xSemaphoreCreateRecursiveMutex();
+  }
+}
+
+SpiBusGuard::SpiBusGuard(SpiBusUser user)
+{
+  if (busMutex)
+  {
+    const uint32_t start = micros();
+    xSemaphoreTakeRecursive(busMutex, portMAX_DELAY);
+    if (holdDepth++ == 0)
+    {
+      const size_t slot = static_cast<size_t>(user);
+      holder = user;
+      holdStart = micros();
+      busStats.waitMicros[slot] += holdStart - start;
+      ++busStats.holds[slot];
+    }
+  }
+}
+
+SpiBusGuard::~SpiBusGuard()
+{
+  if (busMutex)
+  {
+    if (--holdDepth == 0)
+    {
+      busStats.heldMicros[static_cast<size_t>(holder)] += micros() - holdStart;
+    }
+    xSemaphoreGiveRecursive(busMutex);
+  }
+}
+#else
+void spiBusLockBegin() {}
+
+SpiBusGuard::SpiBusGuard(SpiBusUser) {}
+
+SpiBusGuard::~SpiBusGuard() {}
+#endif
@@ -0,0 +1,125 @@
+// Host check for src/fat_extent.cpp against a FAT16/FAT32 card image.
+//
+// Every file in a host directory is looked up by name in the image's root
+// directory. Contiguous files are read back as raw sectors, the way the player
+// reads them, and compared with the host copy; fragmented ones are listed
+// (the player reads those through the FAT layer).
+//
+// Make an image from data/ (mtools + dosfstools):
+//   mkfs.fat -C -F 32 card.img 65536 && mcopy -i card.img data/*.gif ::/
+// Build (from the repo root):
+//   g++ -O2 -std=gnu++17 -Iinclude -o fat_extent_check tools/fat_extent_check.cpp src/fat_extent.cpp
+// Run:
+//   ./fat_extent_check card.img data
+
+#include "fat_extent.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace
+{
+bool readImageSectors(void *image, uint32_t sector, uint8_t *dest, uint32_t count)
+{
+  FILE *file = static_cast<FILE *>(image);
+  return fseek(file, static_cast<long>(sector) * FatVolume::SECTOR_SIZE, SEEK_SET) == 0 &&
+         fread(dest, FatVolume::SECTOR_SIZE, count, file) == count;
+}
+
+bool loadFile(const std::string &path, std::vector<uint8_t> &data)
+{
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+  {
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  data.resize(static_cast<size_t>(ftell(f)));
+  fseek(f, 0, SEEK_SET);
+  const bool ok = fread(data.data(), 1, data.size(), f) == data.size();
+  fclose(f);
+  return ok;
+}
+
+std::vector<std::string> listFiles(const char *dirPath)
+{
+  std::vector<std::string> names;
+  DIR *dir = opendir(dirPath);
+  if (!dir)
+  {
+    return names;
+  }
+  while (dirent *entry = readdir(dir))
+  {
+    if (entry->d_type == DT_REG)
+    {
+      names.push_back(entry->d_name);
+    }
+  }
+  closedir(dir);
+  std::sort(names.begin(), names.end());
+  return names;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+  {
+    fprintf(stderr, "usage: fat_extent_check <image> <directory>\n");
+    return 2;
+  }
+  FILE *image = fopen(argv[1], "rb");
+  FatVolume volume;
+  if (!image || !volume.mount(readImageSectors, image))
+  {
+    fprintf(stderr, "fat_extent_check: %s is not a FAT16/FAT32 image\n", argv[1]);
+    return 1;
+  }
+
+  int contiguous = 0;
+  int fragmented = 0;
+  int failures = 0;
+  for (const std::string &name : listFiles(argv[2]))
+  {
+    std::vector<uint8_t> expected;
+    if (!loadFile(std::string(argv[2]) + "/" + name, expected))
+    {
+      continue;
+    }
+    FatExtent extent = {};
+    const FatFileLayout layout = volume.locate(("/" + name).c_str(), &extent);
+    if (layout == FatFileLayout::Missing)
+    {
+      printf("%-24s missing\n", name.c_str());
+      ++failures;
+      continue;
+    }
+    if (layout == FatFileLayout::Fragmented)
+    {
+      printf("%-24s fragmented\n", name.c_str());
+      ++fragmented;
+      continue;
+    }
+    std::vector<uint8_t> sectors(static_cast<size_t>(extent.sectorCount) * FatVolume::SECTOR_SIZE);
+    const bool match = extent.fileSize == expected.size() &&
+                       readImageSectors(image, extent.firstSector, sectors.data(), extent.sectorCount) &&
+                       memcmp(sectors.data(), expected.data(), expected.size()) == 0;
+    printf("%-24s contiguous at sector %lu, %lu sectors%s\n", name.c_str(),
+           static_cast<unsigned long>(extent.firstSector), static_cast<unsigned long>(extent.sectorCount),
+           match ? "" : "  CONTENT MISMATCH");
+    ++contiguous;
+    if (!match)
+    {
+      ++failures;
+    }
+  }
+  printf("%d contiguous, %d fragmented, %d failed\n", contiguous, fragmented, failures);
+  fclose(image);
+  return failures == 0 ? 0 : 1;
+}
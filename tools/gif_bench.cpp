@@ -0,0 +1,277 @@
+// Host benchmark for lib/AnimatedGIF over the GIFs in a directory (data/).
+//
+// Every file is decoded from memory the way the player decodes it (turbo
+// buffer, COOKED output) through three input paths; the fastest of `rounds`
+// passes is reported:
+//   memory    open() on the bytes; LZW sub-blocks are de-chunked in place
+//   callbacks read/seek callbacks only, like an SD file without a window
+//   mapped    read/seek callbacks plus setMapCallback(), like the player's
+//             read-ahead window
+//
+// Build (from the repo root):
+//   g++ -O2 -std=gnu++17 -D__LINUX__ -Ilib/AnimatedGIF -o gif_bench
+//       tools/gif_bench.cpp lib/AnimatedGIF/AnimatedGIF.cpp
+// Run:
+//   ./gif_bench data [rounds]
+
+#include <AnimatedGIF.h>
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace
+{
+enum class Source
+{
+  Memory,
+  Callbacks,
+  Mapped,
+};
+
+constexpr const char *SOURCE_NAMES[] = {"memory", "callbacks", "mapped"};
+constexpr int SOURCE_COUNT = 3;
+
+struct GifFile
+{
+  std::string name;
+  std::vector<uint8_t> data;
+};
+
+struct Result
+{
+  int frames = 0;
+  uint32_t checksum = 0;
+  double micros = 0.0; // fastest pass
+  uint32_t reads = 0;  // read callbacks in one pass
+};
+
+uint32_t drawChecksum = 0;
+uint32_t readCalls = 0;
+
+void benchDraw(GIFDRAW *pDraw)
+{
+  // Touch the output so the decode cannot be optimised away.
+  const uint16_t *pixels = reinterpret_cast<const uint16_t *>(pDraw->pPixels);
+  drawChecksum = drawChecksum * 31u + pixels[0] + pixels[pDraw->iWidth - 1] + static_cast<uint32_t>(pDraw->y);
+}
+
+void *benchOpen(const char *szFilename, int32_t *pFileSize)
+{
+  GifFile *file = reinterpret_cast<GifFile *>(const_cast<char *>(szFilename));
+  *pFileSize = static_cast<int32_t>(file->data.size());
+  return file;
+}
+
+void benchClose(void *) {}
+
+int32_t benchRead(GIFFILE *pFile, uint8_t *pBuf, int32_t iLen)
+{
+  const GifFile *file = static_cast<const GifFile *>(pFile->fHandle);
+  ++readCalls;
+  const int32_t bytesRead = std::min(iLen, pFile->iSize - pFile->iPos);
+  if (bytesRead <= 0)
+  {
+    return 0;
+  }
+  memcpy(pBuf, file->data.data() + pFile->iPos, static_cast<size_t>(bytesRead));
+  pFile->iPos += bytesRead;
+  return bytesRead;
+}
+
+int32_t benchSeek(GIFFILE *pFile, int32_t iPosition)
+{
+  pFile->iPos = std::max(0, std::min(iPosition, pFile->iSize));
+  return pFile->iPos;
+}
+
+uint8_t *benchMap(GIFFILE *pFile, int32_t *piAvailable)
+{
+  GifFile *file = static_cast<GifFile *>(pFile->fHandle);
+  *piAvailable = pFile->iSize - pFile->iPos;
+  return *piAvailable > 0 ? file->data.data() + pFile->iPos : nullptr;
+}
+
+bool loadFile(const std::string &path, std::vector<uint8_t> &data)
+{
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+  {
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  data.resize(static_cast<size_t>(ftell(f)));
+  fseek(f, 0, SEEK_SET);
+  const bool ok = fread(data.data(), 1, data.size(), f) == data.size();
+  fclose(f);
+  return ok;
+}
+
+std::vector<GifFile> loadGifs(const char *dirPath)
+{
+  std::vector<GifFile> files;
+  DIR *dir = opendir(dirPath);
+  if (!dir)
+  {
+    return files;
+  }
+  while (dirent *entry = readdir(dir))
+  {
+    const std::string name = entry->d_name;
+    if (name.size() < 4 || name.compare(name.size() - 4, 4, ".gif") != 0)
+    {
+      continue;
+    }
+    GifFile file;
+    file.name = name;
+    if (loadFile(std::string(dirPath) + "/" + name, file.data))
+    {
+      files.push_back(std::move(file));
+    }
+  }
+  closedir(dir);
+  std::sort(files.begin(), files.end(), [](const GifFile &a, const GifFile &b) { return a.name < b.name; });
+  return files;
+}
+
+void *benchAlloc(uint32_t size)
+{
+  return malloc(size);
+}
+
+void benchFree(void *buffer)
+{
+  free(buffer);
+}
+
+bool decodeAll(AnimatedGIF &gif, GifFile &file, Source source, Result &result)
+{
+  gif.begin(BIG_ENDIAN_PIXELS);
+  int opened;
+  if (source == Source::Memory)
+  {
+    opened = gif.open(file.data.data(), static_cast<int>(file.data.size()), benchDraw);
+  }
+  else
+  {
+    opened = gif.open(reinterpret_cast<const char *>(&file), benchOpen, benchClose, benchRead, benchSeek, benchDraw);
+    if (opened && source == Source::Mapped)
+    {
+      gif.setMapCallback(benchMap);
+    }
+  }
+  if (!opened)
+  {
+    return false;
+  }
+  if (gif.allocTurboBuf(benchAlloc) != GIF_SUCCESS || gif.allocFrameBuf(benchAlloc) != GIF_SUCCESS)
+  {
+    gif.close();
+    return false;
+  }
+  gif.setDrawType(GIF_DRAW_COOKED);
+
+  drawChecksum = 0;
+  readCalls = 0;
+  const auto start = std::chrono::steady_clock::now();
+  int frames = 0;
+  int delayMs = 0;
+  int more;
+  do
+  {
+    more = gif.playFrame(false, &delayMs);
+    ++frames;
+  } while (more > 0);
+  const double micros =
+      std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  if (result.frames == 0 || micros < result.micros)
+  {
+    result.micros = micros;
+  }
+  result.frames = frames;
+  result.checksum = drawChecksum;
+  result.reads = readCalls;
+
+  gif.freeFrameBuf(benchFree);
+  gif.freeTurboBuf(benchFree);
+  gif.close();
+  return true;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  const char *dirPath = argc > 1 ? argv[1] : "data";
+  const int rounds = argc > 2 ? std::max(1, atoi(argv[2])) : 5;
+  std::vector<GifFile> files = loadGifs(dirPath);
+  if (files.empty())
+  {
+    fprintf(stderr, "gif_bench: no .gif files in %s\n", dirPath);
+    return 1;
+  }
+
+  AnimatedGIF *gif = new AnimatedGIF();
+  printf("%-20s %6s %12s %12s %12s %10s %10s\n", "file", "frames", "memory us/f", "callbacks", "mapped",
+         "reads/f", "mapped");
+  double totals[SOURCE_COUNT] = {};
+  uint32_t totalReads[SOURCE_COUNT] = {};
+  int totalFrames = 0;
+  int failures = 0;
+  for (GifFile &file : files)
+  {
+    Result results[SOURCE_COUNT];
+    bool ok = true;
+    for (int round = 0; round < rounds && ok; ++round)
+    {
+      for (int s = 0; s < SOURCE_COUNT && ok; ++s)
+      {
+        ok = decodeAll(*gif, file, static_cast<Source>(s), results[s]);
+      }
+    }
+    if (!ok)
+    {
+      printf("%-20s failed to decode\n", file.name.c_str());
+      ++failures;
+      continue;
+    }
+    const bool match =
+        results[0].checksum == results[1].checksum && results[0].checksum == results[2].checksum;
+    const double frames = results[0].frames;
+    printf("%-20s %6d %12.1f %12.1f %12.1f %10.1f %10.1f%s\n", file.name.c_str(), results[0].frames,
+           results[0].micros / frames, results[1].micros / frames, results[2].micros / frames,
+           results[1].reads / frames, results[2].reads / frames, match ? "" : "  OUTPUT MISMATCH");
+    if (!match)
+    {
+      ++failures;
+    }
+    for (int s = 0; s < SOURCE_COUNT; ++s)
+    {
+      totals[s] += results[s].micros;
+      totalReads[s] += results[s].reads;
+    }
+    totalFrames += results[0].frames;
+  }
+  printf("%-20s %6d", "all", totalFrames);
+  for (int s = 0; s < SOURCE_COUNT; ++s)
+  {
+    printf(" %12.1f", totals[s] / totalFrames);
+  }
+  printf(" %10.1f %10.1f\n", static_cast<double>(totalReads[1]) / totalFrames,
+         static_cast<double>(totalReads[2]) / totalFrames);
+  for (int s = 0; s < SOURCE_COUNT; ++s)
+  {
+    if (static_cast<Source>(s) != Source::Callbacks)
+    {
+      printf("%s: %.1f%% of the callbacks time\n", SOURCE_NAMES[s],
+             100.0 * totals[s] / totals[static_cast<int>(Source::Callbacks)]);
+    }
+  }
+  delete gif;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,214 @@
+// Host check for the shared playback clock (include/gif_timebase.h) and the
+// frame it selects through GifFrameIndex::frameAtTime().
+//
+// A sender clock running at a fixed skew from local time sends sync packets
+// that arrive after a random latency; some are lost. At every local
+// millisecond the check asks which frame the player would show and compares
+// it with the frame at the sender's true time, and compares every packet's
+// reported drift with the one worked out from the simulation. It also feeds
+// a packet that arrives after the render loop took its time sample.
+//
+// Build (from the repo root):
+//   g++ -O2 -std=gnu++17 -D__LINUX__ -Iinclude -Ilib/AnimatedGIF -o gif_clock_check
+//       tools/gif_clock_check.cpp src/gif_frame_index.cpp
+// Run:
+//   ./gif_clock_check
+
+#include "gif_frame_index.h"
+#include "gif_timebase.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+namespace
+{
+// Frame delays as playFrame() reports them; 0 plays at the default delay.
+constexpr uint16_t FRAME_DELAYS[] = {100, 100, 40, 40, 0, 250, 100, 0, 60, 60, 60, 190};
+constexpr uint16_t FRAME_COUNT = sizeof(FRAME_DELAYS) / sizeof(FRAME_DELAYS[0]);
+constexpr uint16_t DEFAULT_DELAY_MS = 80;
+
+struct Scenario
+{
+  const char *name;
+  int32_t skewPpm;       // sender clock rate against local time
+  uint32_t offsetMs;     // sender clock at local 0
+  uint32_t intervalMs;   // between packets sent
+  uint32_t maxLatencyMs; // arrival after sending, 0..this
+  uint32_t dropEvery;    // every Nth packet is lost (0: none)
+  uint32_t durationMs;
+};
+
+constexpr Scenario SCENARIOS[] = {
+    {"steady", 0, 5000, 500, 0, 0, 60000},
+    {"skew +2000 ppm", 2000, 123456, 500, 0, 0, 60000},
+    {"skew -1500 ppm, jitter", -1500, 77, 250, 12, 0, 60000},
+    {"skew +800 ppm, lossy", 800, 4000000000u, 400, 8, 3, 120000},
+    {"sparse, jitter", 300, 9999, 2000, 20, 2, 120000},
+};
+
+uint32_t random32(uint32_t &state)
+{
+  state = state * 1664525u + 1013904223u;
+  return state >> 8;
+}
+
+// Sender clock at local time `localMs`.
+uint32_t senderAt(const Scenario &scenario, uint32_t localMs)
+{
+  const int64_t skew = static_cast<int64_t>(localMs) * scenario.skewPpm / 1000000;
+  return scenario.offsetMs + localMs + static_cast<uint32_t>(skew);
+}
+
+// Frames shown at any sender time within `marginMs` of `senderMs`.
+bool frameWithin(const GifFrameIndex &index, uint32_t senderMs, uint32_t marginMs, size_t frame)
+{
+  for (uint32_t t = senderMs - marginMs; t != senderMs + marginMs + 1; ++t)
+  {
+    if (index.frameAtTime(t) == frame)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+int runScenario(const GifFrameIndex &index, const Scenario &scenario)
+{
+  struct Packet
+  {
+    uint32_t timebaseMs;
+    uint32_t arrivalMs;
+  };
+  uint32_t seed = scenario.intervalMs * 7919u + scenario.maxLatencyMs;
+  std::vector<Packet> packets;
+  uint32_t sent = 0;
+  for (uint32_t sendMs = 0; sendMs < scenario.durationMs; sendMs += scenario.intervalMs, ++sent)
+  {
+    if (scenario.dropEvery > 0 && sent % scenario.dropEvery == scenario.dropEvery - 1)
+    {
+      continue;
+    }
+    const uint32_t latency = scenario.maxLatencyMs ? random32(seed) % (scenario.maxLatencyMs + 1) : 0;
+    packets.push_back(Packet{senderAt(scenario, sendMs), sendMs + latency});
+  }
+
+  // How far the clock can be from the sender: the latency of the packet it
+  // runs from, plus the skew since then.
+  const uint32_t gapMs = scenario.intervalMs * (scenario.dropEvery > 0 ? 2 : 1) + scenario.maxLatencyMs;
+  const uint32_t skewMarginMs =
+      static_cast<uint32_t>(static_cast<int64_t>(gapMs) * llabs(scenario.skewPpm) / 1000000) + 1;
+  const uint32_t marginMs = scenario.maxLatencyMs + skewMarginMs;
+
+  GifTimebase timebase;
+  int failures = 0;
+  size_t next = 0;
+  uint32_t frameChecks = 0;
+  uint32_t expectedMaxDrift = 0;
+  bool havePrevious = false;
+  Packet previous = {};
+  for (uint32_t localMs = 0; localMs < scenario.durationMs; ++localMs)
+  {
+    while (next < packets.size() && packets[next].arrivalMs <= localMs)
+    {
+      const Packet &packet = packets[next++];
+      timebase.sync(packet.timebaseMs, packet.arrivalMs);
+      if (havePrevious)
+      {
+        const int32_t expected = static_cast<int32_t>(packet.timebaseMs -
+                                                      (previous.timebaseMs + (packet.arrivalMs - previous.arrivalMs)));
+        const uint32_t magnitude = static_cast<uint32_t>(expected < 0 ? -expected : expected);
+        expectedMaxDrift = magnitude > expectedMaxDrift ? magnitude : expectedMaxDrift;
+        if (timebase.lastDriftMs() != expected)
+        {
+          printf("  packet %zu: drift %ld ms, expected %ld ms\n", next - 1,
+                 static_cast<long>(timebase.lastDriftMs()), static_cast<long>(expected));
+          ++failures;
+        }
+      }
+      previous = packet;
+      havePrevious = true;
+    }
+    if (!timebase.synced())
+    {
+      continue;
+    }
+    const size_t shown = index.frameAtTime(timebase.now(localMs));
+    ++frameChecks;
+    if (!frameWithin(index, senderAt(scenario, localMs), marginMs, shown))
+    {
+      if (failures < 10)
+      {
+        printf("  local %lu ms: frame %zu, sender is at frame %zu (margin %lu ms)\n",
+               static_cast<unsigned long>(localMs), shown, index.frameAtTime(senderAt(scenario, localMs)),
+               static_cast<unsigned long>(marginMs));
+      }
+      ++failures;
+    }
+  }
+  if (timebase.maxDriftMs() != expectedMaxDrift || timebase.resyncs() + 1 != packets.size())
+  {
+    printf("  max drift %lu ms over %lu resyncs, expected %lu ms over %zu\n",
+           static_cast<unsigned long>(timebase.maxDriftMs()), static_cast<unsigned long>(timebase.resyncs()),
+           static_cast<unsigned long>(expectedMaxDrift), packets.size() - 1);
+    ++failures;
+  }
+  printf("%-26s %5zu packets, %6lu frame checks, max drift %3lu ms: %s\n", scenario.name, packets.size(),
+         static_cast<unsigned long>(frameChecks), static_cast<unsigned long>(timebase.maxDriftMs()),
+         failures ? "FAIL" : "ok");
+  return failures;
+}
+
+// The render loop samples millis() before a packet that arrives a few
+// milliseconds later: the clock must read as that packet's timebase, not wrap.
+int checkPacketAfterSample(const GifFrameIndex &index)
+{
+  GifTimebase timebase;
+  timebase.sync(10000, 1000);
+  const uint32_t sampledMs = 1500;
+  timebase.sync(10503, 1503);
+  int failures = 0;
+  if (timebase.now(sampledMs) != 10503)
+  {
+    printf("  clock read %lu before the packet's arrival, expected 10503\n",
+           static_cast<unsigned long>(timebase.now(sampledMs)));
+    ++failures;
+  }
+  if (index.frameAtTime(timebase.now(sampledMs)) != index.frameAtTime(10503))
+  {
+    printf("  frame %zu before the packet's arrival, expected %zu\n", index.frameAtTime(timebase.now(sampledMs)),
+           index.frameAtTime(10503));
+    ++failures;
+  }
+  printf("%-26s %s\n", "packet after sample", failures ? "FAIL" : "ok");
+  return failures;
+}
+} // namespace
+
+int main()
+{
+  GIFFRAMEINFO frames[FRAME_COUNT] = {};
+  for (uint16_t i = 0; i < FRAME_COUNT; ++i)
+  {
+    frames[i].iDelay = FRAME_DELAYS[i];
+    frames[i].ucFlags = i % 4 == 0 ? GIF_FRAME_KEY : 0;
+  }
+  GifFrameIndex index;
+  index.setPlaybackDelays(DEFAULT_DELAY_MS, 0);
+  if (!index.assign(frames, FRAME_COUNT))
+  {
+    fprintf(stderr, "gif_clock_check: no memory for the frame table\n");
+    return 1;
+  }
+  printf("%u frames, %lu ms loop\n", static_cast<unsigned>(index.frameCount()),
+         static_cast<unsigned long>(index.durationMs()));
+
+  int failures = 0;
+  for (const Scenario &scenario : SCENARIOS)
+  {
+    failures += runScenario(index, scenario);
+  }
+  failures += checkPacketAfterSample(index);
+  return failures ? 1 : 0;
+}
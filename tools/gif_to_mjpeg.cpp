@@ -0,0 +1,215 @@
+// Converts a GIF into a Motion-JPEG clip for the MJPEG player.
+//
+// Frames are composited the way the player shows the GIF (COOKED output,
+// scaled up by the smallest whole factor that covers the panel, centre
+// crop), encoded as baseline 4:2:0 JPEGs and written back to back. The
+// frame table (include/mjpeg_index.h) goes next to the clip as
+// "<output>.idx" with the GIF's own frame delays; copy both to the card.
+//
+// Build (from the repo root):
+//   g++ -O2 -std=gnu++17 -D__LINUX__ -Iinclude -Ilib/AnimatedGIF -o gif_to_mjpeg
+//       tools/gif_to_mjpeg.cpp lib/AnimatedGIF/AnimatedGIF.cpp -ljpeg
+// Run:
+//   ./gif_to_mjpeg data/fish.gif fish.mjpeg [quality] [panel size]
+
+#include <AnimatedGIF.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <jpeglib.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "mjpeg_index.h"
+
+namespace
+{
+constexpr int DEFAULT_QUALITY = 80;
+constexpr int DEFAULT_PANEL = 240;
+constexpr int DEFAULT_DELAY_MS = 33;
+
+// RGB565 canvas the draw callback composites into.
+std::vector<uint16_t> canvas;
+int canvasWidth = 0;
+
+void canvasDraw(GIFDRAW *pDraw)
+{
+  const uint16_t *pixels = reinterpret_cast<const uint16_t *>(pDraw->pPixels);
+  memcpy(&canvas[static_cast<size_t>(pDraw->iY + pDraw->y) * canvasWidth + pDraw->iX], pixels,
+         static_cast<size_t>(pDraw->iWidth) * sizeof(uint16_t));
+}
+
+void *convertAlloc(uint32_t size)
+{
+  return malloc(size);
+}
+
+void convertFree(void *buffer)
+{
+  free(buffer);
+}
+
+bool loadFile(const char *path, std::vector<uint8_t> &data)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+  {
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  data.resize(static_cast<size_t>(ftell(f)));
+  fseek(f, 0, SEEK_SET);
+  const bool ok = fread(data.data(), 1, data.size(), f) == data.size();
+  fclose(f);
+  return ok;
+}
+
+// Panel-sized crop of the scaled canvas as RGB888 rows.
+void renderFrame(std::vector<uint8_t> &rgb, int width, int height, int scale, int offsetX, int offsetY)
+{
+  for (int y = 0; y < height; ++y)
+  {
+    const uint16_t *row = &canvas[static_cast<size_t>((y - offsetY) / scale) * canvasWidth];
+    uint8_t *out = &rgb[static_cast<size_t>(y) * width * 3];
+    for (int x = 0; x < width; ++x)
+    {
+      const uint16_t pixel = row[(x - offsetX) / scale];
+      const uint8_t r = static_cast<uint8_t>((pixel >> 11) & 0x1F);
+      const uint8_t g = static_cast<uint8_t>((pixel >> 5) & 0x3F);
+      const uint8_t b = static_cast<uint8_t>(pixel & 0x1F);
+      out[x * 3] = static_cast<uint8_t>((r << 3) | (r >> 2));
+      out[x * 3 + 1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+      out[x * 3 + 2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+    }
+  }
+}
+
+void encodeFrame(const std::vector<uint8_t> &rgb, int width, int height, int quality, std::vector<uint8_t> &jpeg)
+{
+  jpeg_compress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_compress(&cinfo);
+  unsigned char *buffer = nullptr;
+  unsigned long size = 0;
+  jpeg_mem_dest(&cinfo, &buffer, &size);
+  cinfo.image_width = static_cast<JDIMENSION>(width);
+  cinfo.image_height = static_cast<JDIMENSION>(height);
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality, TRUE);
+  // 4:2:0, no JFIF marker: the decoder only needs the tables and the scan.
+  cinfo.comp_info[0].h_samp_factor = 2;
+  cinfo.comp_info[0].v_samp_factor = 2;
+  cinfo.write_JFIF_header = FALSE;
+  cinfo.optimize_coding = TRUE;
+  jpeg_start_compress(&cinfo, TRUE);
+  while (cinfo.next_scanline < cinfo.image_height)
+  {
+    JSAMPROW row = const_cast<JSAMPROW>(&rgb[static_cast<size_t>(cinfo.next_scanline) * width * 3]);
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+  jpeg.assign(buffer, buffer + size);
+  free(buffer);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+  {
+    fprintf(stderr, "usage: gif_to_mjpeg input.gif output.mjpeg [quality] [panel size]\n");
+    return 2;
+  }
+  const int quality = argc > 3 ? std::max(1, std::min(100, atoi(argv[3]))) : DEFAULT_QUALITY;
+  const int panel = argc > 4 ? std::max(16, atoi(argv[4])) : DEFAULT_PANEL;
+
+  std::vector<uint8_t> data;
+  if (!loadFile(argv[1], data))
+  {
+    fprintf(stderr, "gif_to_mjpeg: cannot read %s\n", argv[1]);
+    return 1;
+  }
+  AnimatedGIF *gif = new AnimatedGIF();
+  gif->begin(LITTLE_ENDIAN_PIXELS);
+  if (!gif->open(data.data(), static_cast<int>(data.size()), canvasDraw) ||
+      gif->allocTurboBuf(convertAlloc) != GIF_SUCCESS || gif->allocFrameBuf(convertAlloc) != GIF_SUCCESS)
+  {
+    fprintf(stderr, "gif_to_mjpeg: cannot decode %s\n", argv[1]);
+    delete gif;
+    return 1;
+  }
+  gif->setDrawType(GIF_DRAW_COOKED);
+
+  canvasWidth = gif->getCanvasWidth();
+  const int canvasHeight = gif->getCanvasHeight();
+  canvas.assign(static_cast<size_t>(canvasWidth) * canvasHeight, 0);
+  const int scale = std::max(1, std::max((panel + canvasWidth - 1) / canvasWidth,
+                                         (panel + canvasHeight - 1) / canvasHeight));
+  const int width = std::min(panel, canvasWidth * scale);
+  const int height = std::min(panel, canvasHeight * scale);
+  const int offsetX = (width - canvasWidth * scale) / 2;
+  const int offsetY = (height - canvasHeight * scale) / 2;
+
+  FILE *out = fopen(argv[2], "wb");
+  if (!out)
+  {
+    fprintf(stderr, "gif_to_mjpeg: cannot write %s\n", argv[2]);
+    delete gif;
+    return 1;
+  }
+  std::vector<MjpegFrameInfo> frames;
+  std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+  std::vector<uint8_t> jpeg;
+  uint32_t offset = 0;
+  int delayMs = 0;
+  int more;
+  do
+  {
+    more = gif->playFrame(false, &delayMs);
+    if (more < 0)
+    {
+      break;
+    }
+    renderFrame(rgb, width, height, scale, offsetX, offsetY);
+    encodeFrame(rgb, width, height, quality, jpeg);
+    fwrite(jpeg.data(), 1, jpeg.size(), out);
+    const uint16_t delay = static_cast<uint16_t>(delayMs > 0 ? std::min(delayMs, 65535) : DEFAULT_DELAY_MS);
+    frames.push_back({offset, static_cast<uint32_t>(jpeg.size()), delay, 0});
+    offset += static_cast<uint32_t>(jpeg.size());
+  } while (more > 0 && frames.size() < UINT16_MAX);
+  fclose(out);
+  gif->freeFrameBuf(convertFree);
+  gif->freeTurboBuf(convertFree);
+  gif->close();
+  delete gif;
+
+  const std::string indexPath = std::string(argv[2]) + ".idx";
+  FILE *index = fopen(indexPath.c_str(), "wb");
+  if (!index)
+  {
+    fprintf(stderr, "gif_to_mjpeg: cannot write %s\n", indexPath.c_str());
+    return 1;
+  }
+  const MjpegIndexHeader header = {MjpegIndex::MAGIC,
+                                   MjpegIndex::VERSION,
+                                   static_cast<uint16_t>(frames.size()),
+                                   offset,
+                                   static_cast<uint16_t>(width),
+                                   static_cast<uint16_t>(height)};
+  fwrite(&header, sizeof(header), 1, index);
+  fwrite(frames.data(), sizeof(MjpegFrameInfo), frames.size(), index);
+  fclose(index);
+
+  printf("%s: %zu frames %dx%d (x%d from %dx%d), %u bytes, %.0f bytes/frame, GIF %zu bytes\n", argv[2],
+         frames.size(), width, height, scale, canvasWidth, canvasHeight, offset,
+         frames.empty() ? 0.0 : static_cast<double>(offset) / frames.size(), data.size());
+  return 0;
+}
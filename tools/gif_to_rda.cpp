@@ -0,0 +1,345 @@
+// Converts a GIF into a round delta animation (.rda, see include/rda_decoder.h).
+//
+// Frames are composited the way the player shows the GIF (COOKED output,
+// scaled up by the smallest whole factor that covers the panel, centre
+// crop). Each frame keeps only the rows that differ from the frame before
+// inside the panel's circle. Changes less than `gap` pixels apart are sent
+// as one run, like the GIF player's panel diff, and a row that changed over
+// 75% of its span is stored whole so it can go out in a band with its
+// neighbours. Runs of four or more equal pixels are stored as fills.
+//
+// Build (from the repo root):
+//   g++ -O2 -std=gnu++17 -D__LINUX__ -Iinclude -Ilib/AnimatedGIF -o gif_to_rda
+//       tools/gif_to_rda.cpp src/rda_decoder.cpp lib/AnimatedGIF/AnimatedGIF.cpp
+// Run:
+//   ./gif_to_rda data/beer.gif beer.rda [gap] [panel size]
+
+#include <AnimatedGIF.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "rda_decoder.h"
+
+namespace
+{
+constexpr int DEFAULT_GAP = 16;
+constexpr int DEFAULT_PANEL = 240;
+constexpr int DEFAULT_DELAY_MS = 33;
+constexpr int FULL_ROW_PERCENT = 75;
+constexpr int MIN_FILL = 4;
+
+// RGB565 canvas the draw callback composites into.
+std::vector<uint16_t> canvas;
+int canvasWidth = 0;
+
+void canvasDraw(GIFDRAW *pDraw)
+{
+  const uint16_t *pixels = reinterpret_cast<const uint16_t *>(pDraw->pPixels);
+  memcpy(&canvas[static_cast<size_t>(pDraw->iY + pDraw->y) * canvasWidth + pDraw->iX], pixels,
+         static_cast<size_t>(pDraw->iWidth) * sizeof(uint16_t));
+}
+
+void *convertAlloc(uint32_t size)
+{
+  return malloc(size);
+}
+
+void convertFree(void *buffer)
+{
+  free(buffer);
+}
+
+bool loadFile(const char *path, std::vector<uint8_t> &data)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+  {
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  data.resize(static_cast<size_t>(ftell(f)));
+  fseek(f, 0, SEEK_SET);
+  const bool ok = fread(data.data(), 1, data.size(), f) == data.size();
+  fclose(f);
+  return ok;
+}
+
+// Panel-sized crop of the scaled canvas.
+void renderFrame(std::vector<uint16_t> &frame, int width, int height, int scale, int offsetX, int offsetY)
+{
+  for (int y = 0; y < height; ++y)
+  {
+    const uint16_t *row = &canvas[static_cast<size_t>((y - offsetY) / scale) * canvasWidth];
+    for (int x = 0; x < width; ++x)
+    {
+      frame[static_cast<size_t>(y) * width + x] = row[(x - offsetX) / scale];
+    }
+  }
+}
+
+class FrameWriter
+{
+public:
+  explicit FrameWriter(std::vector<uint8_t> &out) : out_(out) {}
+
+  void word(uint16_t value)
+  {
+    out_.push_back(static_cast<uint8_t>(value & 0xFF));
+    out_.push_back(static_cast<uint8_t>(value >> 8));
+  }
+
+  void pixel(uint16_t value)
+  {
+    out_.push_back(static_cast<uint8_t>(value >> 8));
+    out_.push_back(static_cast<uint8_t>(value & 0xFF));
+  }
+
+  void op(uint16_t type, int count)
+  {
+    word(static_cast<uint16_t>((type << RdaDecoder::OP_SHIFT) | count));
+  }
+
+  size_t size() const { return out_.size(); }
+  void patch(size_t at, uint16_t value)
+  {
+    out_[at] = static_cast<uint8_t>(value & 0xFF);
+    out_[at + 1] = static_cast<uint8_t>(value >> 8);
+  }
+
+private:
+  std::vector<uint8_t> &out_;
+};
+
+// Copy and fill ops for pixels [start, end) of `row`; returns the op count.
+int encodeRun(FrameWriter &writer, const uint16_t *row, int start, int end)
+{
+  int ops = 0;
+  int copyStart = start;
+  int x = start;
+  while (x < end)
+  {
+    int repeat = 1;
+    while (x + repeat < end && row[x + repeat] == row[x])
+    {
+      ++repeat;
+    }
+    if (repeat < MIN_FILL)
+    {
+      x += repeat;
+      continue;
+    }
+    if (copyStart < x)
+    {
+      writer.op(RdaDecoder::OP_COPY, x - copyStart);
+      for (int i = copyStart; i < x; ++i)
+      {
+        writer.pixel(row[i]);
+      }
+      ++ops;
+    }
+    writer.op(RdaDecoder::OP_FILL, repeat);
+    writer.pixel(row[x]);
+    ++ops;
+    x += repeat;
+    copyStart = x;
+  }
+  if (copyStart < end)
+  {
+    writer.op(RdaDecoder::OP_COPY, end - copyStart);
+    for (int i = copyStart; i < end; ++i)
+    {
+      writer.pixel(row[i]);
+    }
+    ++ops;
+  }
+  return ops;
+}
+
+// Rows of `current` that differ from `previous` (every row when there is
+// no previous frame).
+void encodeFrame(const std::vector<uint16_t> &current, const std::vector<uint16_t> *previous, int width, int height,
+                 int gap, std::vector<uint8_t> &out)
+{
+  out.clear();
+  FrameWriter writer(out);
+  writer.word(0);
+  uint16_t rows = 0;
+  std::vector<std::pair<int, int>> runs;
+  for (int y = 0; y < height; ++y)
+  {
+    uint16_t x0;
+    uint16_t x1;
+    RdaDecoder::rowSpan(static_cast<uint16_t>(width), static_cast<uint16_t>(height), static_cast<uint16_t>(y), x0,
+                        x1);
+    if (x0 >= x1)
+    {
+      continue;
+    }
+    const uint16_t *row = &current[static_cast<size_t>(y) * width];
+    runs.clear();
+    int changed = 0;
+    if (previous)
+    {
+      const uint16_t *before = &(*previous)[static_cast<size_t>(y) * width];
+      for (int x = x0; x < x1; ++x)
+      {
+        if (row[x] == before[x])
+        {
+          continue;
+        }
+        if (!runs.empty() && x - runs.back().second < gap)
+        {
+          runs.back().second = x + 1;
+        }
+        else
+        {
+          runs.push_back({x, x + 1});
+        }
+      }
+      if (runs.empty())
+      {
+        continue;
+      }
+      for (const auto &run : runs)
+      {
+        changed += run.second - run.first;
+      }
+    }
+    const bool whole = !previous || changed * 100 >= (x1 - x0) * FULL_ROW_PERCENT;
+
+    writer.word(static_cast<uint16_t>(y | (whole ? 0 : RdaDecoder::ROW_HAS_SKIPS)));
+    const size_t opCountAt = writer.size();
+    writer.word(0);
+    int ops = 0;
+    if (whole)
+    {
+      ops = encodeRun(writer, row, x0, x1);
+    }
+    else
+    {
+      int x = x0;
+      for (const auto &run : runs)
+      {
+        if (run.first > x)
+        {
+          writer.op(RdaDecoder::OP_SKIP, run.first - x);
+          ++ops;
+        }
+        ops += encodeRun(writer, row, run.first, run.second);
+        x = run.second;
+      }
+    }
+    writer.patch(opCountAt, static_cast<uint16_t>(ops));
+    ++rows;
+  }
+  if (rows == 0)
+  {
+    // Nothing changed: an empty frame only holds the delay.
+    out.clear();
+    return;
+  }
+  writer.patch(0, rows);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+  {
+    fprintf(stderr, "usage: gif_to_rda input.gif output.rda [gap] [panel size]\n");
+    return 2;
+  }
+  const int gap = argc > 3 ? std::max(1, atoi(argv[3])) : DEFAULT_GAP;
+  const int panel = argc > 4 ? std::max(16, std::min(1024, atoi(argv[4]))) : DEFAULT_PANEL;
+
+  std::vector<uint8_t> data;
+  if (!loadFile(argv[1], data))
+  {
+    fprintf(stderr, "gif_to_rda: cannot read %s\n", argv[1]);
+    return 1;
+  }
+  AnimatedGIF *gif = new AnimatedGIF();
+  gif->begin(LITTLE_ENDIAN_PIXELS);
+  if (!gif->open(data.data(), static_cast<int>(data.size()), canvasDraw) ||
+      gif->allocTurboBuf(convertAlloc) != GIF_SUCCESS || gif->allocFrameBuf(convertAlloc) != GIF_SUCCESS)
+  {
+    fprintf(stderr, "gif_to_rda: cannot decode %s\n", argv[1]);
+    delete gif;
+    return 1;
+  }
+  gif->setDrawType(GIF_DRAW_COOKED);
+
+  canvasWidth = gif->getCanvasWidth();
+  const int canvasHeight = gif->getCanvasHeight();
+  canvas.assign(static_cast<size_t>(canvasWidth) * canvasHeight, 0);
+  const int scale = std::max(1, std::max((panel + canvasWidth - 1) / canvasWidth,
+                                         (panel + canvasHeight - 1) / canvasHeight));
+  const int width = std::min(panel, canvasWidth * scale);
+  const int height = std::min(panel, canvasHeight * scale);
+  const int offsetX = (width - canvasWidth * scale) / 2;
+  const int offsetY = (height - canvasHeight * scale) / 2;
+
+  std::vector<std::vector<uint16_t>> frames;
+  std::vector<uint16_t> delays;
+  int delayMs = 0;
+  int more;
+  do
+  {
+    more = gif->playFrame(false, &delayMs);
+    if (more < 0)
+    {
+      break;
+    }
+    frames.emplace_back(static_cast<size_t>(width) * height);
+    renderFrame(frames.back(), width, height, scale, offsetX, offsetY);
+    delays.push_back(static_cast<uint16_t>(delayMs > 0 ? std::min(delayMs, 65535) : DEFAULT_DELAY_MS));
+  } while (more > 0 && frames.size() < UINT16_MAX);
+  gif->freeFrameBuf(convertFree);
+  gif->freeTurboBuf(convertFree);
+  gif->close();
+  delete gif;
+  if (frames.empty())
+  {
+    fprintf(stderr, "gif_to_rda: no frames in %s\n", argv[1]);
+    return 1;
+  }
+
+  // Frame n leads from the last frame back to frame 0.
+  const size_t count = frames.size();
+  std::vector<RdaFrameInfo> table(count + 1);
+  std::vector<uint8_t> payload;
+  std::vector<uint8_t> encoded;
+  uint32_t offset = static_cast<uint32_t>(sizeof(RdaHeader) + table.size() * sizeof(RdaFrameInfo));
+  for (size_t i = 0; i <= count; ++i)
+  {
+    const std::vector<uint16_t> *previous = i == 0 ? nullptr : &frames[i - 1];
+    encodeFrame(frames[i % count], previous, width, height, gap, encoded);
+    table[i] = {offset + static_cast<uint32_t>(payload.size()), static_cast<uint32_t>(encoded.size()),
+                delays[i % count], 0};
+    payload.insert(payload.end(), encoded.begin(), encoded.end());
+  }
+
+  FILE *out = fopen(argv[2], "wb");
+  if (!out)
+  {
+    fprintf(stderr, "gif_to_rda: cannot write %s\n", argv[2]);
+    return 1;
+  }
+  const RdaHeader header = {RdaDecoder::MAGIC, RdaDecoder::VERSION, static_cast<uint16_t>(count),
+                            static_cast<uint16_t>(width), static_cast<uint16_t>(height), 0};
+  fwrite(&header, sizeof(header), 1, out);
+  fwrite(table.data(), sizeof(RdaFrameInfo), table.size(), out);
+  fwrite(payload.data(), 1, payload.size(), out);
+  fclose(out);
+
+  const size_t total = offset + payload.size();
+  printf("%s: %zu frames %dx%d (x%d from %dx%d), %zu bytes, %.0f bytes/frame, GIF %zu bytes\n", argv[2], count,
+         width, height, scale, canvasWidth, canvasHeight, total, static_cast<double>(payload.size()) / (count + 1),
+         data.size());
+  return 0;
+}
@@ -0,0 +1,241 @@
+// Host benchmark of the MJPEG player's decoder against the GIF path.
+//
+// For every "<name>.mjpeg" in a directory that has "<name>.gif" beside it,
+// all frames of the clip are decoded with JpegDecoder (frames located by
+// the "<name>.mjpeg.idx" table) and all frames of the GIF with
+// lib/AnimatedGIF the way the player decodes it (turbo buffer, COOKED
+// output, from memory). Reports bytes and the fastest of `rounds` passes
+// per frame for each; the GIF figures are for its own canvas, before the
+// player scales it up.
+//
+// Build (from the repo root):
+//   g++ -O2 -std=gnu++17 -D__LINUX__ -Iinclude -Ilib/AnimatedGIF -o mjpeg_bench
+//       tools/mjpeg_bench.cpp src/jpeg_decoder.cpp lib/AnimatedGIF/AnimatedGIF.cpp
+// Run:
+//   ./mjpeg_bench data [rounds]
+
+#include <AnimatedGIF.h>
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "jpeg_decoder.h"
+#include "mjpeg_index.h"
+
+namespace
+{
+struct Clip
+{
+  std::string name;
+  std::vector<uint8_t> mjpeg;
+  std::vector<MjpegFrameInfo> frames;
+  uint16_t width = 0;
+  uint16_t height = 0;
+  std::vector<uint8_t> gif;
+};
+
+struct Result
+{
+  int frames = 0;
+  double micros = 0.0; // fastest pass
+};
+
+uint32_t drawChecksum = 0;
+
+void gifDraw(GIFDRAW *pDraw)
+{
+  // Touch the output so the decode cannot be optimised away.
+  const uint16_t *pixels = reinterpret_cast<const uint16_t *>(pDraw->pPixels);
+  drawChecksum = drawChecksum * 31u + pixels[0] + pixels[pDraw->iWidth - 1] + static_cast<uint32_t>(pDraw->y);
+}
+
+void jpegBand(void *, int16_t y, uint16_t *pixels, int16_t width, int16_t lines)
+{
+  drawChecksum = drawChecksum * 31u + pixels[0] + pixels[width * lines - 1] + static_cast<uint32_t>(y);
+}
+
+void *benchAlloc(uint32_t size)
+{
+  return malloc(size);
+}
+
+void benchFree(void *buffer)
+{
+  free(buffer);
+}
+
+bool loadFile(const std::string &path, std::vector<uint8_t> &data)
+{
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+  {
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  data.resize(static_cast<size_t>(ftell(f)));
+  fseek(f, 0, SEEK_SET);
+  const bool ok = fread(data.data(), 1, data.size(), f) == data.size();
+  fclose(f);
+  return ok;
+}
+
+bool loadIndex(const std::string &path, Clip &clip)
+{
+  std::vector<uint8_t> data;
+  MjpegIndexHeader header;
+  if (!loadFile(path, data) || data.size() < sizeof(header))
+  {
+    return false;
+  }
+  memcpy(&header, data.data(), sizeof(header));
+  if (header.magic != MjpegIndex::MAGIC || header.version != MjpegIndex::VERSION ||
+      header.fileSize != clip.mjpeg.size() ||
+      data.size() != sizeof(header) + static_cast<size_t>(header.frameCount) * sizeof(MjpegFrameInfo))
+  {
+    return false;
+  }
+  clip.frames.resize(header.frameCount);
+  memcpy(clip.frames.data(), data.data() + sizeof(header), data.size() - sizeof(header));
+  clip.width = header.width;
+  clip.height = header.height;
+  return true;
+}
+
+std::vector<Clip> loadClips(const char *dirPath)
+{
+  std::vector<Clip> clips;
+  DIR *dir = opendir(dirPath);
+  if (!dir)
+  {
+    return clips;
+  }
+  while (dirent *entry = readdir(dir))
+  {
+    const std::string name = entry->d_name;
+    if (name.size() < 6 || name.compare(name.size() - 6, 6, ".mjpeg") != 0)
+    {
+      continue;
+    }
+    const std::string base = std::string(dirPath) + "/" + name.substr(0, name.size() - 6);
+    Clip clip;
+    clip.name = name;
+    if (!loadFile(base + ".mjpeg", clip.mjpeg) || !loadIndex(base + ".mjpeg.idx", clip) ||
+        !loadFile(base + ".gif", clip.gif))
+    {
+      fprintf(stderr, "mjpeg_bench: skipping %s (needs its .idx and a .gif beside it)\n", name.c_str());
+      continue;
+    }
+    clips.push_back(std::move(clip));
+  }
+  closedir(dir);
+  std::sort(clips.begin(), clips.end(), [](const Clip &a, const Clip &b) { return a.name < b.name; });
+  return clips;
+}
+
+bool decodeClip(JpegDecoder &decoder, const Clip &clip, std::vector<uint16_t> &band, Result &result)
+{
+  const auto start = std::chrono::steady_clock::now();
+  for (const MjpegFrameInfo &frame : clip.frames)
+  {
+    if (!decoder.decode(clip.mjpeg.data() + frame.offset, frame.length, band.data(), band.size(), jpegBand,
+                        nullptr))
+    {
+      return false;
+    }
+  }
+  const double micros =
+      std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  if (result.frames == 0 || micros < result.micros)
+  {
+    result.micros = micros;
+  }
+  result.frames = static_cast<int>(clip.frames.size());
+  return true;
+}
+
+bool decodeGif(AnimatedGIF &gif, Clip &clip, Result &result)
+{
+  gif.begin(BIG_ENDIAN_PIXELS);
+  if (!gif.open(clip.gif.data(), static_cast<int>(clip.gif.size()), gifDraw))
+  {
+    return false;
+  }
+  if (gif.allocTurboBuf(benchAlloc) != GIF_SUCCESS || gif.allocFrameBuf(benchAlloc) != GIF_SUCCESS)
+  {
+    gif.close();
+    return false;
+  }
+  gif.setDrawType(GIF_DRAW_COOKED);
+
+  const auto start = std::chrono::steady_clock::now();
+  int frames = 0;
+  int delayMs = 0;
+  int more;
+  do
+  {
+    more = gif.playFrame(false, &delayMs);
+    ++frames;
+  } while (more > 0);
+  const double micros =
+      std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  if (result.frames == 0 || micros < result.micros)
+  {
+    result.micros = micros;
+  }
+  result.frames = frames;
+  gif.freeFrameBuf(benchFree);
+  gif.freeTurboBuf(benchFree);
+  gif.close();
+  return true;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  const char *dirPath = argc > 1 ? argv[1] : "data";
+  const int rounds = argc > 2 ? std::max(1, atoi(argv[2])) : 5;
+  std::vector<Clip> clips = loadClips(dirPath);
+  if (clips.empty())
+  {
+    fprintf(stderr, "mjpeg_bench: no .mjpeg clips with a matching .gif in %s\n", dirPath);
+    return 1;
+  }
+
+  JpegDecoder decoder;
+  decoder.setSwapBytes(true);
+  AnimatedGIF *gif = new AnimatedGIF();
+  printf("%-20s %6s %9s %12s %12s %12s %12s\n", "clip", "frames", "size", "jpeg B/f", "jpeg us/f", "gif B/f",
+         "gif us/f");
+  int failures = 0;
+  for (Clip &clip : clips)
+  {
+    std::vector<uint16_t> band(static_cast<size_t>(clip.width) * JpegDecoder::MAX_BAND_LINES);
+    Result jpeg;
+    Result gifResult;
+    bool ok = true;
+    for (int round = 0; round < rounds && ok; ++round)
+    {
+      ok = decodeClip(decoder, clip, band, jpeg) && decodeGif(*gif, clip, gifResult);
+    }
+    if (!ok)
+    {
+      printf("%-20s failed to decode\n", clip.name.c_str());
+      ++failures;
+      continue;
+    }
+    char size[16];
+    snprintf(size, sizeof(size), "%ux%u", static_cast<unsigned>(clip.width), static_cast<unsigned>(clip.height));
+    printf("%-20s %6d %9s %12.0f %12.1f %12.0f %12.1f\n", clip.name.c_str(), jpeg.frames, size,
+           static_cast<double>(clip.mjpeg.size()) / jpeg.frames, jpeg.micros / jpeg.frames,
+           static_cast<double>(clip.gif.size()) / gifResult.frames, gifResult.micros / gifResult.frames);
+  }
+  delete gif;
+  return failures == 0 ? 0 : 1;
+}
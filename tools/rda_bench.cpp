@@ -0,0 +1,344 @@
+// Host benchmark of round delta animations (.rda) against the GIFs they
+// were made from.
+//
+// For every "<name>.rda" in a directory that has "<name>.gif" beside it,
+// all frames of the clip are applied with RdaDecoder to a panel-sized
+// buffer and all frames of the GIF are decoded with lib/AnimatedGIF the way
+// the player decodes it (turbo buffer, COOKED output, from memory). Reports
+// bytes and the fastest of `rounds` passes per frame for each, and the
+// writes (panel transactions) and pixels per .rda frame. A check pass
+// compares every .rda frame with the GIF frame scaled to the panel, inside
+// the circle.
+//
+// Build (from the repo root):
+//   g++ -O2 -std=gnu++17 -D__LINUX__ -Iinclude -Ilib/AnimatedGIF -o rda_bench
+//       tools/rda_bench.cpp src/rda_decoder.cpp lib/AnimatedGIF/AnimatedGIF.cpp
+// Run:
+//   ./rda_bench data [rounds]
+
+#include <AnimatedGIF.h>
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "rda_decoder.h"
+
+namespace
+{
+struct Clip
+{
+  std::string name;
+  std::vector<uint8_t> rda;
+  RdaHeader header;
+  std::vector<RdaFrameInfo> frames;
+  std::vector<uint8_t> gif;
+};
+
+struct Result
+{
+  int frames = 0;
+  double micros = 0.0; // fastest pass
+};
+
+// Panel the .rda frames are applied to, in panel byte order.
+std::vector<uint16_t> panel;
+uint16_t panelWidth = 0;
+uint32_t panelWrites = 0;
+uint32_t panelPixels = 0;
+
+// GIF canvas, for the check pass.
+std::vector<uint16_t> canvas;
+int canvasWidth = 0;
+uint32_t drawChecksum = 0;
+
+void panelWrite(void *, int16_t x, int16_t y, uint16_t *pixels, int16_t width, int16_t lines)
+{
+  for (int16_t line = 0; line < lines; ++line)
+  {
+    memcpy(&panel[static_cast<size_t>(y + line) * panelWidth + x], pixels + static_cast<size_t>(line) * width,
+           static_cast<size_t>(width) * sizeof(uint16_t));
+  }
+  ++panelWrites;
+  panelPixels += static_cast<uint32_t>(width) * lines;
+}
+
+void gifDraw(GIFDRAW *pDraw)
+{
+  // Touch the output so the decode cannot be optimised away.
+  const uint16_t *pixels = reinterpret_cast<const uint16_t *>(pDraw->pPixels);
+  drawChecksum = drawChecksum * 31u + pixels[0] + pixels[pDraw->iWidth - 1] + static_cast<uint32_t>(pDraw->y);
+}
+
+void canvasDraw(GIFDRAW *pDraw)
+{
+  memcpy(&canvas[static_cast<size_t>(pDraw->iY + pDraw->y) * canvasWidth + pDraw->iX], pDraw->pPixels,
+         static_cast<size_t>(pDraw->iWidth) * sizeof(uint16_t));
+}
+
+void *benchAlloc(uint32_t size)
+{
+  return malloc(size);
+}
+
+void benchFree(void *buffer)
+{
+  free(buffer);
+}
+
+bool loadFile(const std::string &path, std::vector<uint8_t> &data)
+{
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+  {
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  data.resize(static_cast<size_t>(ftell(f)));
+  fseek(f, 0, SEEK_SET);
+  const bool ok = fread(data.data(), 1, data.size(), f) == data.size();
+  fclose(f);
+  return ok;
+}
+
+bool parseClip(Clip &clip)
+{
+  if (clip.rda.size() < sizeof(RdaHeader))
+  {
+    return false;
+  }
+  memcpy(&clip.header, clip.rda.data(), sizeof(RdaHeader));
+  const size_t tableBytes = (static_cast<size_t>(clip.header.frameCount) + 1) * sizeof(RdaFrameInfo);
+  if (clip.header.magic != RdaDecoder::MAGIC || clip.header.version != RdaDecoder::VERSION ||
+      clip.header.frameCount == 0 || clip.rda.size() < sizeof(RdaHeader) + tableBytes)
+  {
+    return false;
+  }
+  clip.frames.resize(clip.header.frameCount + 1u);
+  memcpy(clip.frames.data(), clip.rda.data() + sizeof(RdaHeader), tableBytes);
+  for (const RdaFrameInfo &frame : clip.frames)
+  {
+    if (frame.offset > clip.rda.size() || frame.length > clip.rda.size() - frame.offset)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<Clip> loadClips(const char *dirPath)
+{
+  std::vector<Clip> clips;
+  DIR *dir = opendir(dirPath);
+  if (!dir)
+  {
+    return clips;
+  }
+  while (dirent *entry = readdir(dir))
+  {
+    const std::string name = entry->d_name;
+    if (name.size() < 4 || name.compare(name.size() - 4, 4, ".rda") != 0)
+    {
+      continue;
+    }
+    const std::string base = std::string(dirPath) + "/" + name.substr(0, name.size() - 4);
+    Clip clip;
+    clip.name = name;
+    if (!loadFile(base + ".rda", clip.rda) || !parseClip(clip) || !loadFile(base + ".gif", clip.gif))
+    {
+      fprintf(stderr, "rda_bench: skipping %s (unreadable, or no .gif beside it)\n", name.c_str());
+      continue;
+    }
+    clips.push_back(std::move(clip));
+  }
+  closedir(dir);
+  std::sort(clips.begin(), clips.end(), [](const Clip &a, const Clip &b) { return a.name < b.name; });
+  return clips;
+}
+
+// Plays frames 1..n (n leads back to frame 0), as the player does once the
+// first frame is up.
+bool playClip(const RdaDecoder &decoder, const Clip &clip, std::vector<uint16_t> &band, Result &result)
+{
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 1; i < clip.frames.size(); ++i)
+  {
+    const RdaFrameInfo &frame = clip.frames[i];
+    if (!decoder.decode(clip.rda.data() + frame.offset, frame.length, band.data(), band.size(), 0, panelWrite,
+                        nullptr))
+    {
+      return false;
+    }
+  }
+  const double micros =
+      std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  if (result.frames == 0 || micros < result.micros)
+  {
+    result.micros = micros;
+  }
+  result.frames = static_cast<int>(clip.frames.size()) - 1;
+  return true;
+}
+
+bool decodeGif(AnimatedGIF &gif, Clip &clip, GIF_DRAW_CALLBACK *draw, Result &result)
+{
+  gif.begin(LITTLE_ENDIAN_PIXELS);
+  if (!gif.open(clip.gif.data(), static_cast<int>(clip.gif.size()), draw))
+  {
+    return false;
+  }
+  if (gif.allocTurboBuf(benchAlloc) != GIF_SUCCESS || gif.allocFrameBuf(benchAlloc) != GIF_SUCCESS)
+  {
+    gif.close();
+    return false;
+  }
+  gif.setDrawType(GIF_DRAW_COOKED);
+
+  const auto start = std::chrono::steady_clock::now();
+  int frames = 0;
+  int delayMs = 0;
+  int more;
+  do
+  {
+    more = gif.playFrame(false, &delayMs);
+    ++frames;
+  } while (more > 0);
+  const double micros =
+      std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  if (result.frames == 0 || micros < result.micros)
+  {
+    result.micros = micros;
+  }
+  result.frames = frames;
+  gif.freeFrameBuf(benchFree);
+  gif.freeTurboBuf(benchFree);
+  gif.close();
+  return true;
+}
+
+// Frames of the .rda that differ from the GIF inside the circle.
+int checkClip(AnimatedGIF &gif, const RdaDecoder &decoder, Clip &clip, std::vector<uint16_t> &band)
+{
+  gif.begin(LITTLE_ENDIAN_PIXELS);
+  if (!gif.open(clip.gif.data(), static_cast<int>(clip.gif.size()), canvasDraw) ||
+      gif.allocTurboBuf(benchAlloc) != GIF_SUCCESS || gif.allocFrameBuf(benchAlloc) != GIF_SUCCESS)
+  {
+    gif.close();
+    return -1;
+  }
+  gif.setDrawType(GIF_DRAW_COOKED);
+  canvasWidth = gif.getCanvasWidth();
+  const int canvasHeight = gif.getCanvasHeight();
+  canvas.assign(static_cast<size_t>(canvasWidth) * canvasHeight, 0);
+  const int width = clip.header.width;
+  const int height = clip.header.height;
+  const int scale = std::max(1, std::max((width + canvasWidth - 1) / canvasWidth,
+                                         (height + canvasHeight - 1) / canvasHeight));
+  const int offsetX = (width - canvasWidth * scale) / 2;
+  const int offsetY = (height - canvasHeight * scale) / 2;
+
+  int mismatches = 0;
+  int delayMs = 0;
+  const size_t count = clip.header.frameCount;
+  for (size_t i = 0; i <= count; ++i)
+  {
+    if (i < count && gif.playFrame(false, &delayMs) < 0)
+    {
+      ++mismatches;
+      break;
+    }
+    const RdaFrameInfo &frame = clip.frames[i];
+    if (!decoder.decode(clip.rda.data() + frame.offset, frame.length, band.data(), band.size(), 0, panelWrite,
+                        nullptr))
+    {
+      ++mismatches;
+      continue;
+    }
+    if (i == count)
+    {
+      // Back at frame 0: compare with a fresh decode of it.
+      gif.reset();
+      gif.playFrame(false, &delayMs);
+    }
+    bool same = true;
+    for (int y = 0; y < height && same; ++y)
+    {
+      uint16_t x0;
+      uint16_t x1;
+      RdaDecoder::rowSpan(static_cast<uint16_t>(width), static_cast<uint16_t>(height), static_cast<uint16_t>(y), x0,
+                          x1);
+      const uint16_t *row = &canvas[static_cast<size_t>((y - offsetY) / scale) * canvasWidth];
+      for (int x = x0; x < x1 && same; ++x)
+      {
+        same = panel[static_cast<size_t>(y) * width + x] == row[(x - offsetX) / scale];
+      }
+    }
+    mismatches += same ? 0 : 1;
+  }
+  gif.freeFrameBuf(benchFree);
+  gif.freeTurboBuf(benchFree);
+  gif.close();
+  return mismatches;
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+  const char *dirPath = argc > 1 ? argv[1] : "data";
+  const int rounds = argc > 2 ? std::max(1, atoi(argv[2])) : 5;
+  std::vector<Clip> clips = loadClips(dirPath);
+  if (clips.empty())
+  {
+    fprintf(stderr, "rda_bench: no .rda clips with a matching .gif in %s\n", dirPath);
+    return 1;
+  }
+
+  RdaDecoder decoder;
+  AnimatedGIF *gif = new AnimatedGIF();
+  printf("%-20s %6s %10s %10s %10s %10s %10s %10s\n", "clip", "frames", "rda B/f", "rda us/f", "writes/f",
+         "pixels/f", "gif B/f", "gif us/f");
+  int failures = 0;
+  for (Clip &clip : clips)
+  {
+    // The player's band: the panel width by JpegDecoder::MAX_BAND_LINES.
+    std::vector<uint16_t> band(static_cast<size_t>(clip.header.width) * 16);
+    decoder.setSize(clip.header.width, clip.header.height);
+    panelWidth = clip.header.width;
+    panel.assign(static_cast<size_t>(clip.header.width) * clip.header.height, 0);
+    // The host keeps pixels in host order, so the check can compare them.
+    decoder.setSwapBytes(false);
+    const int mismatches = checkClip(*gif, decoder, clip, band);
+
+    decoder.setSwapBytes(true);
+    Result rda;
+    Result gifResult;
+    bool ok = mismatches == 0;
+    panelWrites = 0;
+    panelPixels = 0;
+    for (int round = 0; round < rounds && ok; ++round)
+    {
+      ok = playClip(decoder, clip, band, rda) && decodeGif(*gif, clip, gifDraw, gifResult);
+    }
+    if (!ok)
+    {
+      printf("%-20s %s\n", clip.name.c_str(),
+             mismatches != 0 ? "FRAMES DIFFER FROM THE GIF" : "failed to decode");
+      ++failures;
+      continue;
+    }
+    const double frames = rda.frames;
+    const size_t payload = clip.rda.size() - sizeof(RdaHeader) - clip.frames.size() * sizeof(RdaFrameInfo);
+    printf("%-20s %6d %10.0f %10.1f %10.1f %10.0f %10.0f %10.1f\n", clip.name.c_str(), rda.frames,
+           static_cast<double>(payload) / frames, rda.micros / frames, panelWrites / (frames * rounds),
+           panelPixels / (frames * rounds), static_cast<double>(clip.gif.size()) / gifResult.frames,
+           gifResult.micros / gifResult.frames);
+  }
+  delete gif;
+  return failures == 0 ? 0 : 1;
+}